@@ -0,0 +1,84 @@
+#include "AABB.h"
+
+#include <float.h>
+
+AABB::AABB() {
+    lo.set( FLT_MAX,  FLT_MAX,  FLT_MAX);
+    hi.set(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+AABB::AABB(const Point4& lo, const Point4& hi) {
+    this->lo = lo;
+    this->hi = hi;
+}
+
+bool AABB::isEmpty() const {
+    return lo.X() > hi.X() || lo.Y() > hi.Y() || lo.Z() > hi.Z();
+}
+
+Point4 AABB::centroid() const {
+    return Point4((lo.X() + hi.X()) * 0.5f,
+                  (lo.Y() + hi.Y()) * 0.5f,
+                  (lo.Z() + hi.Z()) * 0.5f);
+}
+
+float AABB::surfaceArea() const {
+    if (isEmpty())
+        return 0;
+    float dx = hi.X() - lo.X();
+    float dy = hi.Y() - lo.Y();
+    float dz = hi.Z() - lo.Z();
+    return 2 * (dx*dy + dy*dz + dz*dx);
+}
+
+bool AABB::intersects(const Point4& start, const Vector4& inv_dir,
+                      float t_max, float& t_near) const {
+    float t0 = 0;
+    float t1 = t_max;
+
+    for (int i = 0; i < 3; i++) {
+        float t_lo = (lo[i] - start[i]) * inv_dir[i];
+        float t_hi = (hi[i] - start[i]) * inv_dir[i];
+        if (t_lo > t_hi) {
+            float tmp = t_lo;
+            t_lo = t_hi;
+            t_hi = tmp;
+        }
+        // Written so that a NaN (0 * infinity, a ray lying in a
+        // slab plane) leaves the interval unchanged.
+        t0 = t_lo > t0 ? t_lo : t0;
+        t1 = t_hi < t1 ? t_hi : t1;
+        if (t0 > t1)
+            return false;
+    }
+    t_near = t0;
+    return true;
+}
+
+bool AABB::clip(const Point4& start, const Vector4& inv_dir,
+                float t_max, float& t_near, float& t_far) const {
+    float t0 = 0;
+    float t1 = t_max;
+
+    for (int i = 0; i < 3; i++) {
+        float t_lo = (lo[i] - start[i]) * inv_dir[i];
+        float t_hi = (hi[i] - start[i]) * inv_dir[i];
+        if (t_lo > t_hi) {
+            float tmp = t_lo;
+            t_lo = t_hi;
+            t_hi = tmp;
+        }
+        t0 = t_lo > t0 ? t_lo : t0;
+        t1 = t_hi < t1 ? t_hi : t1;
+        if (t0 > t1)
+            return false;
+    }
+    t_near = t0;
+    t_far = t1;
+    return true;
+}
+
+ostream& operator<<(ostream& os, const AABB& box) {
+    os << "AABB lo " << box.lo << " hi " << box.hi;
+    return os;
+}
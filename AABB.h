@@ -0,0 +1,66 @@
+#if !defined(_AABB_H_)
+
+#define _AABB_H_
+
+#include <algorithm>
+
+#include "GeomLib.h"
+
+//////////////////////////////////////////////////////////
+//
+// An axis-aligned bounding box: all points p with
+// lo <= p <= hi, component by component.
+//
+//////////////////////////////////////////////////////////
+
+class AABB {
+public:
+    // An empty box (lo > hi), which grows to fit whatever is added
+    AABB();
+    AABB(const Point4& lo, const Point4& hi);
+
+    // Grow the box to contain a point, or another box
+    void expand(const Point4& p);
+    void expand(const AABB& box);
+
+    bool isEmpty() const;
+    Point4 centroid() const;
+    float surfaceArea() const;
+
+    //
+    // Slab test.  inv_dir holds 1/direction, per component.
+    // If the ray (start + t*direction) enters the box at some
+    // 0 <= t <= t_max, sets t_near to the entry t and returns true.
+    //
+    bool intersects(const Point4& start, const Vector4& inv_dir,
+                    float t_max, float& t_near) const;
+
+    // The same, also setting t_far to where the ray leaves the
+    // box (or t_max, if that's sooner).
+    bool clip(const Point4& start, const Vector4& inv_dir,
+              float t_max, float& t_near, float& t_far) const;
+
+    Point4 lo;
+    Point4 hi;
+
+    friend ostream& operator<<(ostream& os, const AABB& box);
+};
+
+// Inline, and without branches: the BVH build calls these for
+// every object at every level
+
+inline void AABB::expand(const Point4& p) {
+    for (int i = 0; i < 3; i++) {
+        lo[i] = min(lo[i], p[i]);
+        hi[i] = max(hi[i], p[i]);
+    }
+}
+
+inline void AABB::expand(const AABB& box) {
+    for (int i = 0; i < 3; i++) {
+        lo[i] = min(lo[i], box.lo[i]);
+        hi[i] = max(hi[i], box.hi[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,49 @@
+#include "Accelerator.h"
+#include "Mesh.h"
+
+bool accelerator_type(string_view name, AcceleratorType& type) {
+    if (name == "bvh")
+        type = ACCEL_BVH;
+    else if (name == "grid")
+        type = ACCEL_GRID;
+    else if (name == "kdtree")
+        type = ACCEL_KDTREE;
+    else
+        return false;
+    return true;
+}
+
+string accelerator_type_name(AcceleratorType type) {
+    switch (type) {
+    case ACCEL_GRID:   return "grid";
+    case ACCEL_KDTREE: return "kdtree";
+    default:           return "bvh";
+    }
+}
+
+void Accelerator::first_hit(RayPacket& packet, TraceContext& ctx) {
+    for (int j = 0; j < packet.count; j++)
+        packet.found[j] = first_hit(packet.rays[j], packet.hits[j], ctx);
+}
+
+vector<Accelerator::Part> Accelerator::split_meshes(const vector<Object*>& objects) {
+    vector<Part> parts;
+    parts.reserve(objects.size());
+    for (auto obj : objects) {
+        Part part;
+        part.obj = obj;
+        part.part = -1;
+        if (obj->type == MESH) {
+            Mesh* mesh = static_cast<Mesh*>(obj);
+            for (int t = 0; t < mesh->triangles(); t++) {
+                part.part = t;
+                part.box = mesh->bounds(t);
+                parts.push_back(part);
+            }
+            continue;
+        }
+        part.box = obj->bounds();
+        parts.push_back(part);
+    }
+    return parts;
+}
@@ -0,0 +1,103 @@
+#if !defined(_ACCELERATOR_H_)
+
+#define _ACCELERATOR_H_
+
+#include <float.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AABB.h"
+#include "Object.h"
+#include "Hit.h"
+#include "TraceContext.h"
+#include "RayPacket.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// A spatial index over the scene's objects, which finds
+// what a ray hits without testing every object.  The
+// scene's is one of:
+//
+//   bvh     a bounding volume hierarchy (BVH.h), the default
+//   grid    a uniform grid, walked cell by cell (Grid.h)
+//   kdtree  a k-d tree split by the SAH (KdTree.h)
+//
+// chosen with --accel, or "accelerator" in the scene file.
+// Groups always get a BVH.
+//
+//////////////////////////////////////////////////////////
+
+enum AcceleratorType {ACCEL_BVH, ACCEL_GRID, ACCEL_KDTREE};
+
+// "bvh", "grid" or "kdtree"; false if the name is none of them
+bool accelerator_type(string_view name, AcceleratorType& type);
+string accelerator_type_name(AcceleratorType type);
+
+class Accelerator {
+public:
+    virtual ~Accelerator() {};
+
+    // (Re)build over these objects, on n_threads threads
+    // (<= 0: one per hardware thread).
+    virtual void build(const vector<Object*>& objects, int n_threads = 0) = 0;
+
+    //
+    // Catch up with objects that have moved (or changed shape)
+    // since the build, without building again.  False if it
+    // can't, or if the result would trace too slowly: then the
+    // caller should build() instead.
+    //
+    virtual bool refit(const vector<Object*>& /*moved*/) {return false;};
+
+    // Find the nearest object hit by the ray, if any.
+    bool first_hit(Ray4& ray, Hit& hit, TraceContext& ctx) {
+        return first_hit(ray, FLT_MAX, hit, ctx);
+    };
+
+    // ...only counting hits at t < t_max.
+    virtual bool first_hit(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) = 0;
+
+    //
+    // The same for every ray of a (coherent) packet: fills in
+    // packet.found and packet.hits.  Unless overridden, the
+    // rays are traced one at a time.
+    //
+    virtual void first_hit(RayPacket& packet, TraceContext& ctx);
+
+    // Is anything hit at EPSILON < t < t_max?
+    virtual bool occluded(Ray4& ray, float t_max, TraceContext& ctx) = 0;
+
+    // Box around everything in it
+    virtual AABB bounds() const = 0;
+
+    // Memory held, in bytes
+    virtual size_t bytes() const = 0;
+
+    // Which kind it is ("bvh", "lbvh", "grid", "kdtree")
+    virtual string name() const = 0;
+
+    // Its size and shape, on one line
+    virtual void describe(ostream& os) const = 0;
+
+    friend ostream& operator<<(ostream& os, const Accelerator& accel) {
+        accel.describe(os);
+        return os;
+    };
+
+protected:
+    // An object, or one triangle ("part") of a mesh, and its box
+    struct Part {
+        AABB box;
+        Object* obj;
+        int part;
+    };
+
+    // The objects, with each mesh split into its triangles
+    static vector<Part> split_meshes(const vector<Object*>& objects);
+};
+
+#endif
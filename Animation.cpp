@@ -0,0 +1,173 @@
+#include "Animation.h"
+
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <string>
+
+#include "Tokenizer.h"
+
+Animation::Frame::Frame() {
+    has_eye = has_lookat = has_vup = false;
+}
+
+Animation::Animation() {
+}
+
+void Animation::read(const char *filename) {
+    movers.clear();
+    rest_spheres.clear();
+    rest_triangles.clear();
+    rest_meshes.clear();
+    rest_instances.clear();
+    frame_list.clear();
+
+    // The top-level objects by name, downcased as the scene
+    // parser downcases all but instances' (-1: more than one
+    // has it)
+    map<string, int> by_name;
+    for (int i = 0; i < (int)scene_order.size(); i++) {
+        string name(scene_object(scene_order[i])->name);
+        for (char& c : name)
+            c = (char)tolower((unsigned char)c);
+        auto found = by_name.find(name);
+        if (found == by_name.end())
+            by_name[name] = i;
+        else
+            found->second = -1;
+    }
+    map<int, int> mover_of; // scene_order index -> movers index
+
+    Tokenizer toker(filename);
+    Frame* frame = NULL;
+    while (!toker.eof()) {
+        string_view keyword = toker.next_string();
+
+        if (keyword == "frame") {
+            float number = toker.next_number();
+            int f = (int)number;
+            if (f != number || f < (int)frame_list.size())
+                toker.error("frames must be whole numbers, in increasing order");
+            frame_list.resize(f + 1);
+            frame = &frame_list[f];
+            continue;
+        }
+        if (frame == NULL)
+            toker.error("\"" + string(keyword) + "\" before the first frame");
+
+        if (keyword == "camera_eye") {
+            float x = toker.next_number();
+            float y = toker.next_number();
+            float z = toker.next_number();
+            frame->eye.set(x, y, z);
+            frame->has_eye = true;
+        }
+        else if (keyword == "camera_lookat") {
+            float x = toker.next_number();
+            float y = toker.next_number();
+            float z = toker.next_number();
+            frame->lookat.set(x, y, z);
+            frame->has_lookat = true;
+        }
+        else if (keyword == "camera_vup") {
+            float x = toker.next_number();
+            float y = toker.next_number();
+            float z = toker.next_number();
+            frame->vup.set(x, y, z);
+            frame->has_vup = true;
+        }
+        else if (keyword == "move") {
+            string name(toker.next_string());
+            auto found = by_name.find(name);
+            if (found == by_name.end())
+                toker.error("no object named \"" + name + "\" (only objects outside groups can move)");
+            if (found->second < 0)
+                toker.error("more than one object is named \"" + name + "\"");
+
+            // Scale, then rotate about x, y and z, then translate
+            float t[3], angle[3], scale[3];
+            toker.match("translate");
+            for (float& v : t)
+                v = toker.next_number();
+            toker.match("rotate");
+            for (float& v : angle)
+                v = toker.next_number();
+            toker.match("scale");
+            for (float& v : scale)
+                v = toker.next_number();
+            Matrix4 M = Matrix4::Translation(t[0], t[1], t[2]) *
+                        Matrix4::ZRotation(angle[2]) * Matrix4::YRotation(angle[1]) *
+                        Matrix4::XRotation(angle[0]) *
+                        Matrix4::Scaling(scale[0], scale[1], scale[2]);
+            if (fabs(M.determinant()) < 1e-12f)
+                toker.error("\"" + name + "\" is moved with a zero scale");
+
+            // Keep a copy of the object as it was read, to move from.
+            auto mover = mover_of.find(found->second);
+            if (mover == mover_of.end()) {
+                ObjectRef ref = scene_order[found->second];
+                Mover m = {ref, 0};
+                switch (ref.type) {
+                case SPHERE:
+                    m.rest = (int)rest_spheres.size();
+                    rest_spheres.push_back(scene_spheres[ref.index]);
+                    break;
+                case TRIANGLE:
+                    m.rest = (int)rest_triangles.size();
+                    rest_triangles.push_back(scene_triangles[ref.index]);
+                    break;
+                case MESH:
+                    m.rest = (int)rest_meshes.size();
+                    rest_meshes.push_back(scene_meshes[ref.index]);
+                    break;
+                default:
+                    m.rest = (int)rest_instances.size();
+                    rest_instances.push_back(scene_instances[ref.index]);
+                    break;
+                }
+                mover = mover_of.insert(make_pair(found->second, (int)movers.size())).first;
+                movers.push_back(m);
+            }
+            frame->moves.push_back({mover->second, M});
+        }
+        else {
+            toker.error("unrecognized keyword \"" + string(keyword) + "\"");
+        }
+    }
+    if (frame_list.empty())
+        toker.error("no frames");
+}
+
+void Animation::apply(int frame, vector<Object*>& moved) {
+    const Frame& f = frame_list[frame];
+    if (f.has_eye)
+        eye = f.eye;
+    if (f.has_lookat)
+        lookat = f.lookat;
+    if (f.has_vup)
+        vup = f.vup;
+
+    // Each object is moved from its copy, so errors don't add up.
+    for (auto& move : f.moves) {
+        const Mover& m = movers[move.mover];
+        switch (m.ref.type) {
+        case SPHERE:
+            scene_spheres[m.ref.index] = rest_spheres[m.rest];
+            scene_spheres[m.ref.index].transform(move.M);
+            break;
+        case TRIANGLE:
+            scene_triangles[m.ref.index] = rest_triangles[m.rest];
+            scene_triangles[m.ref.index].transform(move.M);
+            break;
+        case MESH:
+            scene_meshes[m.ref.index] = rest_meshes[m.rest];
+            scene_meshes[m.ref.index].transform(move.M);
+            break;
+        default:
+            scene_instances[m.ref.index] = rest_instances[m.rest];
+            scene_instances[m.ref.index].transform(move.M);
+            break;
+        }
+        moved.push_back(scene_object(m.ref));
+    }
+}
@@ -0,0 +1,87 @@
+#if !defined(_ANIMATION_H_)
+
+#define _ANIMATION_H_
+
+#include <vector>
+
+#include "GeomLib.h"
+#include "RayTracer.h"
+#include "Sphere.h"
+#include "Triangle.h"
+#include "Mesh.h"
+#include "Instance.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// A sequence of frames, each moving some of the scene's
+// objects, or its camera.  The file reads like:
+//
+//   frame 0
+//   camera_eye 1 1 3
+//   move red_ball translate 0 0.2 0 rotate 0 0 0 scale 1 1 1
+//   frame 1
+//   move red_ball translate 0 0.4 0 rotate 0 0 0 scale 1 1 1
+//   ...
+//
+// "move" places a named object (a sphere, triangle, mesh
+// or instance, outside any group; names ignore case, as in
+// the scene file) as an instance is placed: scaled, rotated
+// about x, y and z (degrees), then translated, from where
+// the scene file put it.  A pose or
+// camera setting holds until a later frame changes it, and
+// a frame that isn't listed is the same as the one before.
+// A sphere stays a sphere: it takes the scale's change in
+// volume, evenly.
+//
+// Compiled scenes keep only mesh and instance names.
+//
+//////////////////////////////////////////////////////////
+
+class Animation {
+public:
+    Animation();
+
+    // Read the animation of the scene read_scene() has read
+    void read(const char *filename);
+
+    int frames() const {return (int)frame_list.size();};
+
+    //
+    // Pose the scene, and set the camera, for a frame, and
+    // append to "moved" the objects that moved since the
+    // frame before.  Apply the frames in order, from 0.
+    //
+    void apply(int frame, vector<Object*>& moved);
+
+private:
+    // An object that moves, and its copy as the scene file put it
+    struct Mover {
+        ObjectRef ref;
+        int rest; // in the rest array of its type
+    };
+
+    struct Move {
+        int mover;
+        Matrix4 M;
+    };
+
+    struct Frame {
+        vector<Move> moves;
+        bool has_eye, has_lookat, has_vup;
+        Point4 eye, lookat;
+        Vector4 vup;
+
+        Frame();
+    };
+
+    vector<Mover> movers;
+    vector<Sphere> rest_spheres;
+    vector<Triangle> rest_triangles;
+    vector<Mesh> rest_meshes;
+    vector<Instance> rest_instances;
+    vector<Frame> frame_list;
+};
+
+#endif
@@ -0,0 +1,707 @@
+#include "BVH.h"
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <float.h>
+#include <thread>
+
+// Relative costs used by the surface area heuristic
+static const float TRAVERSAL_COST = 1.0f;
+static const float INTERSECT_COST = 2.0f;
+
+// Leaves hold at most this many objects...
+static const int MAX_LEAF_SIZE = 8;
+// ...and the tree is never deeper than this (first_hit's stack).
+static const int MAX_DEPTH = 60;
+
+// The SAH build tries every split of nodes this small, and
+// splits bigger ones at the boundaries of this many bins.
+static const int SWEEP_SIZE = 32;
+static const int BINS = 16;
+
+// LBVH leaves hold at most this many objects
+static const int LBVH_LEAF_SIZE = 4;
+
+// Subtrees smaller than this aren't worth a thread
+static const int PARALLEL_SIZE = 4096;
+
+// refit() asks for a new build once the expected cost per ray
+// has grown by this factor
+static const float REFIT_LIMIT = 1.3f;
+
+bool build_method(const string& name, BuildMethod& method) {
+    if (name == "sah")
+        method = BUILD_SAH;
+    else if (name == "lbvh")
+        method = BUILD_LBVH;
+    else
+        return false;
+    return true;
+}
+
+string build_method_name(BuildMethod method) {
+    return method == BUILD_LBVH ? "lbvh" : "sah";
+}
+
+// Run left() and right(), on two threads if "parallel"
+template <class F, class G>
+static void fork(bool parallel, const F& left, const G& right) {
+    if (!parallel) {
+        left();
+        right();
+        return;
+    }
+    thread worker(left);
+    right();
+    worker.join();
+}
+
+BVH::BVH(BuildMethod method) {
+    this->method = method;
+    max_depth = 0;
+    area_cost = 0;
+    built_cost = 0;
+}
+
+void BVH::build(const vector<Object*>& objects, int n_threads) {
+    nodes.clear();
+    parents.clear();
+    leaf_objects.clear();
+    leaf_of.clear();
+    max_depth = 0;
+    area_cost = 0;
+    built_cost = 0;
+
+    if (objects.empty())
+        return;
+
+    // A mesh is split into its triangles.
+    vector<Part> parts = split_meshes(objects);
+    if (parts.empty())
+        return;
+    vector<BuildItem> items(parts.size());
+    for (size_t i = 0; i < parts.size(); i++) {
+        items[i].box = parts[i].box;
+        items[i].centroid = parts[i].box.centroid();
+        items[i].obj = parts[i].obj;
+        items[i].type = parts[i].obj->type;
+        items[i].part = parts[i].part;
+    }
+    vector<Part>().swap(parts);
+
+    // Subtrees are handed to new threads this many levels down,
+    // to keep twice as many threads busy (splits are uneven).
+    if (n_threads <= 0)
+        n_threads = TileScheduler::hardware_threads();
+    int spawn = 0;
+    while ((1 << spawn) < 2 * n_threads)
+        spawn++;
+    if (n_threads == 1)
+        spawn = 0;
+
+    int n = (int)items.size();
+    vector<BuildNode> slots(2 * n - 1);
+    if (method == BUILD_LBVH) {
+        sort_morton(items);
+        build_lbvh(items, slots, 0, n, 0, 0, spawn);
+    }
+    else {
+        build_sah(items, slots, 0, n, 0, 0, spawn);
+    }
+
+    int n_spheres = 0, n_triangles = 0;
+    for (auto& item : items) {
+        if (item.type == SPHERE)
+            n_spheres++;
+        else if (item.type == TRIANGLE || item.type == MESH)
+            n_triangles++;
+    }
+    leaf_objects.reserve(n_spheres, n_triangles, n - n_spheres - n_triangles);
+
+    nodes.reserve(slots.size());
+    parents.reserve(slots.size());
+    lay_out(items, slots, 0, -1, 0);
+    nodes.shrink_to_fit();
+    parents.shrink_to_fit();
+
+    built_cost = sahCost();
+    area_cost = built_cost * nodes[0].box.surfaceArea();
+}
+
+//
+// Copy the subtree built at "slot" into nodes, depth first,
+// and return its node index.
+//
+int BVH::lay_out(const vector<BuildItem>& items, const vector<BuildNode>& slots,
+                 int slot, int parent, int depth) {
+    const BuildNode& built = slots[slot];
+    int node = (int)nodes.size();
+    nodes.push_back(Node());
+    nodes[node].box = built.box;
+    parents.push_back(parent);
+
+    if (depth > max_depth)
+        max_depth = depth;
+
+    if (built.right < 0)
+        return make_leaf(items, built.begin, built.end, node);
+
+    lay_out(items, slots, slot + 1, node, depth + 1);
+    nodes[node].right = lay_out(items, slots, built.right, node, depth + 1);
+    return node;
+}
+
+int BVH::make_leaf(const vector<BuildItem>& items, int begin, int end, int node) {
+    Leaf leaf = leaf_objects.begin();
+    for (int i = begin; i < end; i++)
+        leaf_objects.add(leaf, items[i].obj, items[i].part);
+    nodes[node].right = -1;
+    nodes[node].leaf = leaf;
+    return node;
+}
+
+//
+// Build the subtree over items[begin..end), rooted at "slot".
+// The subtrees of the top "spawn" levels are built in parallel.
+//
+void BVH::build_sah(vector<BuildItem>& items, vector<BuildNode>& slots,
+                    int begin, int end, int slot, int depth, int spawn) {
+    AABB box, centroids;
+    int n_spheres = 0, n_triangles = 0;
+    for (int i = begin; i < end; i++) {
+        box.expand(items[i].box);
+        centroids.expand(items[i].centroid);
+        if (items[i].type == SPHERE)
+            n_spheres++;
+        else if (items[i].type == TRIANGLE || items[i].type == MESH)
+            n_triangles++;
+    }
+    BuildNode& node = slots[slot];
+    node.box = box;
+    node.right = -1;
+    node.begin = begin;
+    node.end = end;
+
+    int n = end - begin;
+    if (n == 1 || depth >= MAX_DEPTH)
+        return;
+
+    int mid;
+    float best_cost = (n <= SWEEP_SIZE) ? sweep_split(items, begin, end, mid)
+                                        : binned_split(items, begin, end, centroids, mid);
+
+    float area = box.surfaceArea();
+    float split_cost = TRAVERSAL_COST;
+    if (area > 0)
+        split_cost += INTERSECT_COST * best_cost / area;
+
+    // The sphere and triangle kernels test a whole vector of them
+    // at about the cost of one, so a leaf may hold that many.
+    int width = simd_width();
+    int tests = (n_spheres + width - 1) / width
+              + (n_triangles + width - 1) / width
+              + (n - n_spheres - n_triangles);
+    float leaf_cost = INTERSECT_COST * tests;
+
+    if (leaf_cost <= split_cost && n <= max(MAX_LEAF_SIZE, width))
+        return;
+
+    // The left subtree takes the slots after this one
+    int right = slot + 2 * (mid - begin);
+    node.right = right;
+    fork(spawn > 0 && n >= PARALLEL_SIZE,
+         [&]() {build_sah(items, slots, begin, mid, slot + 1, depth + 1, spawn - 1);},
+         [&]() {build_sah(items, slots, mid, end, right, depth + 1, spawn - 1);});
+}
+
+//
+// Sweep each axis: sort by centroid, and try every split
+// between consecutive objects.  Leaves the items split the
+// cheapest way, with "mid" the first on the right, and
+// returns that split's cost (area times count, both sides).
+//
+float BVH::sweep_split(vector<BuildItem>& items, int begin, int end, int& mid) {
+    int n = end - begin;
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    int best_split = 0;
+    float right_area[SWEEP_SIZE];
+
+    for (int axis = 0; axis < 3; axis++) {
+        sort(items.begin() + begin, items.begin() + end,
+             [axis](const BuildItem& a, const BuildItem& b) {
+                 return a.centroid[axis] < b.centroid[axis];
+             });
+
+        AABB right;
+        for (int i = n - 1; i > 0; i--) {
+            right.expand(items[begin + i].box);
+            right_area[i] = right.surfaceArea();
+        }
+
+        AABB left;
+        for (int i = 1; i < n; i++) {
+            left.expand(items[begin + i - 1].box);
+            float cost = left.surfaceArea() * i + right_area[i] * (n - i);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = i;
+            }
+        }
+    }
+
+    // The last sort was on Z: redo the winner's.
+    if (best_axis != 2) {
+        sort(items.begin() + begin, items.begin() + end,
+             [best_axis](const BuildItem& a, const BuildItem& b) {
+                 return a.centroid[best_axis] < b.centroid[best_axis];
+             });
+    }
+    mid = begin + best_split;
+    return best_cost;
+}
+
+//
+// The same, but only trying splits between BINS equal slices
+// of the centroids' box along each axis: one pass over the
+// items, not three sorts.
+//
+float BVH::binned_split(vector<BuildItem>& items, int begin, int end,
+                        const AABB& centroids, int& mid) {
+    struct Bin {
+        AABB box;
+        int count = 0;
+    };
+    Bin bins[3][BINS];
+
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroids.hi[axis] - centroids.lo[axis];
+        scale[axis] = (extent > 0) ? BINS / extent : 0;
+    }
+    auto bin_of = [&](const BuildItem& item, int axis) {
+        int b = (int)((item.centroid[axis] - centroids.lo[axis]) * scale[axis]);
+        return min(b, BINS - 1);
+    };
+
+    for (int i = begin; i < end; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            Bin& bin = bins[axis][bin_of(items[i], axis)];
+            bin.box.expand(items[i].box);
+            bin.count++;
+        }
+    }
+
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    int best_bin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (scale[axis] == 0)
+            continue;
+
+        float right_area[BINS];
+        int right_count[BINS];
+        AABB right;
+        int count = 0;
+        for (int b = BINS - 1; b > 0; b--) {
+            right.expand(bins[axis][b].box);
+            count += bins[axis][b].count;
+            right_area[b] = right.surfaceArea();
+            right_count[b] = count;
+        }
+
+        AABB left;
+        count = 0;
+        for (int b = 1; b < BINS; b++) {
+            left.expand(bins[axis][b - 1].box);
+            count += bins[axis][b - 1].count;
+            if (count == 0 || right_count[b] == 0)
+                continue;
+            float cost = left.surfaceArea() * count + right_area[b] * right_count[b];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    // Every centroid in the same place: any split is as good.
+    if (best_axis < 0) {
+        mid = begin + (end - begin) / 2;
+        return FLT_MAX;
+    }
+
+    mid = (int)(partition(items.begin() + begin, items.begin() + end,
+                          [&](const BuildItem& item) {
+                              return bin_of(item, best_axis) < best_bin;
+                          }) - items.begin());
+    return best_cost;
+}
+
+// 10 bits of x, spread out to every third bit
+static uint32_t spread_bits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | x << 16) & 0x030000ff;
+    x = (x | x << 8) & 0x0300f00f;
+    x = (x | x << 4) & 0x030c30c3;
+    x = (x | x << 2) & 0x09249249;
+    return x;
+}
+
+//
+// Give each item the Morton code of its centroid (its place
+// along a Z-order curve through the centroids' box, to 10
+// bits per axis) and sort them by it, with a radix sort.
+//
+void BVH::sort_morton(vector<BuildItem>& items) {
+    AABB centroids;
+    for (auto& item : items)
+        centroids.expand(item.centroid);
+
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroids.hi[axis] - centroids.lo[axis];
+        scale[axis] = (extent > 0) ? 1024 / extent : 0;
+    }
+    for (auto& item : items) {
+        uint32_t code = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            int k = (int)((item.centroid[axis] - centroids.lo[axis]) * scale[axis]);
+            code |= spread_bits((uint32_t)min(k, 1023)) << (2 - axis);
+        }
+        item.code = code;
+    }
+
+    // Sort (code, index) pairs, three passes of 10 bits each,
+    // and move the items only once.
+    int n = (int)items.size();
+    vector<uint64_t> keys(n), sorted(n);
+    for (int i = 0; i < n; i++)
+        keys[i] = (uint64_t)items[i].code << 32 | (uint32_t)i;
+    for (int shift = 32; shift < 62; shift += 10) {
+        vector<int> start(1025, 0);
+        for (auto key : keys)
+            start[((key >> shift) & 1023) + 1]++;
+        for (int d = 0; d < 1024; d++)
+            start[d + 1] += start[d];
+        for (auto key : keys)
+            sorted[start[(key >> shift) & 1023]++] = key;
+        keys.swap(sorted);
+    }
+
+    vector<BuildItem> sorted_items;
+    sorted_items.reserve(n);
+    for (auto key : keys)
+        sorted_items.push_back(items[(uint32_t)key]);
+    items.swap(sorted_items);
+}
+
+//
+// Build the subtree over items[begin..end), which are sorted by
+// Morton code, rooted at "slot", and return its box.  Each node
+// splits where the codes' highest differing bit changes, so no
+// costs are compared and the boxes are built bottom up.
+//
+AABB BVH::build_lbvh(vector<BuildItem>& items, vector<BuildNode>& slots,
+                     int begin, int end, int slot, int depth, int spawn) {
+    BuildNode& node = slots[slot];
+    node.right = -1;
+    node.begin = begin;
+    node.end = end;
+
+    int n = end - begin;
+    if (n <= LBVH_LEAF_SIZE || depth >= MAX_DEPTH) {
+        AABB box;
+        for (int i = begin; i < end; i++)
+            box.expand(items[i].box);
+        node.box = box;
+        return box;
+    }
+
+    uint32_t first = items[begin].code;
+    uint32_t last = items[end - 1].code;
+    int mid;
+    if (first == last) {
+        mid = begin + n / 2;
+    }
+    else {
+        uint32_t bit = 1u << (31 - __builtin_clz(first ^ last));
+        mid = (int)(partition_point(items.begin() + begin, items.begin() + end,
+                                    [bit](const BuildItem& item) {
+                                        return (item.code & bit) == 0;
+                                    }) - items.begin());
+    }
+
+    int right = slot + 2 * (mid - begin);
+    node.right = right;
+    AABB left_box, right_box;
+    fork(spawn > 0 && n >= PARALLEL_SIZE,
+         [&]() {left_box = build_lbvh(items, slots, begin, mid, slot + 1, depth + 1, spawn - 1);},
+         [&]() {right_box = build_lbvh(items, slots, mid, end, right, depth + 1, spawn - 1);});
+
+    node.box = left_box;
+    node.box.expand(right_box);
+    return node.box;
+}
+
+bool BVH::first_hit(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) {
+    if (nodes.empty())
+        return false;
+
+    Vector4 inv_dir(1.0f / ray.direction.X(),
+                    1.0f / ray.direction.Y(),
+                    1.0f / ray.direction.Z());
+
+    SphereRay sphere_ray(ray);
+    TriangleRay triangle_ray(ray);
+
+    // The nearest hit so far.  Every box and object test is
+    // clipped to it, so farther objects are rejected early.
+    // The sphere and triangle kernels only find t; the hit
+    // record is filled in at the end.
+    LeafHit best(t_max);
+
+    struct Entry {
+        int node;
+        float t_near;
+    };
+    Entry stack[MAX_DEPTH + 2];
+    int sp = 0;
+
+    float t_near;
+    if (!nodes[0].box.intersects(ray.start, inv_dir, best.t, t_near))
+        return false;
+    stack[sp].node = 0;
+    stack[sp].t_near = t_near;
+    sp++;
+
+    while (sp > 0) {
+        sp--;
+        if (stack[sp].t_near > best.t)
+            continue;
+        const Node& node = nodes[stack[sp].node];
+
+        if (node.right < 0) {
+            leaf_objects.nearest(node.leaf, ray, sphere_ray, triangle_ray, best, hit, ctx);
+        }
+        else {
+            int left = stack[sp].node + 1;
+            int right = node.right;
+            float t_left, t_right;
+            bool hit_left  = nodes[left].box.intersects(ray.start, inv_dir, best.t, t_left);
+            bool hit_right = nodes[right].box.intersects(ray.start, inv_dir, best.t, t_right);
+
+            // Push the far child first, so the near one is visited first.
+            if (hit_left && hit_right && t_right < t_left) {
+                swap(left, right);
+                swap(t_left, t_right);
+            }
+            if (hit_right) {
+                stack[sp].node = right;
+                stack[sp].t_near = t_right;
+                sp++;
+            }
+            if (hit_left) {
+                stack[sp].node = left;
+                stack[sp].t_near = t_left;
+                sp++;
+            }
+        }
+    }
+
+    leaf_objects.setHit(best, ray, hit);
+    return best.found;
+}
+
+void BVH::first_hit(RayPacket& packet, TraceContext& ctx) {
+    if (nodes.empty())
+        return;
+
+    //
+    // The packet walks the tree as one, carrying the mask of
+    // its rays that entered each node.  Children are visited
+    // in the order the first ray would reach their centers;
+    // each ray still keeps its own nearest t.
+    //
+    struct Entry {
+        int node;
+        uint64_t rays;
+    };
+    Entry stack[MAX_DEPTH + 2];
+    int sp = 0;
+
+    stack[sp].node = 0;
+    stack[sp].rays = packet.all();
+    sp++;
+
+    const Vector4& dir = packet.rays[0].direction;
+
+    while (sp > 0) {
+        sp--;
+        const Node& node = nodes[stack[sp].node];
+        uint64_t rays = packet.intersects(node.box, stack[sp].rays);
+        if (!rays)
+            continue;
+
+        if (node.right < 0) {
+            leaf_objects.nearest(node.leaf, packet, rays, ctx);
+        }
+        else {
+            int near = stack[sp].node + 1;
+            int far = node.right;
+            if ((nodes[far].box.centroid() - nodes[near].box.centroid()) * dir < 0)
+                swap(near, far);
+
+            stack[sp].node = far;
+            stack[sp].rays = rays;
+            sp++;
+            stack[sp].node = near;
+            stack[sp].rays = rays;
+            sp++;
+        }
+    }
+
+    leaf_objects.setHits(packet);
+}
+
+bool BVH::occluded(Ray4& ray, float t_max, TraceContext& ctx) {
+    if (nodes.empty())
+        return false;
+
+    Vector4 inv_dir(1.0f / ray.direction.X(),
+                    1.0f / ray.direction.Y(),
+                    1.0f / ray.direction.Z());
+    SphereRay sphere_ray(ray);
+    TriangleRay triangle_ray(ray);
+
+    // Any blocker will do, so there's no point sorting the children.
+    int stack[MAX_DEPTH + 2];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        int index = stack[--sp];
+        const Node& node = nodes[index];
+
+        float t_near;
+        if (!node.box.intersects(ray.start, inv_dir, t_max, t_near))
+            continue;
+
+        if (node.right < 0) {
+            if (leaf_objects.any(node.leaf, ray, sphere_ray, triangle_ray, t_max, ctx))
+                return true;
+        }
+        else {
+            stack[sp++] = node.right;
+            stack[sp++] = index + 1;
+        }
+    }
+    return false;
+}
+
+bool BVH::refit(const vector<Object*>& moved) {
+    if (nodes.empty())
+        return true;
+    if (leaf_of.empty())
+        index_leaves();
+
+    vector<int> leaves;
+    for (auto obj : moved) {
+        auto it = lower_bound(leaf_of.begin(), leaf_of.end(), obj,
+                              [](const pair<Object*, int>& entry, Object* obj) {
+                                  return entry.first < obj;
+                              });
+        for (; it != leaf_of.end() && it->first == obj; ++it)
+            leaves.push_back(it->second);
+    }
+    sort(leaves.begin(), leaves.end());
+    leaves.erase(unique(leaves.begin(), leaves.end()), leaves.end());
+
+    // Refit each leaf, then its ancestors, up to the first
+    // whose box doesn't change.
+    for (int leaf : leaves) {
+        if (!set_box(leaf, leaf_objects.refit(nodes[leaf].leaf)))
+            continue;
+        for (int node = parents[leaf]; node >= 0; node = parents[node]) {
+            AABB box = nodes[node + 1].box;
+            box.expand(nodes[nodes[node].right].box);
+            if (!set_box(node, box))
+                break;
+        }
+    }
+
+    float root_area = nodes[0].box.surfaceArea();
+    return root_area <= 0 || area_cost / root_area <= REFIT_LIMIT * built_cost;
+}
+
+// Set a node's box, keeping area_cost up to date; false if it was already that
+bool BVH::set_box(int node, const AABB& box) {
+    Node& n = nodes[node];
+    bool same = true;
+    for (int i = 0; i < 3; i++)
+        same = same && box.lo[i] == n.box.lo[i] && box.hi[i] == n.box.hi[i];
+    if (same)
+        return false;
+    area_cost += (box.surfaceArea() - n.box.surfaceArea()) * node_cost(n);
+    n.box = box;
+    return true;
+}
+
+void BVH::index_leaves() {
+    vector<Object*> owners;
+    for (int node = 0; node < (int)nodes.size(); node++) {
+        if (nodes[node].right >= 0)
+            continue;
+        owners.clear();
+        leaf_objects.owners(nodes[node].leaf, owners);
+        for (auto obj : owners)
+            leaf_of.push_back(make_pair(obj, node));
+    }
+    sort(leaf_of.begin(), leaf_of.end());
+    leaf_of.erase(unique(leaf_of.begin(), leaf_of.end()), leaf_of.end());
+}
+
+// What a ray that reaches the node costs there.  Leaves are
+// costed as the build costs them: a vector of spheres or
+// triangles at the price of one test.
+float BVH::node_cost(const Node& node) const {
+    if (node.right >= 0)
+        return TRAVERSAL_COST;
+    int width = simd_width();
+    int tests = (node.leaf.n_spheres + width - 1) / width
+              + (node.leaf.n_triangles + width - 1) / width + node.leaf.n_instances;
+    return INTERSECT_COST * tests;
+}
+
+float BVH::sahCost() {
+    if (nodes.empty())
+        return 0;
+
+    float root_area = nodes[0].box.surfaceArea();
+    if (root_area <= 0)
+        return INTERSECT_COST * (float)(leaf_objects.spheres() + leaf_objects.triangles() + leaf_objects.instances());
+
+    float cost = 0;
+    for (auto& node : nodes)
+        cost += node.box.surfaceArea() / root_area * node_cost(node);
+    return cost;
+}
+
+size_t BVH::bytes() const {
+    return nodes.capacity() * sizeof(Node) + parents.capacity() * sizeof(int)
+         + leaf_objects.bytes() + leaf_of.capacity() * sizeof(leaf_of[0]);
+}
+
+void BVH::describe(ostream& os) const {
+    int leaves = 0;
+    for (auto& node : nodes) {
+        if (node.right < 0)
+            leaves++;
+    }
+    os << "BVH " << leaf_objects.spheres() << " spheres + " << leaf_objects.triangles()
+       << " triangles (" << simd_name() << " kernels) + " << leaf_objects.instances()
+       << " instances, " << nodes.size()
+       << " nodes, " << leaves << " leaves, depth " << max_depth;
+}
@@ -0,0 +1,137 @@
+#if !defined(_BVH_H_)
+
+#define _BVH_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Accelerator.h"
+#include "LeafObjects.h"
+
+//////////////////////////////////////////////////////////
+//
+// Bounding volume hierarchy over the scene's objects.
+//
+// Built top-down: each node is split where the surface
+// area heuristic (SAH) predicts the cheapest traversal,
+// trying a few evenly spaced splits per axis for big nodes
+// and every split for small ones.  Subtrees are built on
+// separate threads.  The LBVH build sorts the objects along
+// a Morton curve and splits that instead: it builds about
+// twice as fast, but the tree costs more to trace.
+//
+// first_hit() walks the tree near child first, and passes
+// the nearest hit found so far as t_max to every box and
+// object test, so a ray costs O(log n) tests instead of O(n).
+//
+// The leaves' objects are kept in a LeafObjects, sorted by
+// type, so tracing makes no virtual calls.
+//
+// When a few objects move, refit() recomputes the boxes of
+// their leaves and of those leaves' ancestors, and keeps the
+// tree's shape.  That costs O(moved * depth), but the boxes
+// grow looser as objects drift from where they were built:
+// once the tree's expected cost has grown too much, refit()
+// says to build it again.
+//
+//////////////////////////////////////////////////////////
+
+// How build() splits nodes
+enum BuildMethod {BUILD_SAH, BUILD_LBVH};
+
+// "sah" or "lbvh"; false if the name is neither
+bool build_method(const string& name, BuildMethod& method);
+string build_method_name(BuildMethod method);
+
+class BVH final : public Accelerator {
+public:
+    BVH(BuildMethod method = BUILD_SAH);
+
+    // How the next build() splits nodes
+    void setMethod(BuildMethod method) {this->method = method;};
+
+    void build(const vector<Object*>& objects, int n_threads = 0) override;
+    bool refit(const vector<Object*>& moved) override;
+
+    using Accelerator::first_hit;
+    bool first_hit(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) override;
+
+    //
+    // The packet's rays are traced together, node by node,
+    // when they share an octant.
+    //
+    void first_hit(RayPacket& packet, TraceContext& ctx) override;
+
+    // Stops at the first object found, in whatever order is quickest.
+    bool occluded(Ray4& ray, float t_max, TraceContext& ctx) override;
+
+    AABB bounds() const override {return nodes.empty() ? AABB() : nodes[0].box;};
+    size_t bytes() const override;
+    string name() const override {return method == BUILD_LBVH ? "lbvh" : "bvh";};
+    void describe(ostream& os) const override;
+
+    int nodeCount() {return (int)nodes.size();};
+    int depth() {return max_depth;};
+
+    // Expected cost of a random ray, relative to one intersection test.
+    float sahCost();
+
+private:
+    struct Node {
+        AABB box;
+        int right;   // interior: right child (the left is the next node).  leaf: -1
+        Leaf leaf;   // leaf: its objects
+    };
+
+    struct BuildItem {
+        AABB box;
+        Point4 centroid;
+        Object* obj;
+        ObjectType type;
+        int part;         // MESH: which of its triangles
+        uint32_t code;    // LBVH: Morton code of the centroid
+    };
+
+    //
+    // The tree as built, before it is laid out depth first in
+    // nodes.  A subtree over n items is given the 2n - 1 slots
+    // from its root's on, so subtrees can be built at once.
+    //
+    struct BuildNode {
+        AABB box;
+        int right;       // interior: slot of the right child (the left is the next slot).  leaf: -1
+        int begin, end;  // leaf: items[begin .. end)
+    };
+
+    static void build_sah(vector<BuildItem>& items, vector<BuildNode>& slots,
+                          int begin, int end, int slot, int depth, int spawn);
+    static float sweep_split(vector<BuildItem>& items, int begin, int end, int& mid);
+    static float binned_split(vector<BuildItem>& items, int begin, int end,
+                              const AABB& centroids, int& mid);
+    static void sort_morton(vector<BuildItem>& items);
+    static AABB build_lbvh(vector<BuildItem>& items, vector<BuildNode>& slots,
+                           int begin, int end, int slot, int depth, int spawn);
+    int lay_out(const vector<BuildItem>& items, const vector<BuildNode>& slots,
+                int slot, int parent, int depth);
+    int make_leaf(const vector<BuildItem>& items, int begin, int end, int node);
+
+    float node_cost(const Node& node) const;
+    bool set_box(int node, const AABB& box);
+    void index_leaves();
+
+    BuildMethod method;
+    vector<Node> nodes;
+    vector<int> parents;   // of each node; -1 for the root
+    LeafObjects leaf_objects;
+    int max_depth;
+
+    // For refit(): the leaves each object is in, sorted (made
+    // at the first refit); the sum over the nodes of area times
+    // node_cost(), kept up to date; and sahCost() as built
+    vector<pair<Object*, int>> leaf_of;
+    float area_cost;
+    float built_cost;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+
+#include "RayTracer.h"
+#include "Sphere.h"
+#include "Triangle.h"
+
+// Results are added into this, so the compiler can't throw the work away.
+static volatile double sink;
+
+vector<MicroResult> benchmark_micro(int rounds) {
+    const int n = 4096;
+
+    mt19937 rng(12345);
+    uniform_real_distribution<float> unit(-1, 1);
+
+    vector<Ray4> rays;
+    vector<Vector4> normals;
+    vector<Float4> points;
+    for (int i = 0; i < n; i++) {
+        Point4 start(unit(rng), unit(rng), 5 + unit(rng));
+        Vector4 direction = Vector4(unit(rng) * 0.3f, unit(rng) * 0.3f, -1).normalized();
+        rays.push_back(Ray4(start, direction));
+        normals.push_back(Vector4(unit(rng), unit(rng), 1 + unit(rng)).normalized());
+        points.push_back(Float4(unit(rng), unit(rng), unit(rng), 1));
+    }
+
+    Point4 center(0, 0, 0);
+    Point4 v1(-1, -1, 0), v2(1, -1, 0), v3(0, 1, 0);
+    Sphere sphere(center, 0.7f, 0);
+    Triangle triangle(v1, v2, v3, 0);
+    Color ambient(0.1, 0.1, 0.1), diffuse(0.5, 0.6, 0.7), specular(0.3, 0.3, 0.3);
+    Material material;
+    material.set(ambient, diffuse, specular, 16);
+    Color light_color(1, 1, 1);
+    Matrix4 M = Matrix4::YRotation(30) * Matrix4::Translation(1, 2, 3);
+
+    vector<MicroResult> results;
+    double sum = 0;
+
+    auto time_op = [&](const char* name, const function<void()>& op) {
+        op(); // warm-up
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            op();
+        }
+        auto stop = chrono::steady_clock::now();
+        MicroResult result;
+        result.name = name;
+        result.ns_per_op = chrono::duration<double, nano>(stop - start).count() / ((double)n * rounds);
+        results.push_back(result);
+    };
+
+    Hit hit;
+    time_op("sphere", [&]() {
+        for (auto& ray : rays) {
+            if (sphere.intersects(ray, FLT_MAX, hit))
+                sum += hit.getDistance();
+        }
+    });
+
+    time_op("triangle", [&]() {
+        for (auto& ray : rays) {
+            if (triangle.intersects(ray, FLT_MAX, hit))
+                sum += hit.getDistance();
+        }
+    });
+
+    time_op("refract", [&]() {
+        for (int i = 0; i < n; i++) {
+            Vector4 R = mirror_direction(rays[i].direction, normals[i]);
+            Vector4 T;
+            if (refract(rays[i].direction, normals[i], 1.0f, 1.3f, T))
+                R += T;
+            sum += R.X();
+        }
+    });
+
+    time_op("shade", [&]() {
+        for (int i = 0; i < n; i++) {
+            Vector4 V = -rays[i].direction;
+            Vector4 L = normals[(i + 1) % n];
+            sum += local_illumination(V, normals[i], L, material, light_color).R();
+        }
+    });
+
+    time_op("normalize", [&]() {
+        for (int i = 0; i < n; i++) {
+            Vector4 d = rays[i].start - center;
+            sum += d.normalized().Y();
+        }
+    });
+
+    time_op("matrix_point", [&]() {
+        for (int i = 0; i < n; i++) {
+            sum += (M * points[i]).Z();
+        }
+    });
+
+    time_op("matrix_matrix", [&]() {
+        Matrix4 P = M;
+        for (int i = 0; i < n; i++) {
+            P = P * M;
+            P[0][3] = points[i].X();
+        }
+        sum += P[1][1];
+    });
+
+    sink = sum;
+    return results;
+}
+
+double FrameTimes::mean() const {
+    double total = 0;
+    for (double t : ms)
+        total += t;
+    return ms.empty() ? 0 : total / ms.size();
+}
+
+double FrameTimes::min() const {
+    return ms.empty() ? 0 : *min_element(ms.begin(), ms.end());
+}
+
+double FrameTimes::max() const {
+    return ms.empty() ? 0 : *max_element(ms.begin(), ms.end());
+}
+
+double FrameTimes::percentile(double p) const {
+    if (ms.empty())
+        return 0;
+    vector<double> sorted = ms;
+    sort(sorted.begin(), sorted.end());
+    int rank = (int)ceil(p / 100 * sorted.size());
+    return sorted[std::max(rank, 1) - 1];
+}
+
+FrameTimes time_frames(int frames) {
+    FrameTimes times;
+
+    render(); // warm-up
+    times.rays = frame_stats.rays;
+
+    for (int f = 0; f < frames; f++) {
+        auto start = chrono::steady_clock::now();
+        render();
+        auto stop = chrono::steady_clock::now();
+        times.ms.push_back(chrono::duration<double, milli>(stop - start).count());
+    }
+    return times;
+}
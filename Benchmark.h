@@ -0,0 +1,47 @@
+#if !defined(_BENCHMARK_H_)
+
+#define _BENCHMARK_H_
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Timing for the tracer, shared by "rt --bench-math" and
+// the bench program.
+//
+// The micro benchmarks run the per-ray math (ray-object
+// tests, reflection, refraction, shading, matrices) on
+// random inputs, one call at a time.  time_frames()
+// renders the current scene over and over, and keeps
+// every frame's time.
+//
+//////////////////////////////////////////////////////////
+
+struct MicroResult {
+    string name;
+    double ns_per_op;
+};
+
+// Each operation is run "rounds" times over 4096 inputs.
+vector<MicroResult> benchmark_micro(int rounds);
+
+struct FrameTimes {
+    vector<double> ms; // every frame's time, in the order rendered
+    long rays;         // rays traced per frame
+
+    double mean() const;
+    double min() const;
+    double max() const;
+
+    // The p-th percentile (0 <= p <= 100), by nearest rank
+    double percentile(double p) const;
+};
+
+// Render one frame to warm up, then time "frames" more, at
+// the current size and thread count.
+FrameTimes time_frames(int frames);
+
+#endif
@@ -5,61 +5,109 @@
 
 class Color : public Float4 {
 public:
-    Color();
-    Color(float red, float green, float blue);
-    void set(float red, float green, float blue);
+    constexpr Color() : Float4(0, 0, 0, 1) {};
+    constexpr Color(float red, float green, float blue) : Float4(red, green, blue, 1) {};
+    void set(float red, float green, float blue) {Float4::set(red, green, blue, 1);};
     void clamp();
 
-    // Assignment.
-    Color& operator=(const Color& r);
-
     // add a color to this
-    Color& operator+=(const Color& r);
+    Color& operator+=(const Color& r) {
+        plus(r, *this);
+        return *this;
+    };
 
     // multiply a color into this
-    Color& operator*=(const Color& r);
+    Color& operator*=(const Color& r) {
+        store(v, mul(load(v), load(r.v)));
+        v[3] = 1;
+        return *this;
+    };
 
     // scale this color
-    Color& operator*=(float amount);
+    Color& operator*=(float amount) {
+        times(amount, *this);
+        return *this;
+    };
 
     // scale this color by reciprocal
-    Color& operator/=(float amount);
+    Color& operator/=(float amount) {
+        assert(amount != 0);
+        times(1.0f / amount, *this);
+        return *this;
+    };
 
     // Add two colors
-    Color operator+(const Color& other) const;
+    Color operator+(const Color& other) const {
+        Color result;
+        store(result.v, add(load(v), load(other.v)));
+        result.v[3] = 1;
+        return result;
+    };
 
     // Component-wise product of two colors.
-    Color operator*(const Color& other) const;
+    Color operator*(const Color& other) const {
+        Color result;
+        store(result.v, mul(load(v), load(other.v)));
+        result.v[3] = 1;
+        return result;
+    };
 
     // Color-and-scalar arithmetic operations
     //
     // vector * scalar
 
-    Color operator*(float factor) const;
+    Color operator*(float factor) const {
+        Color result;
+        store(result.v, mul(load(v), factor));
+        result.v[3] = 1;
+        return result;
+    };
 
     //
     // scalar * color
     //
 
-    friend Color operator*(float factor, const Color& other);
+    friend Color operator*(float factor, const Color& other) {
+        return other * factor;
+    };
 
     // divide (scale by reciprocal)
-    Color operator/(float factor) const;
+    Color operator/(float factor) const {
+        assert(factor != 0);
+        return *this * (1.0f / factor);
+    };
 
     // Assignment.
-    Color& operator=(const Float4& r);
+    Color& operator=(const Float4& r) {
+        copyFrom(r);
+        return *this;
+    };
 
     // Named access to the three components: L-values
 
-    float& R();
-    float& G();
-    float& B();
+    float& R() {return v[0];};
+    float& G() {return v[1];};
+    float& B() {return v[2];};
 
     // Named access to the components: R-values
 
-    const float& R() const;
-    const float& G() const;
-    const float& B() const;
+    constexpr const float& R() const {return v[0];};
+    constexpr const float& G() const {return v[1];};
+    constexpr const float& B() const {return v[2];};
 };
 
+static_assert(is_trivially_copyable<Color>::value, "Color must be trivially copyable");
+
+inline void Color::clamp()
+{
+    if (R() < 0) R() = 0;
+    if (R() > 1) R() = 1;
+
+    if (G() < 0) G() = 0;
+    if (G() > 1) G() = 1;
+
+    if (B() < 0) B() = 0;
+    if (B() > 1) B() = 1;
+}
+
 #endif
@@ -6,8 +6,25 @@
 #endif
 
 #include <assert.h>
+#include <stdio.h>
 #include <iostream>
 #include <math.h>
+#include <string>
+#include <type_traits>
+
+//
+// Everything here is inline, so the arithmetic in the tracer's inner
+// loops compiles down to a few instructions at the call site.  The four
+// components are operated on together in an SSE (x86) or NEON (ARM)
+// register where the compiler has one, and one at a time otherwise.
+//
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GEOMLIB_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define GEOMLIB_NEON
+#include <arm_neon.h>
+#endif
 
 #ifndef EPSILON
 #define EPSILON 0.00001
@@ -58,52 +75,58 @@ public:
     //
     // Default constructor
     //
-    Float4();
+    constexpr Float4() : v{0, 0, 0, 1} {};
 
     //
     // Explicit constructor
     //
-    Float4(const float x, const float y, const float z, const float w);
-
-    //
-    // Copy constructor
-    //
-    Float4(const Float4 &r);
+    constexpr Float4(const float x, const float y, const float z, const float w)
+        : v{x, y, z, w} {};
 
     //
     // Intialize all 4 components
     //
-    void set(float x, float y, float z, float w);
+    void set(float x, float y, float z, float w) {
+        v[0] = x;
+        v[1] = y;
+        v[2] = z;
+        v[3] = w;
+    };
 
-    Point4 homogenized();
+    Point4 homogenized() const;
 
     // Compare for equality
 
-    bool operator==(const Float4& other);
+    bool operator==(const Float4& other) const;
 
     // Access internal components of point's data array.
 
     // L-value (on left of = sign)
 
-    float& operator [](int index);
+    float& operator [](int index) {
+        assert (0 <= index && index <= 3);
+        return v[index];
+    };
 
     // R-value (on right of = sign)
 
-    const float& operator [](int index) const;
+    constexpr const float& operator [](int index) const {
+        return assert (0 <= index && index <= 3), v[index];
+    };
 
     // Named access to the four components: L-values
 
-    float& X();
-    float& Y();
-    float& Z();
-    float& W();
+    float& X() {return v[0];};
+    float& Y() {return v[1];};
+    float& Z() {return v[2];};
+    float& W() {return v[3];};
 
     // Named access to the components: R-values
 
-    const float& X() const;
-    const float& Y() const;
-    const float& Z() const;
-    const float& W() const;
+    constexpr const float& X() const {return v[0];};
+    constexpr const float& Y() const {return v[1];};
+    constexpr const float& Z() const {return v[2];};
+    constexpr const float& W() const {return v[3];};
 
     //
     // Output to stream
@@ -120,9 +143,38 @@ public:
 
 protected:
 
+    //
+    // The four components, as one SIMD register.
+    //
+#if defined(GEOMLIB_SSE)
+    typedef __m128 Lanes;
+    static Lanes load(const float* p) {return _mm_loadu_ps(p);};
+    static void store(float* p, Lanes a) {_mm_storeu_ps(p, a);};
+    static Lanes add(Lanes a, Lanes b) {return _mm_add_ps(a, b);};
+    static Lanes sub(Lanes a, Lanes b) {return _mm_sub_ps(a, b);};
+    static Lanes mul(Lanes a, Lanes b) {return _mm_mul_ps(a, b);};
+    static Lanes mul(Lanes a, float s) {return _mm_mul_ps(a, _mm_set1_ps(s));};
+#elif defined(GEOMLIB_NEON)
+    typedef float32x4_t Lanes;
+    static Lanes load(const float* p) {return vld1q_f32(p);};
+    static void store(float* p, Lanes a) {vst1q_f32(p, a);};
+    static Lanes add(Lanes a, Lanes b) {return vaddq_f32(a, b);};
+    static Lanes sub(Lanes a, Lanes b) {return vsubq_f32(a, b);};
+    static Lanes mul(Lanes a, Lanes b) {return vmulq_f32(a, b);};
+    static Lanes mul(Lanes a, float s) {return vmulq_n_f32(a, s);};
+#else
+    struct Lanes {float f[4];};
+    static Lanes load(const float* p) {return Lanes{{p[0], p[1], p[2], p[3]}};};
+    static void store(float* p, Lanes a) {for (int i = 0; i < 4; i++) p[i] = a.f[i];};
+    static Lanes add(Lanes a, Lanes b) {for (int i = 0; i < 4; i++) a.f[i] += b.f[i]; return a;};
+    static Lanes sub(Lanes a, Lanes b) {for (int i = 0; i < 4; i++) a.f[i] -= b.f[i]; return a;};
+    static Lanes mul(Lanes a, Lanes b) {for (int i = 0; i < 4; i++) a.f[i] *= b.f[i]; return a;};
+    static Lanes mul(Lanes a, float s) {for (int i = 0; i < 4; i++) a.f[i] *= s; return a;};
+#endif
+
     // The data is stored here.
 
-    float v[4];
+    alignas(16) float v[4];
 };
 
 class Vector4;
@@ -132,25 +184,29 @@ public:
     //
     // return the distance from this point to "other".
     //
-    float distanceTo(Point4& other) const;
+    float distanceTo(const Point4& other) const;
 
     //
     // Default constructor
     //
-    Point4();
+    constexpr Point4() : Float4(0, 0, 0, 1) {};
 
     //
     // Explicit constructor
     //
-    Point4(const float x, const float y, const float z);
+    constexpr Point4(const float x, const float y, const float z)
+        : Float4(x, y, z, 1) {};
 
     //
     // Change the values
     //
-    void set(float x, float y, float z);
+    void set(float x, float y, float z) {Float4::set(x, y, z, 1.0f);};
 
     // Assignment.  Checks W component, just in case
-    Point4& operator=(const Float4& r);
+    Point4& operator=(const Float4& r) {
+        copyFrom(r);
+        return *this;
+    };
 
     // Add a vector to this point
     Point4& operator+=(const Vector4& r);
@@ -190,86 +246,133 @@ public:
     //
     // return the angle (in radians) between this vector and "other".
     //
-    float angle(Vector4& other) const;
+    float angle(const Vector4& other) const;
 
     //
     // Default constructor
     //
-    Vector4();
+    constexpr Vector4() : Float4(0, 0, 0, 0) {};
 
     //
     // Explicit constructor
     //
-    Vector4(float x, float y, float z);
+    constexpr Vector4(float x, float y, float z) : Float4(x, y, z, 0) {};
 
-    void set(float x, float y, float z);
-
-//    operator const Float4 () const;
-
-//    operator const Float4& () const;
+    void set(float x, float y, float z) {Float4::set(x, y, z, 0.0f);};
 
     // Assignment.  Checks W component, just in case
-    Vector4& operator=(const Float4& r);
+    Vector4& operator=(const Float4& r) {
+        copyFrom(r);
+        return *this;
+    };
 
     // subtract a vector from this
-    Vector4& operator-=(const Vector4& r);
+    Vector4& operator-=(const Vector4& r) {
+        this->minus(r, *this);
+        return *this;
+    };
 
     // add a vector to this
-    Vector4& operator+=(const Vector4& r);
+    Vector4& operator+=(const Vector4& r) {
+        this->plus(r, *this);
+        return *this;
+    };
 
     // scale this vector
-    Vector4& operator*=(float amount);
+    Vector4& operator*=(float amount) {
+        this->times(amount, *this);
+        return *this;
+    };
 
     // scale this vector by reciprocal
-    Vector4& operator/=(float amount);
+    Vector4& operator/=(float amount) {
+        assert(amount != 0);
+        this->times(1.0f / amount, *this);
+        return *this;
+    };
 
     // Unary arithmetic operations.
 
     // Negate (flip) this vector
-    Vector4 operator-() const;
+    Vector4 operator-() const {
+        Vector4 result;
+        this->times(-1.0f, result);
+        return result;
+    };
 
     // Binary arithmetic operations
 
     // Add two vectors
-    Vector4 operator+(const Vector4& other) const;
+    Vector4 operator+(const Vector4& other) const {
+        Vector4 result;
+        this->plus(other, result);
+        return result;
+    };
 
     // subtract two vectors
-    Vector4 operator-(const Vector4& other) const;
+    Vector4 operator-(const Vector4& other) const {
+        Vector4 result;
+        this->minus(other, result);
+        return result;
+    };
 
     // add a point: yields a point
-    Point4 operator+(const Point4& other) const;
+    Point4 operator+(const Point4& other) const {
+        Point4 result;
+        this->plus(other, result);
+        return result;
+    };
 
     // Vector4-and-scalar arithmetic operations
     //
     // vector * scalar
 
-    Vector4 operator*(float factor) const;
+    Vector4 operator*(float factor) const {
+        Vector4 result;
+        this->times(factor, result);
+        return result;
+    };
 
     //
     // scalar * vector
     //
 
-    friend Vector4 operator*(float factor, const Vector4& other);
+    friend Vector4 operator*(float factor, const Vector4& other) {
+        return other * factor;
+    };
 
     // divide (scale by reciprocal)
-    Vector4 operator/(float factor) const;
+    Vector4 operator/(float factor) const {
+        assert(factor != 0);
+        Vector4 result;
+        this->times(1.0f / factor, result);
+        return result;
+    };
 
     //
     // Returns a normalized version of this vector.
     //
-    Vector4 normalized() const;
+    Vector4 normalized() const {
+        Vector4 result;
+        this->normalize(result);
+        return result;
+    };
 
     //
     // Returns dot product of this and other.
     // * operator is DOT product !!!!!
     //
-    float operator*(const Vector4& other) const;
+    float operator*(const Vector4& other) const {return dot(other);};
 
     //
     // Returns cross product of this and other.
     // ^ operator is CROSS product !!!!
     //
-    Vector4 operator^(const Vector4& other) const;
+    Vector4 operator^(const Vector4& other) const {
+        Vector4 result;
+        this->cross(other, result);
+        return result;
+    };
 };
 
 class Matrix4 {
@@ -277,16 +380,19 @@ public:
     //
     // Default constructor: set to identity matrix.
     //
-    Matrix4();
+    constexpr Matrix4()
+        : m{Float4(1,0,0,0), Float4(0,1,0,0), Float4(0,0,1,0), Float4(0,0,0,1)} {};
 
     //
     // Explicit constructor.
     //
 
-  Matrix4(float xx, float xy, float xz, float xw,
-          float yx, float yy, float yz, float yw,
-          float zx, float zy, float zz, float zw,
-          float wx, float wy, float wz, float ww);
+  constexpr Matrix4(float xx, float xy, float xz, float xw,
+                    float yx, float yy, float yz, float yw,
+                    float zx, float zy, float zz, float zw,
+                    float wx, float wy, float wz, float ww)
+      : m{Float4(xx,xy,xz,xw), Float4(yx,yy,yz,yw),
+          Float4(zx,zy,zz,zw), Float4(wx,wy,wz,ww)} {};
 
   //
   // Initialize all 16 components.
@@ -295,18 +401,21 @@ public:
   void set(float xx, float xy, float xz, float xw,
            float yx, float yy, float yz, float yw,
            float zx, float zy, float zz, float zw,
-           float wx, float wy, float wz, float ww);
-
-  //
-  // Copy Constructor.
-  //
-
-  Matrix4(const Matrix4& other);
+           float wx, float wy, float wz, float ww) {
+      m[0].set(xx,xy,xz,xw);
+      m[1].set(yx,yy,yz,yw);
+      m[2].set(zx,zy,zz,zw);
+      m[3].set(wx,wy,wz,ww);
+  };
 
   //
   // Set a single entry.
   //
-  void set(int row, int col, float value);
+  void set(int row, int col, float value) {
+      assert(0 <= row && row <= 3 &&
+             0 <= col && col <= 3);
+      m[row][col] = value;
+  };
 
   //
   // Copy all components of other matrix into this.
@@ -350,7 +459,12 @@ public:
   //
   // Set this matrix to identity matrix.
   //
-  void setToIdentity();
+  void setToIdentity() {
+      set(1,0,0,0,
+          0,1,0,0,
+          0,0,1,0,
+          0,0,0,1);
+  };
 
   //
   // Set this matrix to rotation about X axis.
@@ -373,26 +487,45 @@ public:
   //
   // Set this matrix to translation matrix.
   //
-  void setToTranslation(float tx, float ty, float tz);
+  void setToTranslation(float tx, float ty, float tz) {
+      set(1,0,0,tx,
+          0,1,0,ty,
+          0,0,1,tz,
+          0,0,0,1);
+  };
 
   //
   // Set this matrix to scaling matrix.
   //
-  void setToScaling(float sx, float sy, float sz);
+  void setToScaling(float sx, float sy, float sz) {
+      set(sx,0,0,0,
+          0,sy,0,0,
+          0,0,sz,0,
+          0,0,0,1);
+  };
 
   //
   // Array-access operators
   //
 
-  Float4& operator[](int index);
+  Float4& operator[](int index) {
+      assert(0 <= index && index <= 3);
+      return m[index];
+  };
 
-  const Float4& operator [](int index) const;
+  constexpr const Float4& operator [](int index) const {
+      return assert(0 <= index && index <= 3), m[index];
+  };
 
   //
   // Unary operations
   //
 
-  Matrix4 transpose() const;
+  Matrix4 transpose() const {
+      Matrix4 result;
+      transpose(result);
+      return result;
+  };
 
   Matrix4 adjoint() const;
 
@@ -400,7 +533,11 @@ public:
 
   float determinant() const;
 
-  Matrix4 operator-() const;
+  Matrix4 operator-() const {
+      Matrix4 result;
+      this->times(-1.0f, result);
+      return result;
+  };
 
 
   //
@@ -425,31 +562,67 @@ public:
   // Modifying operations.
   //
 
-  Matrix4& operator=(const Matrix4& other);
-
-  Matrix4& operator+=(const Matrix4& other);
+  Matrix4& operator+=(const Matrix4& other) {
+      this->plus(other, *this);
+      return *this;
+  };
 
-  Matrix4& operator-=(const Matrix4& other);
+  Matrix4& operator-=(const Matrix4& other) {
+      this->minus(other, *this);
+      return *this;
+  };
 
-  Matrix4& operator*=(float amount);
+  Matrix4& operator*=(float amount) {
+      this->times(amount, *this);
+      return *this;
+  };
 
-  Matrix4& operator/=(float amount);
+  Matrix4& operator/=(float amount) {
+      assert(amount != 0);
+      this->times(1.0f/amount, *this);
+      return *this;
+  };
 
   //
   // Binary operations.
   //
 
-  Matrix4 operator+(const Matrix4& other) const;
+  Matrix4 operator+(const Matrix4& other) const {
+      Matrix4 result;
+      this->plus(other, result);
+      return result;
+  };
 
-  Matrix4 operator-(const Matrix4& other) const;
+  Matrix4 operator-(const Matrix4& other) const {
+      Matrix4 result;
+      this->minus(other, result);
+      return result;
+  };
 
-  Matrix4 operator*(float factor) const;
+  Matrix4 operator*(float factor) const {
+      Matrix4 result;
+      this->times(factor, result);
+      return result;
+  };
 
-  Matrix4 operator/(float factor) const;
+  Matrix4 operator/(float factor) const {
+      assert(factor != 0);
+      Matrix4 result;
+      this->times(1.0f/factor, result);
+      return result;
+  };
 
-  Matrix4 operator*(const Matrix4& other) const;
+  Matrix4 operator*(const Matrix4& other) const {
+      Matrix4 result;
+      this->times(other, result);
+      return result;
+  };
 
-  Float4 operator*(const Float4& other) const;
+  Float4 operator*(const Float4& other) const {
+      Float4 result;
+      this->times(other, result);
+      return result;
+  };
 
   //
   // Static matrices: standard transformations
@@ -511,19 +684,24 @@ private:
 class Plane4 : public Float4 {
 public:
     // evaluates *this implicit plane equation at "other".
-    float at(Point4& other) const;
+    float at(const Point4& other) const {return dot(other);};
 
     // returns true iff *this is parallel to "other".
-    bool isParallelTo(Plane4& other) const;
+    bool isParallelTo(const Plane4& other) const {
+        return N.angle(other.N) < EPSILON;
+    };
 
     //
     // Default constructor
     //
-    Plane4();
+    constexpr Plane4() : Float4(0, 0, 0, 1) {};
 
     // construct the of the plane passing through
     // pointOnPlane and orthogonal to normal.
-    Plane4(const Point4& pointOnPlane, const Vector4& normal);
+    Plane4(const Point4& pointOnPlane, const Vector4& normal)
+        : Q(pointOnPlane), N(normal) {
+        set(N.X(), N.Y(), N.Z(), -N.dot(Q));
+    };
 
     Point4 Q;  // A point on the plane
     Vector4 N; // A vector normal to the plane
@@ -537,7 +715,7 @@ public:
     //
     // The point which is t units of "direction" forward from "start"
     // (ie, start + t * direction)
-    Point4 at(float t) const;
+    Point4 at(float t) const {return start + t * direction;};
 
     //
     // Computes intersection between this ray and plane
@@ -549,17 +727,17 @@ public:
     //
     // Default constructor
     //
-    Ray4();
+    constexpr Ray4() : start(0, 0, 0), direction(1, 0, 0) {};
 
     //
     // Constructor, given a start and a direction.
     //
-    Ray4(Point4& s, Vector4& d);
+    constexpr Ray4(const Point4& s, const Vector4& d) : start(s), direction(d) {};
 
     //
     // Constructor, given a start point and target point
     //
-    Ray4(Point4& s, Point4& target);
+    Ray4(const Point4& s, const Point4& target) : start(s), direction(target - s) {};
 
     Point4 start;
     Vector4 direction;
@@ -568,4 +746,504 @@ public:
 
 };
 
+// All of these are copied around by value, a lot.
+static_assert(is_trivially_copyable<Float4>::value, "Float4 must be trivially copyable");
+static_assert(is_trivially_copyable<Point4>::value, "Point4 must be trivially copyable");
+static_assert(is_trivially_copyable<Vector4>::value, "Vector4 must be trivially copyable");
+static_assert(is_trivially_copyable<Matrix4>::value, "Matrix4 must be trivially copyable");
+static_assert(is_trivially_copyable<Ray4>::value, "Ray4 must be trivially copyable");
+
+/////////////////////////////////////////////////////////
+//
+// Float4
+//
+/////////////////////////////////////////////////////////
+
+inline Point4 Float4::homogenized() const
+{
+    Point4 result;
+    homogenize(result);
+    return result;
+}
+
+// Compare for equality
+
+inline bool Float4::operator==(const Float4& other) const
+{
+    float dx = v[0] - other[0];
+    float dy = v[1] - other[1];
+    float dz = v[2] - other[2];
+    float dw = v[3] - other[3];
+
+    // two points are considered equal if
+    // they are close enough; exact comparisons of floats is unwise
+
+    float sum = fabs(dx) + fabs(dy) + fabs(dz) + fabs(dw);
+    return sum < EPSILON;
+}
+
+//
+// Copy all components of "other" into this point.
+//
+inline void Float4::copyFrom(const Float4& other) {
+    store(v, load(other.v));
+}
+
+//
+// Add all four components of this and "other" into sum.
+//
+inline void Float4::plus(const Float4& other, Float4& sum) const {
+    store(sum.v, add(load(v), load(other.v)));
+}
+
+//
+// Subtract all four components of "other" from this point, into difference
+//
+inline void Float4::minus(const Float4& other, Float4& difference) const {
+    store(difference.v, sub(load(v), load(other.v)));
+}
+
+//
+// Dot product of all four (X Y Z W) components of "other" and this point.
+//
+// The products are rounded to float, then summed in double, in order.
+//
+inline float Float4::dot(const Float4& other) const {
+#if defined(GEOMLIB_SSE)
+    __m128 p = _mm_mul_ps(load(v), load(other.v));
+    __m128d p01 = _mm_cvtps_pd(p);
+    __m128d p23 = _mm_cvtps_pd(_mm_movehl_ps(p, p));
+    __m128d sum = _mm_add_sd(p01, _mm_unpackhi_pd(p01, p01));
+    sum = _mm_add_sd(sum, p23);
+    sum = _mm_add_sd(sum, _mm_unpackhi_pd(p23, p23));
+    return _mm_cvtsd_f64(sum);
+#else
+    float p[4];
+    store(p, mul(load(v), load(other.v)));
+    double sum = 0;
+    for (int i = 0; i < 4; i++)
+        sum += p[i];
+    return sum;
+#endif
+}
+
+//
+// Divide all 4 of this point components by W (if W==0, do nothing),
+// into result.
+//
+inline void Float4::homogenize(Float4& result) const {
+    double w = v[3];
+    if (w != 0) {
+        for (int i = 0; i < 4; i++)
+            result[i] /= w;
+    }
+}
+
+//
+// Multiply all four (X Y Z W) components of this point by scale factor,
+// into result.
+//
+inline void Float4::times(float factor, Float4& result) const {
+    store(result.v, mul(load(v), factor));
+}
+
+//
+// Output to stream
+//
+
+inline string format_number(double x, int width, int precision) {
+    if (width > 99)
+        width = 99;
+    char output[100];
+    char format[10];
+    int i_x = int(x);
+    if (fabs(i_x - x) < EPSILON) {
+        sprintf(format, "%%%dd", width);
+        sprintf(output, format, i_x);
+    }
+    else {
+        sprintf(format, "%%%d.%df", width, precision);
+        sprintf(output, format, x);
+    }
+    return string(output);
+}
+
+inline ostream& operator<<(ostream& os,const Float4& m) {
+    out_delimited(os, m, '[', ']');
+    return os;
+}
+
+inline void out_delimited(ostream& os, const Float4& m,
+                          char l_delim, char r_delim) {
+    os << l_delim << format_number(m.v[0], 6, 2);
+    os << " " << format_number(m.v[1], 6, 2);
+    os << " " << format_number(m.v[2], 6, 2);
+    os << " " << format_number(m.v[3], 6, 2) << r_delim;
+}
+
+// Read from stream
+
+inline istream& operator>>(istream& is, Float4& p) {
+    for (int c=0;c<4;c++) {
+        is >> p[c];
+    }
+    return is;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Point4
+//
+/////////////////////////////////////////////////////////
+
+// Add a vector to this point
+inline Point4& Point4::operator+=(const Vector4& r) {
+    this->plus(r, *this);
+    return *this;
+}
+
+// Sum of this point and a vector
+inline Point4 Point4::operator+(const Vector4& other) const {
+    Point4 result;
+    this->plus(other, result);
+    return result;
+}
+
+// Subtract a vector from this point
+inline Point4 Point4::operator-(const Vector4& other) const {
+    Point4 result;
+    this->minus(other, result);
+    return result;
+}
+
+// Difference of two points is a vector
+inline Vector4 Point4::operator-(const Point4& other) const {
+    Vector4 result;
+    this->minus(other, result);
+    return result;
+}
+
+//
+// return the distance from this point to "other".
+//
+inline float Point4::distanceTo(const Point4& other) const {
+    Vector4 offset = *this - other;
+    return offset.length();
+}
+
+/////////////////////////////////////////////////////////
+//
+// Vector4
+//
+/////////////////////////////////////////////////////////
+
+//
+// Length, using three (X Y Z) components of this point.
+//
+inline float Vector4::length() const {
+    return sqrt(*this * *this);
+}
+
+//
+// Divide first three (X Y Z) components of this point by length,
+// into result (if length==0, do nothing)
+//
+inline void Vector4::normalize(Vector4& result) const {
+    double l = this->length();
+    if (l != 0) {
+        times(1/l, result);
+    }
+}
+
+//
+// Cross product of this vector x "other", into result
+// Use only X Y Z components.
+// Sets W component of product to 0.
+//
+inline void Vector4::cross(const Vector4& other, Vector4& result) const {
+    float x = v[1] * other.v[2] - v[2] * other.v[1];
+    float y = v[2] * other.v[0] - v[0] * other.v[2];
+    float z = v[0] * other.v[1] - v[1] * other.v[0];
+    result.set(x, y, z);
+}
+
+//
+// return the angle (in radians) between this vector and "other".
+// If this or other is (0 0 0), return 0 angle.
+//
+inline float Vector4::angle(const Vector4& other) const {
+    double cosine = (*this * other) / (length() * other.length());
+    return acos(cosine);
+}
+
+/////////////////////////////////////////////////////////
+//
+// Matrix4
+//
+/////////////////////////////////////////////////////////
+
+/*------------------------------------------------------*/
+/*
+ * Invert a 4x4 matrix.  Adapted from Richard Carling's code
+ * in "Graphics Gems I".
+ */
+
+#define SMALL_NUMBER    (1.e-8)
+
+inline Matrix4 Matrix4::inverse() const {
+    Matrix4 result;
+
+    result = adjoint();
+
+    float det = determinant();
+
+    if ( fabs( det ) < SMALL_NUMBER) {
+        cerr << "(Matrix4::inverse) singular matrix, can't invert!" << endl;
+        det = 1;
+    }
+    result = result.transpose() * (1.0f/det);
+    return result;
+}
+
+inline Matrix4 Matrix4::adjoint() const {
+    Matrix4 result;
+    float a1, a2, a3, a4, b1, b2, b3, b4;
+    float c1, c2, c3, c4, d1, d2, d3, d4;
+
+    a1 = m[0][0]; b1 = m[0][1];
+    c1 = m[0][2]; d1 = m[0][3];
+
+    a2 = m[1][0]; b2 = m[1][1];
+    c2 = m[1][2]; d2 = m[1][3];
+
+    a3 = m[2][0]; b3 = m[2][1];
+    c3 = m[2][2]; d3 = m[2][3];
+
+    a4 = m[3][0]; b4 = m[3][1];
+    c4 = m[3][2]; d4 = m[3][3];
+
+    result.set(
+        det3x3( b2, b3, b4, c2, c3, c4, d2, d3, d4),
+        - det3x3( a2, a3, a4, c2, c3, c4, d2, d3, d4),
+        det3x3( a2, a3, a4, b2, b3, b4, d2, d3, d4),
+        - det3x3( a2, a3, a4, b2, b3, b4, c2, c3, c4),
+
+        - det3x3( b1, b3, b4, c1, c3, c4, d1, d3, d4),
+        det3x3( a1, a3, a4, c1, c3, c4, d1, d3, d4),
+        - det3x3( a1, a3, a4, b1, b3, b4, d1, d3, d4),
+        det3x3( a1, a3, a4, b1, b3, b4, c1, c3, c4),
+
+        det3x3( b1, b2, b4, c1, c2, c4, d1, d2, d4),
+        - det3x3( a1, a2, a4, c1, c2, c4, d1, d2, d4),
+        det3x3( a1, a2, a4, b1, b2, b4, d1, d2, d4),
+        - det3x3( a1, a2, a4, b1, b2, b4, c1, c2, c4),
+
+        - det3x3( b1, b2, b3, c1, c2, c3, d1, d2, d3),
+        det3x3( a1, a2, a3, c1, c2, c3, d1, d2, d3),
+        - det3x3( a1, a2, a3, b1, b2, b3, d1, d2, d3),
+        det3x3( a1, a2, a3, b1, b2, b3, c1, c2, c3));
+    return result;
+}
+
+inline float Matrix4::determinant() const {
+    float a1, a2, a3, a4, b1, b2, b3, b4, c1, c2, c3, c4, d1, d2, d3, d4;
+
+    a1 = m[0][0]; b1 = m[0][1]; c1 = m[0][2]; d1 = m[0][3];
+    a2 = m[1][0]; b2 = m[1][1]; c2 = m[1][2]; d2 = m[1][3];
+    a3 = m[2][0]; b3 = m[2][1]; c3 = m[2][2]; d3 = m[2][3];
+    a4 = m[3][0]; b4 = m[3][1]; c4 = m[3][2]; d4 = m[3][3];
+
+    return
+        a1 * det3x3( b2, b3, b4, c2, c3, c4, d2, d3, d4)
+        - b1 * det3x3( a2, a3, a4, c2, c3, c4, d2, d3, d4)
+        + c1 * det3x3( a2, a3, a4, b2, b3, b4, d2, d3, d4)
+        - d1 * det3x3( a2, a3, a4, b2, b3, b4, c2, c3, c4);
+}
+
+//
+// Copy all components of other matrix into this.
+//
+inline void Matrix4::copyFrom(const Matrix4& other) {
+    for (int row = 0; row < 4; row++)
+        m[row].copyFrom(other.m[row]);
+}
+
+//
+// Add all components of this and "other" matrix into sum
+//
+inline void Matrix4::plus(const Matrix4& other, Matrix4& sum) const {
+    for (int row = 0; row < 4; row++)
+        m[row].plus(other.m[row], sum.m[row]);
+}
+
+//
+// Subtract all components of this matrix minus "other", into difference
+//
+inline void Matrix4::minus(const Matrix4& other, Matrix4& difference) const {
+    for (int row = 0; row < 4; row++)
+        m[row].minus(other.m[row], difference.m[row]);
+}
+
+//
+// Multiply all components by factor, into product
+//
+inline void Matrix4::times(float factor, Matrix4& product) const {
+    for (int row = 0; row < 4; row++)
+        m[row].times(factor, product.m[row]);
+}
+
+//
+// Multiply (*this) x ("other"), and put product into product
+//
+// CAREFULL!! this may == &product!  So watch for partially-modified entries.
+// Store result in temp array first!
+//
+inline void Matrix4::times(const Matrix4& other, Matrix4 &product) const {
+    Matrix4 result;
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            double sum = 0;
+            for (int j = 0; j < 4; j++)
+                sum += m[row][j] * other.m[j][col];
+            result.m[row][col] = sum;
+        }
+    }
+    product = result;
+}
+
+//
+// Multiply (*this) x ("point"), and put resulting point into "product".
+// CAREFULL!! point may == product, so watch for partially-modified entries.
+// Store result in temp array first!
+//
+inline void Matrix4::times(const Float4& point, Float4& product) const {
+    Float4 result(m[0].dot(point), m[1].dot(point), m[2].dot(point), m[3].dot(point));
+    product = result;
+}
+
+//
+// Transpose this matrix, put result into result.
+//
+// CAREFULL!! possibly this == &result!  Watch for partially-modified entries.
+// Store result in temp array first!
+//
+inline void Matrix4::transpose(Matrix4& result) const {
+    Matrix4 temp;
+
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            temp.m[row][col] = m[col][row];
+        }
+    }
+    result = temp;
+}
+
+//
+// Set this matrix to rotation about X axis.
+// "angle" is in DEGREES.
+//
+inline void Matrix4::setToXRotation(float angle) {
+    double rads = angle * 3.1416 / 180;
+    double s = sin(rads);
+    double c = cos(rads);
+    set(1,0,0,0,
+        0,c,-s,0,
+        0,s,c,0,
+        0,0,0,1);
+}
+
+//
+// Set this matrix to rotation about Y axis.
+// "angle" is in DEGREES.
+//
+inline void Matrix4::setToYRotation(float angle) {
+    double rads = angle * 3.1416 / 180;
+    double s = sin(rads);
+    double c = cos(rads);
+    set(c,0,s,0,
+        0,1,0,0,
+        -s,0,c,0,
+        0,0,0,1);
+}
+
+//
+// Set this matrix to rotation about Z axis.
+// "angle" is in DEGREES.
+//
+inline void Matrix4::setToZRotation(float angle) {
+    double rads = angle * 3.1416 / 180;
+    double s = sin(rads);
+    double c = cos(rads);
+    set(c,-s,0,0,
+        s,c,0,0,
+        0,0,1,0,
+        0,0,0,1);
+}
+
+//
+// Output to a stream, in tidy format
+//
+inline ostream& operator<<(ostream& os, const Matrix4& mat) {
+    out_delimited(os, mat[0], '/', '\\');
+    os << "\n";
+    out_delimited(os, mat[1], '|', '|');
+    os << "\n";
+    out_delimited(os, mat[2], '|', '|');
+    os << "\n";
+    out_delimited(os, mat[3], '\\', '/');
+    os << "\n";
+    return os;
+}
+
+//
+// Read 16 numbers from a stream
+//
+inline istream& operator>>(istream& is, Matrix4& m) {
+    for (int row=0; row<4; row++)
+        for (int col=0; col<4; col++)
+        {
+            float val;
+            is >> val;
+            m[row][col] = val;
+        }
+    return is;
+}
+
+/////////////////////////////////////////////////////////
+//
+// Plane4 and Ray4
+//
+/////////////////////////////////////////////////////////
+
+inline ostream& operator<<(ostream& os, const Plane4& p) {
+    os << "Through " << p.Q << " normal to " << p.N;
+    return os;
+}
+
+//
+// Computes intersection between this ray and plane
+// If ray hits plane, sets the hitpoint and returns true.
+// If ray misses, returns false.
+// NOTE.  Intersections must have a POSITIVE t!
+inline bool Ray4::intersects(const Plane4& plane, Point4& hitPoint) const
+{
+    float num   = plane.N * (plane.Q - start);
+    float denom = plane.N * direction;
+    if (fabs(denom) > EPSILON)
+    {
+        float t = num / denom;
+        hitPoint = at(t);
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+inline ostream& operator<<(ostream& os, const Ray4& r) {
+    os << "S: " << r.start << " V: " << r.direction;
+    return os;
+}
+
 #endif
@@ -0,0 +1,201 @@
+#include "Grid.h"
+
+#include <cmath>
+#include <float.h>
+
+// Cells per object: under one, since the kernels test
+// several objects at about the cost of one
+static const float DENSITY = 0.5f;
+
+// The grid is no finer than this along any axis
+static const int MAX_RES = 512;
+
+Grid::Grid() {
+    res[0] = res[1] = res[2] = 0;
+    n_parts = 0;
+}
+
+void Grid::build(const vector<Object*>& objects, int /*n_threads*/) {
+    box = AABB();
+    starts.clear();
+    leaf_objects.clear();
+    res[0] = res[1] = res[2] = 0;
+    n_parts = 0;
+
+    vector<Part> parts = split_meshes(objects);
+    if (parts.empty())
+        return;
+    n_parts = (int)parts.size();
+    for (auto& part : parts)
+        box.expand(part.box);
+
+    // Give flat sides some thickness, so every cell has a volume.
+    float extent[3];
+    float longest = 0;
+    for (int axis = 0; axis < 3; axis++)
+        longest = max(longest, box.hi[axis] - box.lo[axis]);
+    float min_extent = max(longest * 1e-3f, 1e-3f);
+    for (int axis = 0; axis < 3; axis++) {
+        float pad = (min_extent - (box.hi[axis] - box.lo[axis])) / 2;
+        if (pad > 0) {
+            box.lo[axis] -= pad;
+            box.hi[axis] += pad;
+        }
+        extent[axis] = box.hi[axis] - box.lo[axis];
+    }
+
+    float cells_per_unit = cbrtf(DENSITY * n_parts / (extent[0] * extent[1] * extent[2]));
+    for (int axis = 0; axis < 3; axis++) {
+        res[axis] = min(max((int)(extent[axis] * cells_per_unit + 0.5f), 1), MAX_RES);
+        cell_size[axis] = extent[axis] / res[axis];
+        inv_cell_size[axis] = 1 / cell_size[axis];
+    }
+    int n_cells = res[0] * res[1] * res[2];
+
+    // The cells each part's box overlaps
+    auto cell_range = [&](const Part& part, int lo[3], int hi[3]) {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = (int)((part.box.lo[axis] - box.lo[axis]) * inv_cell_size[axis]);
+            hi[axis] = (int)((part.box.hi[axis] - box.lo[axis]) * inv_cell_size[axis]);
+            lo[axis] = min(max(lo[axis], 0), res[axis] - 1);
+            hi[axis] = min(max(hi[axis], 0), res[axis] - 1);
+        }
+    };
+
+    // Count the parts in each cell, then list them, cell by cell.
+    vector<int> first(n_cells + 1, 0);
+    int n_spheres = 0, n_triangles = 0, n_instances = 0;
+    for (auto& part : parts) {
+        int lo[3], hi[3];
+        cell_range(part, lo, hi);
+        int n = 0;
+        int cell[3];
+        for (cell[2] = lo[2]; cell[2] <= hi[2]; cell[2]++)
+            for (cell[1] = lo[1]; cell[1] <= hi[1]; cell[1]++)
+                for (cell[0] = lo[0]; cell[0] <= hi[0]; cell[0]++, n++)
+                    first[index(cell) + 1]++;
+        if (part.obj->type == SPHERE)
+            n_spheres += n;
+        else if (part.obj->type == TRIANGLE || part.obj->type == MESH)
+            n_triangles += n;
+        else
+            n_instances += n;
+    }
+    for (int i = 0; i < n_cells; i++)
+        first[i + 1] += first[i];
+
+    vector<int> listed(first[n_cells]);
+    vector<int> next(first.begin(), first.end() - 1);
+    for (int p = 0; p < n_parts; p++) {
+        int lo[3], hi[3];
+        cell_range(parts[p], lo, hi);
+        int cell[3];
+        for (cell[2] = lo[2]; cell[2] <= hi[2]; cell[2]++)
+            for (cell[1] = lo[1]; cell[1] <= hi[1]; cell[1]++)
+                for (cell[0] = lo[0]; cell[0] <= hi[0]; cell[0]++)
+                    listed[next[index(cell)]++] = p;
+    }
+
+    leaf_objects.reserve(n_spheres, n_triangles, n_instances);
+    starts.resize(n_cells + 1);
+    for (int i = 0; i <= n_cells; i++) {
+        Leaf leaf = leaf_objects.begin();
+        starts[i].sphere = leaf.first_sphere;
+        starts[i].triangle = leaf.first_triangle;
+        starts[i].instance = leaf.first_instance;
+        if (i == n_cells)
+            break;
+        for (int j = first[i]; j < first[i + 1]; j++)
+            leaf_objects.add(leaf, parts[listed[j]].obj, parts[listed[j]].part);
+    }
+}
+
+//
+// Clip the ray to the grid, and find the cell it starts in
+// and the t of each of that cell's far walls.
+//
+bool Grid::start(const Ray4& ray, float t_max, Walk& walk) const {
+    if (starts.empty())
+        return false;
+
+    Vector4 inv_dir(1.0f / ray.direction.X(),
+                    1.0f / ray.direction.Y(),
+                    1.0f / ray.direction.Z());
+    float t_near;
+    if (!box.clip(ray.start, inv_dir, t_max, t_near, walk.t_exit))
+        return false;
+
+    Point4 p = ray.at(t_near);
+    for (int axis = 0; axis < 3; axis++) {
+        int c = (int)((p[axis] - box.lo[axis]) * inv_cell_size[axis]);
+        c = min(max(c, 0), res[axis] - 1);
+        walk.cell[axis] = c;
+
+        float d = ray.direction[axis];
+        if (d > 0) {
+            walk.step[axis] = 1;
+            walk.t_next[axis] = (box.lo[axis] + (c + 1) * cell_size[axis] - ray.start[axis]) * inv_dir[axis];
+            walk.t_delta[axis] = cell_size[axis] * inv_dir[axis];
+        }
+        else if (d < 0) {
+            walk.step[axis] = -1;
+            walk.t_next[axis] = (box.lo[axis] + c * cell_size[axis] - ray.start[axis]) * inv_dir[axis];
+            walk.t_delta[axis] = -cell_size[axis] * inv_dir[axis];
+        }
+        else {
+            walk.step[axis] = 0;
+            walk.t_next[axis] = FLT_MAX;
+            walk.t_delta[axis] = 0;
+        }
+    }
+    return true;
+}
+
+bool Grid::first_hit(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) {
+    Walk walk;
+    if (!start(ray, t_max, walk))
+        return false;
+
+    SphereRay sphere_ray(ray);
+    TriangleRay triangle_ray(ray);
+    LeafHit best(t_max);
+
+    do {
+        leaf_objects.nearest(leaf(walk.cell), ray, sphere_ray, triangle_ray, best, hit, ctx);
+
+        // A hit inside this cell is nearer than anything in the
+        // cells after it.  (One farther on may be in a later cell
+        // too: keep going.)
+        float t_far = min(walk.t_next[0], min(walk.t_next[1], walk.t_next[2]));
+        if (best.t <= t_far)
+            break;
+    } while (advance(walk));
+
+    leaf_objects.setHit(best, ray, hit);
+    return best.found;
+}
+
+bool Grid::occluded(Ray4& ray, float t_max, TraceContext& ctx) {
+    Walk walk;
+    if (!start(ray, t_max, walk))
+        return false;
+
+    SphereRay sphere_ray(ray);
+    TriangleRay triangle_ray(ray);
+    do {
+        if (leaf_objects.any(leaf(walk.cell), ray, sphere_ray, triangle_ray, t_max, ctx))
+            return true;
+    } while (advance(walk));
+    return false;
+}
+
+size_t Grid::bytes() const {
+    return starts.capacity() * sizeof(CellStart) + leaf_objects.bytes();
+}
+
+void Grid::describe(ostream& os) const {
+    os << "Grid " << res[0] << " x " << res[1] << " x " << res[2] << " cells, "
+       << n_parts << " objects listed as " << leaf_objects.spheres() << " spheres + "
+       << leaf_objects.triangles() << " triangles (" << simd_name() << " kernels) + "
+       << leaf_objects.instances() << " instances";
+}
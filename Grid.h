@@ -0,0 +1,109 @@
+#if !defined(_GRID_H_)
+
+#define _GRID_H_
+
+#include <vector>
+
+#include "Accelerator.h"
+#include "LeafObjects.h"
+
+//////////////////////////////////////////////////////////
+//
+// Uniform grid over the scene's objects.
+//
+// The scene's box is cut into equal cells, one for every
+// two objects or so, shaped as close to cubes as the box
+// allows.  Each cell lists every object whose box
+// overlaps it.  A ray walks the cells it passes through in
+// order (3D-DDA), testing each cell's objects, and stops at
+// the first cell that ends beyond its nearest hit.
+//
+// Cheap to build and good for evenly spread objects; bad
+// when a few cells hold most of them.
+//
+//////////////////////////////////////////////////////////
+
+class Grid final : public Accelerator {
+public:
+    Grid();
+
+    // Built on one thread, whatever n_threads says
+    void build(const vector<Object*>& objects, int n_threads = 0) override;
+
+    using Accelerator::first_hit;
+    bool first_hit(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) override;
+    bool occluded(Ray4& ray, float t_max, TraceContext& ctx) override;
+
+    AABB bounds() const override {return box;};
+    size_t bytes() const override;
+    string name() const override {return "grid";};
+    void describe(ostream& os) const override;
+
+private:
+    // Where a ray's walk through the cells starts, and how it steps
+    struct Walk {
+        int cell[3];
+        int step[3];      // +1, -1 or 0 (parallel to the axis)
+        float t_next[3];  // t where the ray leaves the cell along each axis
+        float t_delta[3]; // t across one cell along each axis
+        float t_exit;     // t where it leaves the grid
+    };
+
+    bool start(const Ray4& ray, float t_max, Walk& walk) const;
+
+    // Step to the next cell; false past the grid or t_exit
+    bool advance(Walk& walk) const;
+
+    // The objects of cell (x, y, z)
+    Leaf leaf(const int cell[3]) const;
+    int index(const int cell[3]) const {
+        return (cell[2] * res[1] + cell[1]) * res[0] + cell[0];
+    };
+
+    // Where each cell's objects start: cell i's spheres are
+    // starts[i].sphere .. starts[i + 1].sphere, and so on.
+    struct CellStart {
+        int sphere;
+        int triangle;
+        int instance;
+    };
+
+    AABB box;
+    int res[3];
+    float cell_size[3];
+    float inv_cell_size[3];
+    vector<CellStart> starts;
+    LeafObjects leaf_objects;
+    int n_parts;
+};
+
+// Inline: these run at every cell a ray visits
+
+inline Leaf Grid::leaf(const int cell[3]) const {
+    int i = index(cell);
+    Leaf leaf;
+    leaf.first_sphere = starts[i].sphere;
+    leaf.n_spheres = starts[i + 1].sphere - starts[i].sphere;
+    leaf.first_triangle = starts[i].triangle;
+    leaf.n_triangles = starts[i + 1].triangle - starts[i].triangle;
+    leaf.first_instance = starts[i].instance;
+    leaf.n_instances = starts[i + 1].instance - starts[i].instance;
+    return leaf;
+}
+
+inline bool Grid::advance(Walk& walk) const {
+    int axis = 0;
+    if (walk.t_next[1] < walk.t_next[axis])
+        axis = 1;
+    if (walk.t_next[2] < walk.t_next[axis])
+        axis = 2;
+    if (walk.t_next[axis] > walk.t_exit)
+        return false;
+    walk.cell[axis] += walk.step[axis];
+    if (walk.cell[axis] < 0 || walk.cell[axis] >= res[axis])
+        return false;
+    walk.t_next[axis] += walk.t_delta[axis];
+    return true;
+}
+
+#endif
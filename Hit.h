@@ -19,7 +19,7 @@ public:
     Point4 p;
     Vector4 N;
     Object* obj;
-    double dist;
+    double dist; // t along the ray (in a group's space too: see Instance.h)
 };
 
 #endif
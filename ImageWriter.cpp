@@ -0,0 +1,146 @@
+#include "ImageWriter.h"
+
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+bool write_image(const string& filename, int width, int height,
+                 const unsigned char *rgb) {
+    string ext;
+    size_t dot = filename.rfind('.');
+    if (dot != string::npos) {
+        for (size_t i = dot; i < filename.length(); i++) {
+            ext += (char)tolower(filename[i]);
+        }
+    }
+
+    if (ext == ".ppm")
+        return write_ppm(filename, width, height, rgb);
+    if (ext == ".png")
+        return write_png(filename, width, height, rgb);
+
+    cerr << "Can't write " << filename << ": use a .ppm or .png file name\n";
+    return false;
+}
+
+bool write_ppm(const string& filename, int width, int height,
+               const unsigned char *rgb) {
+    ofstream out(filename, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Can't write to " << filename << endl;
+        return false;
+    }
+
+    out << "P6\n" << width << " " << height << "\n255\n";
+    // Files go top row first.
+    for (int y = height - 1; y >= 0; y--) {
+        out.write((const char *)(rgb + y * width * 3), width * 3);
+    }
+    return out.good();
+}
+
+//////////////////////////////////////////////////////////
+// PNG
+//
+// The pixels go into "stored" (uncompressed) deflate
+// blocks, which any PNG reader accepts, so we need no
+// zlib: just the two checksums.
+//////////////////////////////////////////////////////////
+
+static uint32_t crc32(const unsigned char *data, size_t n, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool table_ready = false;
+    if (!table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_u32(vector<unsigned char>& out, uint32_t x) {
+    out.push_back((unsigned char)(x >> 24));
+    out.push_back((unsigned char)(x >> 16));
+    out.push_back((unsigned char)(x >> 8));
+    out.push_back((unsigned char)x);
+}
+
+// Append a chunk: length, type, data, CRC of type+data
+static void put_chunk(vector<unsigned char>& out, const char *type,
+                      const vector<unsigned char>& data) {
+    put_u32(out, (uint32_t)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32(out, crc32(&out[start], out.size() - start));
+}
+
+bool write_png(const string& filename, int width, int height,
+               const unsigned char *rgb) {
+    // Raw scanlines, top row first, each led by filter type 0 (none)
+    size_t row_bytes = (size_t)width * 3;
+    vector<unsigned char> raw;
+    raw.reserve((row_bytes + 1) * height);
+    for (int y = height - 1; y >= 0; y--) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + y * row_bytes, rgb + (y + 1) * row_bytes);
+    }
+
+    // zlib stream: header, stored blocks of up to 65535 bytes, Adler-32
+    vector<unsigned char> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t pos = 0;
+    do {
+        size_t n = raw.size() - pos;
+        if (n > 65535)
+            n = 65535;
+        bool last = (pos + n == raw.size());
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)(n & 0xff));
+        zlib.push_back((unsigned char)(n >> 8));
+        zlib.push_back((unsigned char)(~n & 0xff));
+        zlib.push_back((unsigned char)((~n >> 8) & 0xff));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + n);
+        pos += n;
+    } while (pos < raw.size());
+
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32(zlib, (b << 16) | a);
+
+    vector<unsigned char> header;
+    put_u32(header, (uint32_t)width);
+    put_u32(header, (uint32_t)height);
+    header.push_back(8); // bits per channel
+    header.push_back(2); // color type: RGB
+    header.push_back(0); // compression: deflate
+    header.push_back(0); // filter method
+    header.push_back(0); // no interlace
+
+    vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib);
+    put_chunk(png, "IEND", vector<unsigned char>());
+
+    ofstream out(filename, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Can't write to " << filename << endl;
+        return false;
+    }
+    out.write((const char *)png.data(), png.size());
+    return out.good();
+}
@@ -0,0 +1,30 @@
+#if !defined(_IMAGEWRITER_H_)
+
+#define _IMAGEWRITER_H_
+
+#include <string>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Write an RGB frame buffer (3 bytes per pixel, bottom
+// row first, as glDrawPixels wants it) to an image file.
+// The format comes from the file name's extension:
+// ".ppm" (binary P6) or ".png" (uncompressed deflate).
+//
+// Returns false, after printing why, if the file can't
+// be written.
+//
+//////////////////////////////////////////////////////////
+
+bool write_image(const string& filename, int width, int height,
+                 const unsigned char *rgb);
+
+bool write_ppm(const string& filename, int width, int height,
+               const unsigned char *rgb);
+
+bool write_png(const string& filename, int width, int height,
+               const unsigned char *rgb);
+
+#endif
@@ -0,0 +1,74 @@
+#include "Instance.h"
+#include "BVH.h"
+
+#include <iostream>
+using namespace std;
+
+Instance::Instance(int group, const Matrix4& transform) : Object(INSTANCE, 0) {
+    group_index = group;
+    bvh = NULL;
+    M = transform;
+    M_inv = transform.inverse();
+    name = "unnamed";
+}
+
+void Instance::transform(const Matrix4& M) {
+    this->M = M * this->M;
+    M_inv = this->M.inverse();
+}
+
+Ray4 Instance::to_group(const Ray4& ray) const {
+    Ray4 local;
+    local.start = M_inv * ray.start;
+    local.direction = M_inv * ray.direction;
+    return local;
+}
+
+bool Instance::intersects(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) {
+    Ray4 local = to_group(ray);
+    if (!bvh->first_hit(local, t_max, hit, ctx))
+        return false;
+
+    // Back to the scene: normals go by the inverse transpose.
+    hit.p = ray.at((float)hit.dist);
+    Float4 N = M_inv.transpose() * hit.N;
+    hit.N = Vector4(N.X(), N.Y(), N.Z()).normalized();
+    return true;
+}
+
+bool Instance::occludes(Ray4& ray, float t_max, TraceContext& ctx) {
+    Ray4 local = to_group(ray);
+    return bvh->occluded(local, t_max, ctx);
+}
+
+bool Instance::intersects(Ray4& ray, float t_max, Hit& hit) {
+    TraceContext ctx;
+    return intersects(ray, t_max, hit, ctx);
+}
+
+bool Instance::occludes(Ray4& ray, float t_max) {
+    TraceContext ctx;
+    return occludes(ray, t_max, ctx);
+}
+
+AABB Instance::bounds() {
+    AABB local = bvh->bounds();
+    AABB box;
+    if (local.isEmpty())
+        return box;
+    for (int corner = 0; corner < 8; corner++) {
+        Point4 p((corner & 1) ? local.hi.X() : local.lo.X(),
+                 (corner & 2) ? local.hi.Y() : local.lo.Y(),
+                 (corner & 4) ? local.hi.Z() : local.lo.Z());
+        Point4 q;
+        q = M * p;
+        box.expand(q);
+    }
+    return box;
+}
+
+ostream& operator<<(ostream& os, const Instance& instance) {
+    os << "Instance \"" << instance.name << "\" of group " << instance.group_index
+       << "\n" << instance.M;
+    return os;
+}
@@ -0,0 +1,57 @@
+#if !defined(_INSTANCE_H_)
+#define _INSTANCE_H_
+
+#include "Object.h"
+#include "GeomLib.h"
+#include "Hit.h"
+#include "TraceContext.h"
+
+class BVH;
+
+//////////////////////////////////////////////////////////
+//
+// A copy of a group of objects, placed in the scene by a
+// transform.  The group (and its BVH) is shared by all of
+// its instances: each one holds just the transform and its
+// inverse, so a thousand copies cost a thousand matrices,
+// not a thousand copies of the geometry.
+//
+// The scene's BVH holds the instances; a ray that reaches
+// one is taken into the group's space by the inverse and
+// traced through the group's BVH.  The direction is not
+// renormalized, so t means the same in both spaces.
+//
+//////////////////////////////////////////////////////////
+
+class Instance final : public Object {
+public:
+    // "transform" takes the group's space to the scene's
+    Instance(int group, const Matrix4& transform);
+
+    // The group's BVH, once it's built
+    void setGroup(BVH* bvh) {this->bvh = bvh;};
+    int group() const {return group_index;};
+    const Matrix4& transform() const {return M;};
+
+    // Move the instance by M (on top of its own transform)
+    void transform(const Matrix4& M);
+
+    bool intersects(Ray4& ray, float t_max, Hit& hit);
+    bool occludes(Ray4& ray, float t_max);
+    // The same, counting the group's tests in the BVH's context
+    bool intersects(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx);
+    bool occludes(Ray4& ray, float t_max, TraceContext& ctx);
+    AABB bounds();
+
+    friend ostream& operator<<(ostream& os, const Instance& instance);
+
+private:
+    Ray4 to_group(const Ray4& ray) const;
+
+    int group_index;
+    BVH* bvh;
+    Matrix4 M;     // group to scene
+    Matrix4 M_inv; // scene to group
+};
+
+#endif
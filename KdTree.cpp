@@ -0,0 +1,313 @@
+#include "KdTree.h"
+
+#include <cmath>
+#include <float.h>
+
+// Relative costs used by the surface area heuristic (as the BVH's)
+static const float TRAVERSAL_COST = 1.0f;
+static const float INTERSECT_COST = 2.0f;
+
+// A split that leaves one side empty is made that much cheaper
+static const float EMPTY_BONUS = 0.2f;
+
+// Splits are tried at the boundaries of this many bins per axis
+static const int BINS = 32;
+
+// The tree is never deeper than this (the traversal's stack)
+static const int MAX_DEPTH = 48;
+
+KdTree::KdTree() {
+    n_parts = 0;
+    max_depth = 0;
+}
+
+void KdTree::build(const vector<Object*>& objects, int /*n_threads*/) {
+    box = AABB();
+    nodes.clear();
+    leaves.clear();
+    leaf_objects.clear();
+    n_parts = 0;
+    max_depth = 0;
+
+    vector<Part> parts = split_meshes(objects);
+    if (parts.empty())
+        return;
+    n_parts = (int)parts.size();
+
+    vector<int> all(n_parts);
+    for (int i = 0; i < n_parts; i++) {
+        all[i] = i;
+        box.expand(parts[i].box);
+    }
+
+    // The usual rule of thumb for how deep a k-d tree should go
+    int depth_limit = min((int)(8 + 1.3f * log2f((float)n_parts)), MAX_DEPTH);
+    build_node(parts, all, box, 0, depth_limit);
+}
+
+//
+// Build the subtree over parts "in", which overlap node_box,
+// and return its node index.  Frees "in" once it is split.
+//
+int KdTree::build_node(const vector<Part>& parts, vector<int>& in,
+                       const AABB& node_box, int depth, int depth_limit) {
+    int node = (int)nodes.size();
+    nodes.push_back(Node());
+    if (depth > max_depth)
+        max_depth = depth;
+
+    int n = (int)in.size();
+    float area = node_box.surfaceArea();
+    if (n <= 1 || depth >= depth_limit || area <= 0)
+        return make_leaf(parts, in, node);
+
+    // The sphere and triangle kernels test a whole vector of
+    // them at about the cost of one, so count them as a part
+    // of a test each.
+    float part_cost = INTERSECT_COST / simd_width();
+
+    // Count where each part's box, clipped to the node's,
+    // starts and ends, in bins along each axis.  A plane
+    // between bins has on its left the parts that start
+    // before it, and on its right those that end after it.
+    float best_cost = part_cost * n;
+    int best_axis = -1;
+    float best_split = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = node_box.lo[axis];
+        float hi = node_box.hi[axis];
+        if (hi <= lo)
+            continue;
+        float width = (hi - lo) / BINS;
+        float scale = BINS / (hi - lo);
+
+        int starts[BINS] = {0};
+        int ends[BINS] = {0};
+        for (int i : in) {
+            float a = max(parts[i].box.lo[axis], lo);
+            float b = min(parts[i].box.hi[axis], hi);
+            starts[min(max((int)((a - lo) * scale), 0), BINS - 1)]++;
+            ends[min(max((int)((b - lo) * scale), 0), BINS - 1)]++;
+        }
+
+        int left = 0;
+        int right = n;
+        for (int k = 1; k < BINS; k++) {
+            left += starts[k - 1];
+            right -= ends[k - 1];
+            float split = lo + k * width;
+            AABB left_box = node_box;
+            AABB right_box = node_box;
+            left_box.hi[axis] = split;
+            right_box.lo[axis] = split;
+
+            float bonus = (left == 0 || right == 0) ? 1 - EMPTY_BONUS : 1;
+            float cost = TRAVERSAL_COST + part_cost * bonus *
+                (left_box.surfaceArea() * left + right_box.surfaceArea() * right) / area;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+    if (best_axis < 0)
+        return make_leaf(parts, in, node);
+
+    // A part lying in the plane goes left.
+    vector<int> left, right;
+    for (int i : in) {
+        const AABB& part_box = parts[i].box;
+        if (part_box.lo[best_axis] < best_split || part_box.hi[best_axis] <= best_split)
+            left.push_back(i);
+        if (part_box.hi[best_axis] > best_split)
+            right.push_back(i);
+    }
+    vector<int>().swap(in);
+
+    AABB left_box = node_box;
+    AABB right_box = node_box;
+    left_box.hi[best_axis] = best_split;
+    right_box.lo[best_axis] = best_split;
+
+    nodes[node].split = best_split;
+    nodes[node].axis = best_axis;
+    build_node(parts, left, left_box, depth + 1, depth_limit);
+    int right_node = build_node(parts, right, right_box, depth + 1, depth_limit);
+    nodes[node].child = right_node;
+    return node;
+}
+
+int KdTree::make_leaf(const vector<Part>& parts, const vector<int>& in, int node) {
+    Leaf leaf = leaf_objects.begin();
+    for (int i : in)
+        leaf_objects.add(leaf, parts[i].obj, parts[i].part);
+
+    nodes[node].split = 0;
+    nodes[node].axis = 3;
+    nodes[node].child = (int)leaves.size();
+    leaves.push_back(leaf);
+    return node;
+}
+
+bool KdTree::first_hit(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) {
+    if (nodes.empty())
+        return false;
+
+    Vector4 inv_dir(1.0f / ray.direction.X(),
+                    1.0f / ray.direction.Y(),
+                    1.0f / ray.direction.Z());
+    float t0, t1;
+    if (!box.clip(ray.start, inv_dir, t_max, t0, t1))
+        return false;
+
+    SphereRay sphere_ray(ray);
+    TriangleRay triangle_ray(ray);
+    LeafHit best(t_max);
+
+    // The far sides still to visit, nearest on top
+    struct Entry {
+        int node;
+        float t0, t1;
+    };
+    Entry stack[MAX_DEPTH + 1];
+    int sp = 0;
+
+    int index = 0;
+    while (true) {
+        // Go down to the leaf the ray reaches first, over [t0, t1].
+        while (nodes[index].axis < 3) {
+            const Node& node = nodes[index];
+            int axis = node.axis;
+            float start = ray.start[axis];
+            float d = ray.direction[axis];
+            bool below = start < node.split || (start == node.split && d <= 0);
+            int near = below ? index + 1 : node.child;
+            int far = below ? node.child : index + 1;
+
+            // A ray lying in the plane may touch parts on both sides.
+            if (d == 0) {
+                if (start == node.split) {
+                    stack[sp].node = far;
+                    stack[sp].t0 = t0;
+                    stack[sp].t1 = t1;
+                    sp++;
+                }
+                index = near;
+                continue;
+            }
+
+            float t_split = (node.split - start) * inv_dir[axis];
+            if (t_split > t1 || t_split <= 0) {
+                index = near;
+            }
+            else if (t_split < t0) {
+                index = far;
+            }
+            else {
+                stack[sp].node = far;
+                stack[sp].t0 = t_split;
+                stack[sp].t1 = t1;
+                sp++;
+                index = near;
+                t1 = t_split;
+            }
+        }
+
+        leaf_objects.nearest(leaves[nodes[index].child], ray, sphere_ray, triangle_ray, best, hit, ctx);
+
+        // The leaves after this one are all farther away.
+        if (best.t <= t1 || sp == 0)
+            break;
+        sp--;
+        index = stack[sp].node;
+        t0 = stack[sp].t0;
+        t1 = stack[sp].t1;
+    }
+
+    leaf_objects.setHit(best, ray, hit);
+    return best.found;
+}
+
+bool KdTree::occluded(Ray4& ray, float t_max, TraceContext& ctx) {
+    if (nodes.empty())
+        return false;
+
+    Vector4 inv_dir(1.0f / ray.direction.X(),
+                    1.0f / ray.direction.Y(),
+                    1.0f / ray.direction.Z());
+    float t0, t1;
+    if (!box.clip(ray.start, inv_dir, t_max, t0, t1))
+        return false;
+
+    SphereRay sphere_ray(ray);
+    TriangleRay triangle_ray(ray);
+
+    struct Entry {
+        int node;
+        float t0, t1;
+    };
+    Entry stack[MAX_DEPTH + 1];
+    int sp = 0;
+
+    int index = 0;
+    while (true) {
+        while (nodes[index].axis < 3) {
+            const Node& node = nodes[index];
+            int axis = node.axis;
+            float start = ray.start[axis];
+            float d = ray.direction[axis];
+            bool below = start < node.split || (start == node.split && d <= 0);
+            int near = below ? index + 1 : node.child;
+            int far = below ? node.child : index + 1;
+
+            if (d == 0) {
+                if (start == node.split) {
+                    stack[sp].node = far;
+                    stack[sp].t0 = t0;
+                    stack[sp].t1 = t1;
+                    sp++;
+                }
+                index = near;
+                continue;
+            }
+
+            float t_split = (node.split - start) * inv_dir[axis];
+            if (t_split > t1 || t_split <= 0) {
+                index = near;
+            }
+            else if (t_split < t0) {
+                index = far;
+            }
+            else {
+                stack[sp].node = far;
+                stack[sp].t0 = t_split;
+                stack[sp].t1 = t1;
+                sp++;
+                index = near;
+                t1 = t_split;
+            }
+        }
+
+        if (leaf_objects.any(leaves[nodes[index].child], ray, sphere_ray, triangle_ray, t_max, ctx))
+            return true;
+        if (sp == 0)
+            return false;
+        sp--;
+        index = stack[sp].node;
+        t0 = stack[sp].t0;
+        t1 = stack[sp].t1;
+    }
+}
+
+size_t KdTree::bytes() const {
+    return nodes.capacity() * sizeof(Node) + leaves.capacity() * sizeof(Leaf)
+         + leaf_objects.bytes();
+}
+
+void KdTree::describe(ostream& os) const {
+    os << "k-d tree " << n_parts << " objects listed as " << leaf_objects.spheres()
+       << " spheres + " << leaf_objects.triangles() << " triangles (" << simd_name()
+       << " kernels) + " << leaf_objects.instances() << " instances, " << nodes.size()
+       << " nodes, " << leaves.size() << " leaves, depth " << max_depth;
+}
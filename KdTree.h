@@ -0,0 +1,60 @@
+#if !defined(_KDTREE_H_)
+
+#define _KDTREE_H_
+
+#include <vector>
+
+#include "Accelerator.h"
+#include "LeafObjects.h"
+
+//////////////////////////////////////////////////////////
+//
+// k-d tree over the scene's objects.
+//
+// Each node cuts its box in two with a plane across one
+// axis, placed where the surface area heuristic predicts
+// the cheapest traversal (of 32 evenly spaced places per
+// axis, weighing each object's box clipped to the node's).
+// An object that straddles the plane goes on both sides.
+// Unlike a BVH's, the children don't overlap, so a ray
+// visits leaves front to back, and stops at the first one
+// holding a hit.
+//
+//////////////////////////////////////////////////////////
+
+class KdTree final : public Accelerator {
+public:
+    KdTree();
+
+    // Built on one thread, whatever n_threads says
+    void build(const vector<Object*>& objects, int n_threads = 0) override;
+
+    using Accelerator::first_hit;
+    bool first_hit(Ray4& ray, float t_max, Hit& hit, TraceContext& ctx) override;
+    bool occluded(Ray4& ray, float t_max, TraceContext& ctx) override;
+
+    AABB bounds() const override {return box;};
+    size_t bytes() const override;
+    string name() const override {return "kdtree";};
+    void describe(ostream& os) const override;
+
+private:
+    struct Node {
+        float split;  // interior: where the plane crosses the axis
+        int axis;     // 0, 1, 2 = X, Y, Z.  leaf: 3
+        int child;    // interior: the right child (the left is the next node).  leaf: index in leaves
+    };
+
+    int build_node(const vector<Part>& parts, vector<int>& in,
+                   const AABB& node_box, int depth, int depth_limit);
+    int make_leaf(const vector<Part>& parts, const vector<int>& in, int node);
+
+    AABB box;
+    vector<Node> nodes;
+    vector<Leaf> leaves;
+    LeafObjects leaf_objects;
+    int n_parts;
+    int max_depth;
+};
+
+#endif
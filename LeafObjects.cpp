@@ -0,0 +1,113 @@
+#include "LeafObjects.h"
+
+void LeafObjects::clear() {
+    sphere_set.clear();
+    triangle_set.clear();
+    instance_list.clear();
+}
+
+void LeafObjects::reserve(int n_spheres, int n_triangles, int n_instances) {
+    sphere_set.reserve(n_spheres);
+    triangle_set.reserve(n_triangles);
+    instance_list.reserve(n_instances);
+}
+
+Leaf LeafObjects::begin() const {
+    Leaf leaf;
+    leaf.first_sphere = sphere_set.size();
+    leaf.n_spheres = 0;
+    leaf.first_triangle = triangle_set.size();
+    leaf.n_triangles = 0;
+    leaf.first_instance = (int)instance_list.size();
+    leaf.n_instances = 0;
+    return leaf;
+}
+
+void LeafObjects::add(Leaf& leaf, Object* obj, int part) {
+    switch (obj->type) {
+    case SPHERE:
+        sphere_set.add(static_cast<Sphere*>(obj));
+        leaf.n_spheres++;
+        break;
+    case TRIANGLE:
+        triangle_set.add(static_cast<Triangle*>(obj));
+        leaf.n_triangles++;
+        break;
+    case MESH:
+        triangle_set.add(static_cast<Mesh*>(obj), part);
+        leaf.n_triangles++;
+        break;
+    default:
+        instance_list.push_back(static_cast<Instance*>(obj));
+        leaf.n_instances++;
+        break;
+    }
+}
+
+void LeafObjects::owners(const Leaf& leaf, vector<Object*>& objects) const {
+    for (int i = leaf.first_sphere; i < leaf.first_sphere + leaf.n_spheres; i++)
+        objects.push_back(sphere_set.object(i));
+    for (int i = leaf.first_triangle; i < leaf.first_triangle + leaf.n_triangles; i++)
+        objects.push_back(triangle_set.object(i));
+    for (int i = leaf.first_instance; i < leaf.first_instance + leaf.n_instances; i++)
+        objects.push_back(instance_list[i]);
+}
+
+AABB LeafObjects::refit(const Leaf& leaf) {
+    AABB box;
+    for (int i = leaf.first_sphere; i < leaf.first_sphere + leaf.n_spheres; i++) {
+        sphere_set.update(i);
+        box.expand(sphere_set.object(i)->bounds());
+    }
+    for (int i = leaf.first_triangle; i < leaf.first_triangle + leaf.n_triangles; i++) {
+        triangle_set.update(i);
+        box.expand(triangle_set.bounds(i));
+    }
+    for (int i = leaf.first_instance; i < leaf.first_instance + leaf.n_instances; i++)
+        box.expand(instance_list[i]->bounds());
+    return box;
+}
+
+void LeafObjects::nearest(const Leaf& leaf, RayPacket& packet, uint64_t rays, TraceContext& ctx) const {
+    int n_rays = __builtin_popcountll(rays);
+    if (leaf.n_spheres > 0) {
+        ctx.stats.intersection_tests += (long)leaf.n_spheres * n_rays;
+        COUNT_STAT(ctx.stats.sphere_tests += (long)leaf.n_spheres * n_rays);
+        sphere_set.nearest(packet, leaf.first_sphere, leaf.n_spheres, rays);
+    }
+    if (leaf.n_triangles > 0) {
+        ctx.stats.intersection_tests += (long)leaf.n_triangles * n_rays;
+        COUNT_STAT(ctx.stats.triangle_tests += (long)leaf.n_triangles * n_rays);
+        triangle_set.nearest(packet, leaf.first_triangle, leaf.n_triangles, rays);
+    }
+    for (int i = leaf.first_instance; i < leaf.first_instance + leaf.n_instances; i++) {
+        ctx.stats.intersection_tests += n_rays;
+        COUNT_STAT(ctx.stats.instance_tests += n_rays);
+        for (uint64_t m = rays; m; m &= m - 1) {
+            int j = __builtin_ctzll(m);
+            if (instance_list[i]->intersects(packet.rays[j], packet.t[j], packet.hits[j], ctx)) {
+                packet.t[j] = (float)packet.hits[j].getDistance();
+                packet.sphere[j] = -1;
+                packet.triangle[j] = -1;
+                packet.found[j] = true;
+            }
+        }
+    }
+}
+
+void LeafObjects::setHits(RayPacket& packet) const {
+    for (int j = 0; j < packet.count; j++) {
+        if (packet.sphere[j] >= 0) {
+            sphere_set.object(packet.sphere[j])->setHit(packet.rays[j], packet.t[j], packet.hits[j]);
+            packet.found[j] = true;
+        }
+        else if (packet.triangle[j] >= 0) {
+            triangle_set.setHit(packet.triangle[j], packet.rays[j], packet.t[j], packet.hits[j]);
+            packet.found[j] = true;
+        }
+    }
+}
+
+size_t LeafObjects::bytes() const {
+    return sphere_set.bytes() + triangle_set.bytes() + instance_list.capacity() * sizeof(Instance*);
+}
@@ -0,0 +1,164 @@
+#if !defined(_LEAFOBJECTS_H_)
+
+#define _LEAFOBJECTS_H_
+
+#include <vector>
+
+#include "Object.h"
+#include "Hit.h"
+#include "TraceContext.h"
+#include "SphereSet.h"
+#include "TriangleSet.h"
+#include "RayPacket.h"
+#include "Instance.h"
+
+//////////////////////////////////////////////////////////
+//
+// The objects in an accelerator's leaves (BVH leaves, grid
+// cells, k-d tree leaves), kept apart by type: spheres and
+// triangles live in a SphereSet and a TriangleSet, in leaf
+// order, and are tested several at a time by their SIMD
+// kernels; a mesh's triangles go in one by one.  Instances
+// get an array of their own.  So tracing makes no virtual
+// calls.
+//
+// A leaf is a range of each array.  An object that is in
+// several leaves is stored once for each.
+//
+//////////////////////////////////////////////////////////
+
+// Where a leaf's objects are
+struct Leaf {
+    int first_sphere;    // spheres[first_sphere ..]
+    int n_spheres;
+    int first_triangle;  // triangles[first_triangle ..]
+    int n_triangles;
+    int first_instance;  // instances[first_instance ..]
+    int n_instances;
+};
+
+// The nearest hit so far, as a ray visits leaves
+struct LeafHit {
+    float t;       // t_max, until something is hit
+    int sphere;    // the sphere hit, or -1
+    int triangle;  // the triangle hit, or -1
+    bool found;    // (an instance fills in the Hit itself)
+
+    LeafHit(float t_max) : t(t_max), sphere(-1), triangle(-1), found(false) {};
+};
+
+class LeafObjects {
+public:
+    void clear();
+    void reserve(int n_spheres, int n_triangles, int n_instances);
+
+    // A new, empty leaf, after all the others
+    Leaf begin() const;
+
+    // Add an object (or triangle "part" of a mesh) to the last leaf
+    void add(Leaf& leaf, Object* obj, int part);
+
+    // Append the object of each of the leaf's entries (a mesh
+    // once for each of its triangles there)
+    void owners(const Leaf& leaf, vector<Object*>& objects) const;
+
+    // Copy the leaf's spheres and triangles again, after some
+    // of them moved, and return the box around its objects
+    AABB refit(const Leaf& leaf);
+
+    // Test the leaf's objects for a hit nearer than best.t
+    void nearest(const Leaf& leaf, Ray4& ray, const SphereRay& sphere_ray,
+                 const TriangleRay& triangle_ray, LeafHit& best, Hit& hit, TraceContext& ctx) const;
+
+    // Is any of the leaf's objects hit at EPSILON < t < t_max?
+    bool any(const Leaf& leaf, Ray4& ray, const SphereRay& sphere_ray,
+             const TriangleRay& triangle_ray, float t_max, TraceContext& ctx) const;
+
+    // The same as nearest(), for each ray of the packet in "rays"
+    void nearest(const Leaf& leaf, RayPacket& packet, uint64_t rays, TraceContext& ctx) const;
+
+    // Fill in the hit record, once the nearest hit is known
+    void setHit(const LeafHit& best, Ray4& ray, Hit& hit) const;
+    void setHits(RayPacket& packet) const;
+
+    int spheres() const {return sphere_set.size();};
+    int triangles() const {return triangle_set.size();};
+    int instances() const {return (int)instance_list.size();};
+
+    // Memory held, in bytes
+    size_t bytes() const;
+
+private:
+    SphereSet sphere_set;
+    TriangleSet triangle_set;
+    vector<Instance*> instance_list;
+};
+
+// Inline: these run at every leaf a ray visits
+
+inline void LeafObjects::nearest(const Leaf& leaf, Ray4& ray, const SphereRay& sphere_ray,
+                                 const TriangleRay& triangle_ray, LeafHit& best, Hit& hit,
+                                 TraceContext& ctx) const {
+    if (leaf.n_spheres > 0) {
+        ctx.stats.intersection_tests += leaf.n_spheres;
+        COUNT_STAT(ctx.stats.sphere_tests += leaf.n_spheres);
+        int i = sphere_set.nearest(sphere_ray, leaf.first_sphere, leaf.n_spheres, best.t);
+        if (i >= 0) {
+            best.sphere = i;
+            best.triangle = -1;
+            best.found = true;
+        }
+    }
+    if (leaf.n_triangles > 0) {
+        ctx.stats.intersection_tests += leaf.n_triangles;
+        COUNT_STAT(ctx.stats.triangle_tests += leaf.n_triangles);
+        int i = triangle_set.nearest(triangle_ray, leaf.first_triangle, leaf.n_triangles, best.t);
+        if (i >= 0) {
+            best.triangle = i;
+            best.sphere = -1;
+            best.found = true;
+        }
+    }
+    for (int i = leaf.first_instance; i < leaf.first_instance + leaf.n_instances; i++) {
+        ctx.stats.intersection_tests++;
+        COUNT_STAT(ctx.stats.instance_tests++);
+        if (instance_list[i]->intersects(ray, best.t, hit, ctx)) {
+            best.t = (float)hit.getDistance();
+            best.sphere = -1;
+            best.triangle = -1;
+            best.found = true;
+        }
+    }
+}
+
+inline bool LeafObjects::any(const Leaf& leaf, Ray4& ray, const SphereRay& sphere_ray,
+                             const TriangleRay& triangle_ray, float t_max, TraceContext& ctx) const {
+    if (leaf.n_spheres > 0) {
+        ctx.stats.intersection_tests += leaf.n_spheres;
+        COUNT_STAT(ctx.stats.sphere_tests += leaf.n_spheres);
+        if (sphere_set.any(sphere_ray, leaf.first_sphere, leaf.n_spheres, t_max))
+            return true;
+    }
+    if (leaf.n_triangles > 0) {
+        ctx.stats.intersection_tests += leaf.n_triangles;
+        COUNT_STAT(ctx.stats.triangle_tests += leaf.n_triangles);
+        if (triangle_set.any(triangle_ray, leaf.first_triangle, leaf.n_triangles, t_max))
+            return true;
+    }
+    for (int i = leaf.first_instance; i < leaf.first_instance + leaf.n_instances; i++) {
+        ctx.stats.intersection_tests++;
+        COUNT_STAT(ctx.stats.instance_tests++);
+        if (instance_list[i]->occludes(ray, t_max, ctx))
+            return true;
+    }
+    return false;
+}
+
+inline void LeafObjects::setHit(const LeafHit& best, Ray4& ray, Hit& hit) const {
+    if (best.sphere >= 0)
+        sphere_set.object(best.sphere)->setHit(ray, best.t, hit);
+    else if (best.triangle >= 0)
+        triangle_set.setHit(best.triangle, ray, best.t, hit);
+}
+
+#endif
@@ -1,7 +1,7 @@
 #if !defined(_LIGHT_H_)
 #define _LIGHT_H_
 
-#include <string>
+#include <string_view>
 
 #include "GeomLib.h"
 #include "Color.h"
@@ -14,7 +14,7 @@ public:
     Color& getColor() {return c;};
     Point4& getPos() {return p;};
 
-    string name;
+    string_view name; // in scene_names, or a literal
     Point4 p;
     Color c;
 
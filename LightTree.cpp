@@ -0,0 +1,134 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+LightTree::LightTree() {
+}
+
+void LightTree::build(const vector<Light>& lights) {
+    nodes.clear();
+    x.clear(); y.clear(); z.clear();
+    r.clear(); g.clear(); b.clear();
+
+    if (lights.empty())
+        return;
+
+    vector<int> order(lights.size());
+    for (int i = 0; i < (int)lights.size(); i++)
+        order[i] = i;
+
+    nodes.reserve(2 * lights.size());
+    build_node(order, lights, 0, (int)lights.size());
+}
+
+//
+// Split at the median along the longest side of the box,
+// until MAX_LEAF_SIZE lights are left.
+//
+int LightTree::build_node(vector<int>& order, const vector<Light>& lights,
+                          int begin, int end) {
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+
+    Node node;
+    for (int k = 0; k < 3; k++) {
+        node.lo[k] = lights[order[begin]].p[k];
+        node.hi[k] = node.lo[k];
+    }
+    node.power = 0;
+    for (int i = begin; i < end; i++) {
+        const Light& light = lights[order[i]];
+        for (int k = 0; k < 3; k++) {
+            node.lo[k] = min(node.lo[k], light.p[k]);
+            node.hi[k] = max(node.hi[k], light.p[k]);
+        }
+        node.power += max(light.c[0], max(light.c[1], light.c[2]));
+    }
+
+    if (end - begin <= MAX_LEAF_SIZE) {
+        node.right = -1;
+        node.first = (int)x.size();
+        node.count = end - begin;
+        for (int i = begin; i < end; i++) {
+            const Light& light = lights[order[i]];
+            x.push_back(light.p[0]);
+            y.push_back(light.p[1]);
+            z.push_back(light.p[2]);
+            r.push_back(light.c[0]);
+            g.push_back(light.c[1]);
+            b.push_back(light.c[2]);
+        }
+        nodes[index] = node;
+        return index;
+    }
+
+    int axis = 0;
+    for (int k = 1; k < 3; k++) {
+        if (node.hi[k] - node.lo[k] > node.hi[axis] - node.lo[axis])
+            axis = k;
+    }
+    int mid = (begin + end) / 2;
+    nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                [&lights, axis](int a, int b) {
+                    return lights[a].p[axis] < lights[b].p[axis];
+                });
+
+    build_node(order, lights, begin, mid);
+    node.right = build_node(order, lights, mid, end);
+    node.first = node.count = 0;
+    nodes[index] = node;
+    return index;
+}
+
+void LightTree::find(const Point4& p, const Vector4& N, float k_max, float cutoff,
+                     vector<int>& result) const {
+    if (nodes.empty())
+        return;
+
+    const float px = p[0], py = p[1], pz = p[2];
+    const float nx = N[0], ny = N[1], nz = N[2];
+
+    // A balanced tree over 2^31 lights is only 30 deep.
+    int stack[64];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        const Node& node = nodes[stack[--sp]];
+
+        // The corner of the box farthest in front of the plane:
+        // if even that is behind it, so is every light inside.
+        float front = nx * ((nx > 0 ? node.hi[0] : node.lo[0]) - px)
+                    + ny * ((ny > 0 ? node.hi[1] : node.lo[1]) - py)
+                    + nz * ((nz > 0 ? node.hi[2] : node.lo[2]) - pz);
+        if (front < -EPSILON)
+            continue;
+
+        // No light in the box is closer than d, so none shines
+        // on the point at a cosine above front / d.
+        if (cutoff > 0) {
+            float dx = max(max(node.lo[0] - px, px - node.hi[0]), 0.0f);
+            float dy = max(max(node.lo[1] - py, py - node.hi[1]), 0.0f);
+            float dz = max(max(node.lo[2] - pz, pz - node.hi[2]), 0.0f);
+            float d = sqrt(dx * dx + dy * dy + dz * dz);
+            float cos_max = (d > front) ? max(front, 0.0f) / d : 1.0f;
+            if (node.power * k_max * cos_max < cutoff)
+                continue;
+        }
+
+        if (node.right < 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                result.push_back(i);
+        }
+        else {
+            stack[sp++] = node.right;
+            stack[sp++] = (int)(&node - &nodes[0]) + 1;
+        }
+    }
+}
+
+size_t LightTree::bytes() const {
+    return nodes.capacity() * sizeof(Node)
+         + (x.capacity() + y.capacity() + z.capacity() + r.capacity() + g.capacity() + b.capacity()) * sizeof(float);
+}
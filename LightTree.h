@@ -0,0 +1,73 @@
+#if !defined(_LIGHTTREE_H_)
+
+#define _LIGHTTREE_H_
+
+#include <vector>
+
+#include "GeomLib.h"
+#include "Color.h"
+#include "Light.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// The scene's point lights, packed as a structure of
+// arrays, with a bounding volume hierarchy over their
+// positions.
+//
+// A light lights a surface point only if it is in front of
+// the point's tangent plane, so find() skips every subtree
+// whose box lies behind it.  Lights don't fall off with
+// distance here, so that is the only exact cull.  With a
+// cutoff, find() also drops subtrees whose lights could add
+// less than that much, altogether, to the color: bounded by
+// their summed power times the largest cosine they could
+// make with the normal.
+//
+//////////////////////////////////////////////////////////
+
+class LightTree {
+public:
+    LightTree();
+
+    // (Re)build over these lights.
+    void build(const vector<Light>& lights);
+
+    //
+    // Append to "result" the lights that may light the point
+    // p with normal N, for a material whose diffuse plus
+    // specular is at most k_max (in any channel).
+    //
+    void find(const Point4& p, const Vector4& N, float k_max, float cutoff,
+              vector<int>& result) const;
+
+    int size() const {return (int)x.size();};
+    Point4 position(int i) const {return Point4(x[i], y[i], z[i]);};
+    Color color(int i) const {return Color(r[i], g[i], b[i]);};
+
+    // Memory held, in bytes
+    size_t bytes() const;
+
+    // Leaves hold at most this many lights
+    static const int MAX_LEAF_SIZE = 4;
+
+private:
+    struct Node {
+        float lo[3], hi[3]; // bounds of the light positions
+        float power;        // sum of the lights' largest color component
+        int right;          // interior: right child (the left is next).  leaf: -1
+        int first, count;   // leaf: lights first .. first+count-1
+    };
+
+    int build_node(vector<int>& order, const vector<Light>& lights,
+                   int begin, int end);
+
+    vector<Node> nodes;
+
+    // The lights, in leaf order
+    vector<float> x, y, z;
+    vector<float> r, g, b;
+};
+
+#endif
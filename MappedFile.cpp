@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+    bytes = NULL;
+    length = 0;
+#if defined(_WIN32)
+    file = NULL;
+    mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const string& filename) {
+    close();
+    HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (f == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(f, &file_size)) {
+        CloseHandle(f);
+        return false;
+    }
+    file = f;
+    length = (size_t)file_size.QuadPart;
+    if (length == 0)
+        return true; // can't map an empty file, but it's not an error
+
+    mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL)
+        bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (bytes == NULL) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes != NULL)
+        UnmapViewOfFile(bytes);
+    if (mapping != NULL)
+        CloseHandle(mapping);
+    if (file != NULL)
+        CloseHandle(file);
+    bytes = NULL;
+    length = 0;
+    file = NULL;
+    mapping = NULL;
+}
+
+#else
+
+bool MappedFile::open(const string& filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    length = (size_t)info.st_size;
+    if (length == 0) {
+        ::close(fd);
+        return true; // can't map an empty file, but it's not an error
+    }
+
+    // The mapping keeps the file open; the descriptor isn't needed.
+    void* p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        length = 0;
+        return false;
+    }
+    bytes = (const char*)p;
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes != NULL)
+        munmap((void*)bytes, length);
+    bytes = NULL;
+    length = 0;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#if !defined(_MAPPEDFILE_H_)
+
+#define _MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// A whole file, mapped read-only into memory (mmap, or
+// MapViewOfFile on Windows).  Nothing is read up front:
+// pages come in from the OS cache as they are touched.
+//
+//////////////////////////////////////////////////////////
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file; false (and nothing mapped) if it can't be
+    bool open(const string& filename);
+    void close();
+
+    const char* data() const {return bytes;};
+    size_t size() const {return length;};
+
+private:
+    const char* bytes;
+    size_t length;
+#if defined(_WIN32)
+    void* file;
+    void* mapping;
+#endif
+};
+
+#endif
@@ -2,7 +2,7 @@
 
 #define _MATERIAL_H_
 
-#include <string>
+#include <string_view>
 #include "Color.h"
 
 enum SurfaceType {NO_SURFACE, PHONG, SPECULAR};
@@ -15,19 +15,19 @@ public:
     Material(float refraction_index, Color& transmission, Color& reflection, Color& color);
     void set(Color& ambient, Color& diffuse, Color& specular, int shininess);
 
-    inline Color& getAmbient() { return ka; };
-    inline Color& getDiffuse() { return kd; };
-    inline Color& getSpecular() { return ks; };
-    inline Color& getTransmission() { return tau; };
-    inline Color& getReflection() { return rho; };
-    inline int getShininess() { return n; };
-    inline SurfaceType getType() { return surface_type; };
+    inline const Color& getAmbient() const { return ka; };
+    inline const Color& getDiffuse() const { return kd; };
+    inline const Color& getSpecular() const { return ks; };
+    inline const Color& getTransmission() const { return tau; };
+    inline const Color& getReflection() const { return rho; };
+    inline int getShininess() const { return n; };
+    inline SurfaceType getType() const { return surface_type; };
 
     friend ostream& operator<<(ostream& os, const Material& mat);
 
 //private:
 
-    string name;
+    string_view name; // in scene_names, or a literal
 
     SurfaceType surface_type;
     // For Phong glossy materials
@@ -0,0 +1,31 @@
+#include "MaterialTable.h"
+
+MaterialTable::MaterialTable() {
+    clear();
+}
+
+void MaterialTable::clear() {
+    materials.clear();
+    by_name.clear();
+
+    Material default_material;
+    default_material.name = "default";
+    materials.push_back(default_material);
+}
+
+int MaterialTable::add(const Material& material) {
+    int index = (int)materials.size();
+    materials.push_back(material);
+    by_name[material.name] = index;
+    return index;
+}
+
+size_t MaterialTable::bytes() const {
+    const size_t node = sizeof(pair<const string_view, int>) + 4 * sizeof(void*);
+    return materials.capacity() * sizeof(Material) + by_name.size() * node;
+}
+
+int MaterialTable::find(string_view name) const {
+    auto it = by_name.find(name);
+    return it != by_name.end() ? it->second : 0;
+}
@@ -0,0 +1,51 @@
+#if !defined(_MATERIALTABLE_H_)
+
+#define _MATERIALTABLE_H_
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Material.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// All of the scene's materials, in one array.  Objects
+// refer to theirs by index, so they don't each carry a
+// copy (name and all), and shading reads it in place.
+//
+// Entry 0 is the default Material, given to objects whose
+// material name is unknown.  Entries never change once
+// added: redefining a name adds a new entry, and only
+// objects read after that use it.
+//
+//////////////////////////////////////////////////////////
+
+class MaterialTable {
+public:
+    MaterialTable();
+
+    // Empty the table (except for the default, entry 0)
+    void clear();
+
+    // Add a material, and return its index
+    int add(const Material& material);
+
+    // Index of the latest material with this name, or 0 (the default)
+    int find(string_view name) const;
+
+    const Material& operator[](int index) const {return materials[index];};
+    int size() const {return (int)materials.size();};
+
+    // Memory held, in bytes (the name index's roughly)
+    size_t bytes() const;
+
+private:
+    vector<Material> materials;
+    map<string_view, int> by_name; // the names are the materials'
+};
+
+#endif
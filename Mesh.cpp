@@ -0,0 +1,114 @@
+#include "Mesh.h"
+
+#include <float.h>
+#include <iostream>
+using namespace std;
+
+Mesh::Mesh(int material_id) : Object(MESH, material_id) {
+    name = "unnamed";
+}
+
+bool Mesh::intersects(Ray4& ray, float t_max, Hit& hit) {
+    int nearest = -1;
+    for (int i = 0; i < triangles(); i++) {
+        float t = intersect_t(ray, i, t_max);
+        if (t >= 0) {
+            t_max = t;
+            nearest = i;
+        }
+    }
+    if (nearest < 0)
+        return false;
+
+    setHit(ray, t_max, nearest, hit);
+    return true;
+}
+
+bool Mesh::occludes(Ray4& ray, float t_max) {
+    for (int i = 0; i < triangles(); i++) {
+        if (intersect_t(ray, i, t_max) >= 0)
+            return true;
+    }
+    return false;
+}
+
+AABB Mesh::bounds() {
+    AABB box;
+    for (int v = 0; v < vertices(); v++)
+        box.expand(vertex(v));
+    return box;
+}
+
+AABB Mesh::bounds(int triangle) const {
+    AABB box;
+    box.expand(corner(triangle, 0));
+    box.expand(corner(triangle, 1));
+    box.expand(corner(triangle, 2));
+    return box;
+}
+
+void Mesh::setHit(Ray4& ray, float t, int triangle, Hit& hit) {
+    hit.p = ray.start + t * ray.direction;
+    hit.obj = this;
+    hit.dist = t;
+
+    Point4 v1 = corner(triangle, 0);
+    Vector4 e1 = corner(triangle, 1) - v1;
+    Vector4 e2 = corner(triangle, 2) - v1;
+    hit.N = (e1 ^ e2).normalized();
+    if (normals.empty())
+        return;
+
+    // Barycentric coordinates of the hit point
+    Vector4 p = hit.p - v1;
+    float d11 = e1 * e1, d12 = e1 * e2, d22 = e2 * e2;
+    float dp1 = p * e1, dp2 = p * e2;
+    float denom = d11 * d22 - d12 * d12;
+    if (denom == 0)
+        return;
+    float b = (d22 * dp1 - d12 * dp2) / denom;
+    float c = (d11 * dp2 - d12 * dp1) / denom;
+    float a = 1 - b - c;
+
+    const int *corners = &indices[3*triangle];
+    Vector4 N;
+    for (int k = 0; k < 3; k++) {
+        const float *n = &normals[3*corners[k]];
+        float w = (k == 0) ? a : (k == 1) ? b : c;
+        N += Vector4(n[0], n[1], n[2]) * w;
+    }
+    if (N * N > 0)
+        hit.N = N.normalized();
+}
+
+size_t Mesh::bytes() const {
+    return (positions.capacity() + normals.capacity()) * sizeof(float)
+         + indices.capacity() * sizeof(int);
+}
+
+void Mesh::transform(const Matrix4& M) {
+    for (int v = 0; v < vertices(); v++) {
+        Float4 p = M * vertex(v);
+        positions[3*v] = p.X();
+        positions[3*v+1] = p.Y();
+        positions[3*v+2] = p.Z();
+    }
+    if (normals.empty())
+        return;
+
+    // Normals go by the inverse transpose.
+    Matrix4 N = M.inverse().transpose();
+    for (int v = 0; v < vertices(); v++) {
+        Float4 n = N * Vector4(normals[3*v], normals[3*v+1], normals[3*v+2]);
+        Vector4 unit = Vector4(n.X(), n.Y(), n.Z()).normalized();
+        normals[3*v] = unit.X();
+        normals[3*v+1] = unit.Y();
+        normals[3*v+2] = unit.Z();
+    }
+}
+
+ostream& operator<<(ostream& os, const Mesh& mesh) {
+    os << "Mesh \"" << mesh.name << "\" " << mesh.vertices() << " vertices, "
+       << mesh.triangles() << " triangles" << (mesh.hasNormals() ? ", with normals" : "");
+    return os;
+}
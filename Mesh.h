@@ -0,0 +1,71 @@
+#if !defined(_MESH_H_)
+#define _MESH_H_
+
+#include <vector>
+
+#include "Object.h"
+#include "GeomLib.h"
+#include "Hit.h"
+#include "Triangle.h"
+
+//////////////////////////////////////////////////////////
+//
+// A triangle mesh: shared vertex (and, optionally, normal)
+// buffers, and three vertex indices per triangle.  It is
+// one Object, with one material, however many triangles
+// it has.
+//
+// The BVH doesn't treat a mesh as a whole: it puts each
+// of its triangles in the leaves, next to the scene's
+// Triangles, and calls setHit() with the one hit.
+//
+//////////////////////////////////////////////////////////
+
+class Mesh final : public Object {
+public:
+    Mesh(int material_id);
+
+    int vertices() const {return (int)positions.size() / 3;};
+    int triangles() const {return (int)indices.size() / 3;};
+    bool hasNormals() const {return !normals.empty();};
+
+    Point4 vertex(int v) const {
+        return Point4(positions[3*v], positions[3*v+1], positions[3*v+2]);
+    };
+    // Corner k (0, 1 or 2) of a triangle
+    Point4 corner(int triangle, int k) const {return vertex(indices[3*triangle+k]);};
+
+    // The whole mesh, one triangle at a time
+    bool intersects(Ray4& ray, float t_max, Hit& hit);
+    bool occludes(Ray4& ray, float t_max);
+    AABB bounds();
+
+    AABB bounds(int triangle) const;
+
+    // Move the vertices by M (and turn the normals to match)
+    void transform(const Matrix4& M);
+
+    // Fill in the hit record for a hit on a triangle, at t
+    // along the ray.  The normal is interpolated from the
+    // vertex normals, if there are any.
+    void setHit(Ray4& ray, float t, int triangle, Hit& hit);
+
+    // Memory held by the buffers
+    size_t bytes() const;
+
+    friend ostream& operator<<(ostream& os, const Mesh& mesh);
+
+    vector<float> positions; // x, y, z of each vertex
+    vector<float> normals;   // x, y, z of each vertex, or nothing
+    vector<int> indices;     // three vertices per triangle
+
+private:
+    // Triangle's test, on one of the mesh's: t, or -1 for a miss
+    float intersect_t(const Ray4& ray, int triangle, float t_max) const {
+        Point4 v1 = corner(triangle, 0);
+        return triangle_intersect_t(ray, v1, corner(triangle, 1) - v1,
+                                    corner(triangle, 2) - v1, t_max);
+    };
+};
+
+#endif
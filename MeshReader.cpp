@@ -0,0 +1,424 @@
+#include "MeshReader.h"
+
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Tokenizer.h"
+
+bool read_mesh(const string& filename, Mesh& mesh) {
+    string ext;
+    size_t dot = filename.rfind('.');
+    if (dot != string::npos) {
+        for (size_t i = dot; i < filename.length(); i++) {
+            ext += (char)tolower(filename[i]);
+        }
+    }
+
+    if (ext == ".obj")
+        return read_obj(filename, mesh);
+    if (ext == ".ply")
+        return read_ply(filename, mesh);
+
+    cerr << "Can't read " << filename << ": use a .obj or .ply file\n";
+    return false;
+}
+
+// Split off the next word of a line
+static string_view next_word(string_view& line) {
+    size_t start = 0;
+    while (start < line.size() && (line[start] == ' ' || line[start] == '\t' || line[start] == '\r'))
+        start++;
+    size_t stop = start;
+    while (stop < line.size() && line[stop] != ' ' && line[stop] != '\t' && line[stop] != '\r')
+        stop++;
+    string_view word = line.substr(start, stop - start);
+    line.remove_prefix(stop);
+    return word;
+}
+
+// Split off the next line of a file
+static string_view next_line(const char *&pos, const char *end) {
+    const char *start = pos;
+    const char *newline = (const char *)memchr(pos, '\n', end - pos);
+    pos = newline ? newline + 1 : end;
+    return string_view(start, (newline ? newline : end) - start);
+}
+
+//////////////////////////////////////////////////////////
+// Wavefront OBJ
+//////////////////////////////////////////////////////////
+
+// An OBJ index (1-based, or negative from the end) as 0-based
+static bool obj_index(string_view text, int count, int& index) {
+    int i;
+    from_chars_result result = from_chars(text.data(), text.data() + text.size(), i);
+    if (result.ec != errc() || result.ptr != text.data() + text.size() || i == 0)
+        return false;
+    index = (i > 0) ? i - 1 : count + i;
+    return true;
+}
+
+bool read_obj(const string& filename, Mesh& mesh) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "Can't read from " << filename << endl;
+        return false;
+    }
+
+    vector<float> positions, normals;
+    vector<int> corner_v, corner_n; // three corners per triangle
+    bool all_normals = true;        // does every corner name a normal?
+    int line_number = 0;
+
+    auto fail = [&](const string& why) {
+        cerr << filename << ":" << line_number << ": " << why << "\n";
+        return false;
+    };
+
+    const char *pos = file.data();
+    const char *end = pos + file.size();
+    vector<int> face_v, face_n;
+    while (pos < end) {
+        string_view line = next_line(pos, end);
+        line_number++;
+        string_view keyword = next_word(line);
+
+        if (keyword == "v" || keyword == "vn") {
+            vector<float>& values = (keyword == "v") ? positions : normals;
+            for (int k = 0; k < 3; k++) {
+                float x;
+                if (!parse_number(next_word(line), x))
+                    return fail("expected 3 numbers after \"" + string(keyword) + "\"");
+                values.push_back(x);
+            }
+        }
+        else if (keyword == "f") {
+            face_v.clear();
+            face_n.clear();
+            for (string_view corner = next_word(line); !corner.empty(); corner = next_word(line)) {
+                // v, v/vt, v//vn or v/vt/vn
+                size_t slash = corner.find('/');
+                int v, n = -1;
+                if (!obj_index(corner.substr(0, slash), (int)positions.size() / 3, v))
+                    return fail("bad vertex \"" + string(corner) + "\"");
+                if (slash != string_view::npos) {
+                    size_t slash2 = corner.find('/', slash + 1);
+                    if (slash2 != string_view::npos &&
+                        !obj_index(corner.substr(slash2 + 1), (int)normals.size() / 3, n))
+                        return fail("bad normal in \"" + string(corner) + "\"");
+                }
+                face_v.push_back(v);
+                face_n.push_back(n);
+                if (n < 0)
+                    all_normals = false;
+            }
+            if (face_v.size() < 3)
+                return fail("a face needs at least 3 vertices");
+            for (int i = 1; i + 1 < (int)face_v.size(); i++) {
+                int fan[3] = {0, i, i + 1};
+                for (int k : fan) {
+                    corner_v.push_back(face_v[k]);
+                    corner_n.push_back(face_n[k]);
+                }
+            }
+        }
+        // Anything else (vt, o, g, s, usemtl, comments) doesn't change the shape.
+    }
+
+    // Faces may come before the vertices they use, so check them now.
+    int n_positions = (int)positions.size() / 3;
+    int n_normals = (int)normals.size() / 3;
+    for (size_t i = 0; i < corner_v.size(); i++) {
+        if (corner_v[i] < 0 || corner_v[i] >= n_positions || corner_n[i] >= n_normals) {
+            cerr << "Can't read " << filename << ": triangle " << i / 3 + 1
+                 << " refers to a vertex or normal that doesn't exist\n";
+            return false;
+        }
+    }
+
+    if (!all_normals || n_normals == 0) {
+        mesh.positions = move(positions);
+        mesh.normals.clear();
+        mesh.indices = move(corner_v);
+        return true;
+    }
+
+    // OBJ indexes positions and normals apart; the mesh needs
+    // one index per vertex, so each distinct pair becomes one.
+    unordered_map<uint64_t, int> vertex_of;
+    mesh.positions.clear();
+    mesh.normals.clear();
+    mesh.indices.resize(corner_v.size());
+    for (size_t i = 0; i < corner_v.size(); i++) {
+        uint64_t key = ((uint64_t)corner_v[i] << 32) | (uint32_t)corner_n[i];
+        auto found = vertex_of.find(key);
+        if (found == vertex_of.end()) {
+            int vertex = (int)vertex_of.size();
+            found = vertex_of.emplace(key, vertex).first;
+            mesh.positions.insert(mesh.positions.end(), &positions[3*corner_v[i]], &positions[3*corner_v[i]] + 3);
+            mesh.normals.insert(mesh.normals.end(), &normals[3*corner_n[i]], &normals[3*corner_n[i]] + 3);
+        }
+        mesh.indices[i] = found->second;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////
+// Binary PLY
+//////////////////////////////////////////////////////////
+
+enum PlyType {PLY_NONE, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16,
+              PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64};
+
+static const int ply_size[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+
+static PlyType ply_type(string_view name) {
+    if (name == "char" || name == "int8") return PLY_INT8;
+    if (name == "uchar" || name == "uint8") return PLY_UINT8;
+    if (name == "short" || name == "int16") return PLY_INT16;
+    if (name == "ushort" || name == "uint16") return PLY_UINT16;
+    if (name == "int" || name == "int32") return PLY_INT32;
+    if (name == "uint" || name == "uint32") return PLY_UINT32;
+    if (name == "float" || name == "float32") return PLY_FLOAT32;
+    if (name == "double" || name == "float64") return PLY_FLOAT64;
+    return PLY_NONE;
+}
+
+struct PlyProperty {
+    string name;
+    PlyType type;       // of the value, or of a list's items
+    PlyType count_type; // PLY_NONE, unless it's a list
+};
+
+struct PlyElement {
+    string name;
+    long count;
+    vector<PlyProperty> properties;
+};
+
+// Reads the values of a binary PLY body, in either byte order
+class PlyReader {
+public:
+    PlyReader(const char *pos, const char *end, bool swap) : pos(pos), end(end), swap(swap) {};
+
+    // The next value, as a double; false if the file ends first
+    bool read(PlyType type, double& value) {
+        int size = ply_size[type];
+        if (end - pos < size)
+            return false;
+        unsigned char b[8];
+        memcpy(b, pos, size);
+        pos += size;
+        if (swap) {
+            for (int i = 0; i < size / 2; i++) {
+                unsigned char t = b[i];
+                b[i] = b[size - 1 - i];
+                b[size - 1 - i] = t;
+            }
+        }
+        switch (type) {
+        case PLY_INT8:    {int8_t v;   memcpy(&v, b, 1); value = v; break;}
+        case PLY_UINT8:   {uint8_t v;  memcpy(&v, b, 1); value = v; break;}
+        case PLY_INT16:   {int16_t v;  memcpy(&v, b, 2); value = v; break;}
+        case PLY_UINT16:  {uint16_t v; memcpy(&v, b, 2); value = v; break;}
+        case PLY_INT32:   {int32_t v;  memcpy(&v, b, 4); value = v; break;}
+        case PLY_UINT32:  {uint32_t v; memcpy(&v, b, 4); value = v; break;}
+        case PLY_FLOAT32: {float v;    memcpy(&v, b, 4); value = v; break;}
+        case PLY_FLOAT64: {double v;   memcpy(&v, b, 8); value = v; break;}
+        default: return false;
+        }
+        return true;
+    }
+
+    // Bytes left to read
+    long remaining() const {return end - pos;};
+
+private:
+    const char *pos, *end;
+    bool swap;
+};
+
+bool read_ply(const string& filename, Mesh& mesh) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "Can't read from " << filename << endl;
+        return false;
+    }
+
+    auto fail = [&](const string& why) {
+        cerr << "Can't read " << filename << ": " << why << "\n";
+        return false;
+    };
+
+    // The header: text lines, up to "end_header"
+    const char *pos = file.data();
+    const char *end = pos + file.size();
+    if (pos == end || next_line(pos, end) != "ply")
+        return fail("not a PLY file");
+
+    bool little_endian = true;
+    vector<PlyElement> elements;
+    for (;;) {
+        if (pos >= end)
+            return fail("no end_header");
+        string_view line = next_line(pos, end);
+        string_view keyword = next_word(line);
+
+        if (keyword == "end_header") {
+            break;
+        }
+        else if (keyword == "format") {
+            string_view format = next_word(line);
+            if (format == "binary_little_endian")
+                little_endian = true;
+            else if (format == "binary_big_endian")
+                little_endian = false;
+            else
+                return fail("only binary PLY files are supported, not " + string(format));
+        }
+        else if (keyword == "element") {
+            PlyElement element;
+            element.name = string(next_word(line));
+            string_view count = next_word(line);
+            if (from_chars(count.data(), count.data() + count.size(), element.count).ec != errc() ||
+                element.count < 0)
+                return fail("bad count for element " + element.name);
+            elements.push_back(element);
+        }
+        else if (keyword == "property") {
+            if (elements.empty())
+                return fail("a property before any element");
+            PlyProperty property;
+            string_view type = next_word(line);
+            property.count_type = PLY_NONE;
+            if (type == "list") {
+                property.count_type = ply_type(next_word(line));
+                type = next_word(line);
+                if (property.count_type == PLY_NONE || property.count_type >= PLY_FLOAT32)
+                    return fail("bad list count type");
+            }
+            property.type = ply_type(type);
+            if (property.type == PLY_NONE)
+                return fail("unknown property type " + string(type));
+            property.name = string(next_word(line));
+            elements.back().properties.push_back(property);
+        }
+        // "comment" and "obj_info" lines say nothing about the data.
+    }
+
+    uint16_t one = 1;
+    bool host_little_endian = (*(unsigned char *)&one == 1);
+    PlyReader reader(pos, end, little_endian != host_little_endian);
+
+    mesh.positions.clear();
+    mesh.normals.clear();
+    mesh.indices.clear();
+    long n_vertices = 0;
+    bool has_normals = false;
+    vector<int> face;
+
+    for (auto& element : elements) {
+        // A count the file can't hold is a lie: don't reserve
+        // space for it.  (A list holds at least its count.)
+        long record = 0;
+        for (auto& property : element.properties)
+            record += ply_size[property.count_type == PLY_NONE ? property.type : property.count_type];
+        if (record > 0 && element.count > reader.remaining() / record)
+            return fail("the header promises more of element " + element.name + " than the file holds");
+
+        // Where each property's value goes: x y z nx ny nz, or nowhere
+        bool is_vertex = (element.name == "vertex");
+        bool is_face = (element.name == "face");
+        vector<int> slot(element.properties.size(), -1);
+        if (is_vertex) {
+            const char *names[] = {"x", "y", "z", "nx", "ny", "nz"};
+            int found = 0;
+            for (size_t p = 0; p < element.properties.size(); p++) {
+                for (int k = 0; k < 6; k++) {
+                    if (element.properties[p].name == names[k] && element.properties[p].count_type == PLY_NONE) {
+                        slot[p] = k;
+                        found |= 1 << k;
+                    }
+                }
+            }
+            if ((found & 7) != 7)
+                return fail("vertices need x, y and z");
+            has_normals = ((found & 0x38) == 0x38);
+            n_vertices = element.count;
+            mesh.positions.reserve(3 * element.count);
+            if (has_normals)
+                mesh.normals.reserve(3 * element.count);
+        }
+        if (record == 0)
+            continue;
+        if (is_face) {
+            for (size_t p = 0; p < element.properties.size(); p++) {
+                const string& name = element.properties[p].name;
+                if ((name == "vertex_indices" || name == "vertex_index") &&
+                    element.properties[p].count_type != PLY_NONE)
+                    slot[p] = 0;
+            }
+            mesh.indices.reserve(3 * element.count);
+        }
+
+        for (long i = 0; i < element.count; i++) {
+            float vertex[6] = {0, 0, 0, 0, 0, 0};
+            for (size_t p = 0; p < element.properties.size(); p++) {
+                const PlyProperty& property = element.properties[p];
+                double value;
+                if (property.count_type == PLY_NONE) {
+                    if (!reader.read(property.type, value))
+                        return fail("the file ends in the middle of the " + element.name + "s");
+                    if (is_vertex && slot[p] >= 0)
+                        vertex[slot[p]] = (float)value;
+                    continue;
+                }
+
+                double count;
+                if (!reader.read(property.count_type, count))
+                    return fail("the file ends in the middle of the " + element.name + "s");
+                if (count < 0 || count > reader.remaining() / ply_size[property.type])
+                    return fail("a list in the " + element.name + "s is longer than the file");
+                face.clear();
+                for (long k = 0; k < (long)count; k++) {
+                    if (!reader.read(property.type, value))
+                        return fail("the file ends in the middle of the " + element.name + "s");
+                    if (!is_face || slot[p] < 0)
+                        continue;
+                    if (!(value >= 0 && value <= INT_MAX) || value != floor(value))
+                        return fail("a face refers to a vertex that doesn't exist");
+                    face.push_back((int)value);
+                }
+                if (is_face && slot[p] >= 0) {
+                    if (face.size() < 3)
+                        return fail("a face needs at least 3 vertices");
+                    for (int k = 1; k + 1 < (int)face.size(); k++) {
+                        mesh.indices.push_back(face[0]);
+                        mesh.indices.push_back(face[k]);
+                        mesh.indices.push_back(face[k + 1]);
+                    }
+                }
+            }
+            if (is_vertex) {
+                mesh.positions.insert(mesh.positions.end(), vertex, vertex + 3);
+                if (has_normals)
+                    mesh.normals.insert(mesh.normals.end(), vertex + 3, vertex + 6);
+            }
+        }
+    }
+
+    for (int index : mesh.indices) {
+        if (index < 0 || index >= n_vertices)
+            return fail("a face refers to a vertex that doesn't exist");
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+#if !defined(_MESHREADER_H_)
+
+#define _MESHREADER_H_
+
+#include <string>
+
+#include "Mesh.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Read a triangle mesh's vertices, normals and faces from
+// a file.  The format comes from the file name's
+// extension: ".obj" (Wavefront) or ".ply" (binary, either
+// byte order).  Polygons are split into triangle fans;
+// texture coordinates, groups and materials are ignored.
+//
+// Returns false, after printing why, if the file can't be
+// read.
+//
+//////////////////////////////////////////////////////////
+
+bool read_mesh(const string& filename, Mesh& mesh);
+
+bool read_obj(const string& filename, Mesh& mesh);
+
+bool read_ply(const string& filename, Mesh& mesh);
+
+#endif
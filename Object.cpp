@@ -1,10 +1,13 @@
 #include "Object.h"
 
-Object::Object(Material& c)
+extern MaterialTable scene_materials;
+
+Object::Object(ObjectType type, int material_id)
 {
-    material = c;
+    this->type = type;
+    this->material_id = material_id;
 }
 
-
-
-
+const Material& Object::getMaterial() const {
+    return scene_materials[material_id];
+}
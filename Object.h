@@ -2,24 +2,59 @@
 
 #define _OBJECT_H_
 
-#include <string>
+#include <string_view>
 
 #include "Material.h"
+#include "MaterialTable.h"
 #include "Hit.h"
 #include "GeomLib.h"
+#include "AABB.h"
 
-enum ObjectType {NO_OBJECT, SPHERE, TRIANGLE};
+enum ObjectType {NO_OBJECT, SPHERE, TRIANGLE, MESH, INSTANCE};
+
+//////////////////////////////////////////////////////////
+//
+// The base of every kind of object in a scene.
+//
+// The virtual queries are for code that handles any object
+// (the BVH's build, the linear-scan benchmark).  The BVH
+// itself sorts objects by "type" as it's built, and traces
+// each kind with its own loops and no virtual calls.
+//
+//////////////////////////////////////////////////////////
 
 class Object {
 public:
-    Object(Material& newColor);
-    virtual bool intersects(Ray4& ray, Hit& hit) = 0;
-    Material& getMaterial() {return material;};
+    Object(ObjectType type, int material_id);
+
+    //
+    // Closest-hit query: if the ray hits this object at some
+    // EPSILON < t < t_max, fill in "hit" and return true.
+    // Otherwise return false, and leave "hit" alone.
+    //
+    virtual bool intersects(Ray4& ray, float t_max, Hit& hit) = 0;
+
+    //
+    // Any-hit (shadow) query: does the ray hit this object at
+    // some EPSILON < t < t_max?  Computes no hit point or normal.
+    //
+    virtual bool occludes(Ray4& ray, float t_max) = 0;
+
+    virtual AABB bounds() = 0;
+    // This object's entry in scene_materials
+    const Material& getMaterial() const;
+    int getMaterialId() const {return material_id;};
 
 //#protected:
-    Material material;
-    string name;
-
+    ObjectType type; // which subclass this is
+    int material_id;
+    string_view name; // in scene_names, or a literal
+
+protected:
+    // Objects are never deleted through an Object*, so this
+    // needn't be virtual; that keeps spheres and triangles
+    // trivially destructible.
+    ~Object() = default;
 };
 
 #endif
@@ -0,0 +1,89 @@
+#include "ProgressiveRenderer.h"
+
+#include <cstring>
+
+// Block size of each pass: the last (1) is the full image.
+static const int pass_steps[] = {8, 4, 2, 1};
+static const int n_passes = sizeof(pass_steps) / sizeof(pass_steps[0]);
+
+ProgressiveRenderer::ProgressiveRenderer() : cancelled(false), fresh(false), passes_done(0) {
+}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+    cancel();
+}
+
+int ProgressiveRenderer::passes() {
+    return n_passes;
+}
+
+void ProgressiveRenderer::cancel() {
+    if (worker.joinable()) {
+        cancelled = true;
+        worker.join();
+    }
+    cancelled = false;
+}
+
+void ProgressiveRenderer::start() {
+    cancel();
+
+    // On this thread, while nothing else is tracing.
+    prepare_frame();
+
+    size_t size = (size_t)winWidth * winHeight * 3;
+    work.assign(size, 0);
+    {
+        lock_guard<mutex> guard(lock);
+        shown.assign(size, 0);
+        fresh = false;
+    }
+    passes_done = 0;
+
+    worker = thread(&ProgressiveRenderer::run, this);
+}
+
+bool ProgressiveRenderer::latest(ubyte* frame) {
+    lock_guard<mutex> guard(lock);
+    if (!fresh)
+        return false;
+
+    memcpy(frame, shown.data(), shown.size());
+    fresh = false;
+    return true;
+}
+
+void ProgressiveRenderer::run() {
+    int skip = 0;
+
+    for (int pass = 0; pass < n_passes; pass++) {
+        int step = pass_steps[pass];
+
+        // Coarse passes need tiles that start on their block grid.
+        int size = step > 1 ? (tile_size + 7) / 8 * 8 : tile_size;
+        TileScheduler scheduler(winWidth, winHeight, size, num_threads);
+        vector<TraceContext> contexts(scheduler.workers());
+        ubyte* frame = work.data();
+
+        // Once cancelled, the remaining tiles are just skipped.
+        scheduler.run([&](const Tile& tile, int w) {
+            if (cancelled)
+                return;
+            if (step > 1)
+                render_coarse_tile(tile, step, skip, contexts[w], frame);
+            else
+                render_tile(tile, contexts[w], frame); // all pixels, in packets
+        });
+
+        if (cancelled)
+            return;
+
+        {
+            lock_guard<mutex> guard(lock);
+            shown = work;
+            fresh = true;
+        }
+        passes_done++;
+        skip = step;
+    }
+}
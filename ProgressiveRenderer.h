@@ -0,0 +1,70 @@
+#if !defined(_PROGRESSIVERENDERER_H_)
+
+#define _PROGRESSIVERENDERER_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RayTracer.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Renders the scene on a background thread, in passes:
+// first one ray per 8 x 8 block of pixels, then per 4 x 4
+// and 2 x 2 block, then every pixel.  Each coarse pass only
+// traces the pixels the earlier ones didn't; the last traces
+// them all again, exactly as render() does, so the final
+// image is the same as render()'s.
+//
+// The viewer shows the latest finished pass, so it stays
+// responsive while the full image is traced, and cancels
+// the render whenever the camera changes.
+//
+// While a render is running, nothing else may write the
+// camera, scene or frame size globals: call cancel() first.
+//
+//////////////////////////////////////////////////////////
+
+class ProgressiveRenderer {
+public:
+    ProgressiveRenderer();
+    ~ProgressiveRenderer();
+
+    // Cancel any render in progress, and start over with the
+    // current camera, scene and frame size.
+    void start();
+
+    // Stop the render thread, if it is running; returns once
+    // it has stopped.
+    void cancel();
+
+    //
+    // If a pass has finished since the last call, copy it into
+    // "frame" (winWidth x winHeight x 3 bytes) and return true.
+    //
+    bool latest(ubyte* frame);
+
+    // Passes finished since the last start(): 0 .. passes()
+    int finished() {return passes_done;};
+    static int passes();
+
+private:
+    void run();
+
+    thread worker;
+    atomic<bool> cancelled;
+
+    vector<ubyte> work;  // the pass being traced
+
+    mutex lock;         // guards "shown" and "fresh"
+    vector<ubyte> shown; // the latest finished pass
+    bool fresh;         // shown hasn't been handed to latest() yet
+
+    atomic<int> passes_done;
+};
+
+#endif
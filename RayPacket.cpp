@@ -0,0 +1,144 @@
+#include "RayPacket.h"
+#include "Simd.h"
+
+#include <float.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAYPACKET_X86 1
+#include <immintrin.h>
+#endif
+
+RayPacket::RayPacket() {
+    clear();
+}
+
+void RayPacket::clear() {
+    count = 0;
+
+    // Unused lanes still get loaded (and ignored) by the
+    // kernels, so keep them finite.
+    for (int i = 0; i < MAX_RAYS; i++) {
+        sx[i] = sy[i] = sz[i] = 0;
+        dx[i] = dy[i] = dz[i] = 0;
+        inv_dx[i] = inv_dy[i] = inv_dz[i] = 0;
+        a[i] = inv_a[i] = 0;
+        t[i] = FLT_MAX;
+        sphere[i] = triangle[i] = -1;
+        found[i] = false;
+    }
+}
+
+void RayPacket::add(const Ray4& ray) {
+    int i = count++;
+    rays[i] = ray;
+    sx[i] = ray.start.X();
+    sy[i] = ray.start.Y();
+    sz[i] = ray.start.Z();
+    dx[i] = ray.direction.X();
+    dy[i] = ray.direction.Y();
+    dz[i] = ray.direction.Z();
+    // As in BVH::first_hit(), SphereRay and TriangleRay
+    inv_dx[i] = 1.0f / dx[i];
+    inv_dy[i] = 1.0f / dy[i];
+    inv_dz[i] = 1.0f / dz[i];
+    a[i] = dx[i]*dx[i] + dy[i]*dy[i] + dz[i]*dz[i];
+    inv_a[i] = 1.0f / a[i];
+}
+
+uint64_t RayPacket::all() const {
+    return count >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << count) - 1;
+}
+
+bool RayPacket::coherent() const {
+    for (int i = 1; i < count; i++) {
+        if ((dx[i] < 0) != (dx[0] < 0) ||
+            (dy[i] < 0) != (dy[0] < 0) ||
+            (dz[i] < 0) != (dz[0] < 0))
+            return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////
+// Slab tests, as in AABB::intersects(), for each ray in
+// the mask.
+//////////////////////////////////////////////////////////
+
+static uint64_t boxes_scalar(const RayPacket& p, const AABB& box, uint64_t mask) {
+    uint64_t result = 0;
+    for (uint64_t m = mask; m; m &= m - 1) {
+        int i = __builtin_ctzll(m);
+        const float s[3] = {p.sx[i], p.sy[i], p.sz[i]};
+        const float inv[3] = {p.inv_dx[i], p.inv_dy[i], p.inv_dz[i]};
+        float t0 = 0;
+        float t1 = p.t[i];
+        for (int k = 0; k < 3; k++) {
+            float t_lo = (box.lo[k] - s[k]) * inv[k];
+            float t_hi = (box.hi[k] - s[k]) * inv[k];
+            if (t_lo > t_hi) {
+                float tmp = t_lo;
+                t_lo = t_hi;
+                t_hi = tmp;
+            }
+            t0 = t_lo > t0 ? t_lo : t0;
+            t1 = t_hi < t1 ? t_hi : t1;
+        }
+        if (t0 <= t1)
+            result |= (uint64_t)1 << i;
+    }
+    return result;
+}
+
+#if defined(RAYPACKET_X86)
+
+__attribute__((target("avx2")))
+static uint64_t boxes_avx2(const RayPacket& p, const AABB& box, uint64_t mask) {
+    const __m256 lo_x = _mm256_set1_ps(box.lo.X()), hi_x = _mm256_set1_ps(box.hi.X());
+    const __m256 lo_y = _mm256_set1_ps(box.lo.Y()), hi_y = _mm256_set1_ps(box.hi.Y());
+    const __m256 lo_z = _mm256_set1_ps(box.lo.Z()), hi_z = _mm256_set1_ps(box.hi.Z());
+
+    uint64_t result = 0;
+    for (int i = 0; i < RayPacket::MAX_RAYS; i += 8) {
+        unsigned lanes = (unsigned)(mask >> i) & 0xff;
+        if (!lanes)
+            continue;
+
+        __m256 t0 = _mm256_setzero_ps();
+        __m256 t1 = _mm256_load_ps(&p.t[i]);
+
+        // max(t_lo, t0) keeps t0 if t_lo is NaN; min(t_hi, t1) likewise
+        __m256 s = _mm256_load_ps(&p.sx[i]), inv = _mm256_load_ps(&p.inv_dx[i]);
+        __m256 ta = _mm256_mul_ps(_mm256_sub_ps(lo_x, s), inv);
+        __m256 tb = _mm256_mul_ps(_mm256_sub_ps(hi_x, s), inv);
+        t0 = _mm256_max_ps(_mm256_min_ps(ta, tb), t0);
+        t1 = _mm256_min_ps(_mm256_max_ps(ta, tb), t1);
+
+        s = _mm256_load_ps(&p.sy[i]);
+        inv = _mm256_load_ps(&p.inv_dy[i]);
+        ta = _mm256_mul_ps(_mm256_sub_ps(lo_y, s), inv);
+        tb = _mm256_mul_ps(_mm256_sub_ps(hi_y, s), inv);
+        t0 = _mm256_max_ps(_mm256_min_ps(ta, tb), t0);
+        t1 = _mm256_min_ps(_mm256_max_ps(ta, tb), t1);
+
+        s = _mm256_load_ps(&p.sz[i]);
+        inv = _mm256_load_ps(&p.inv_dz[i]);
+        ta = _mm256_mul_ps(_mm256_sub_ps(lo_z, s), inv);
+        tb = _mm256_mul_ps(_mm256_sub_ps(hi_z, s), inv);
+        t0 = _mm256_max_ps(_mm256_min_ps(ta, tb), t0);
+        t1 = _mm256_min_ps(_mm256_max_ps(ta, tb), t1);
+
+        lanes &= _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ));
+        result |= (uint64_t)lanes << i;
+    }
+    return result;
+}
+
+#endif
+
+uint64_t RayPacket::intersects(const AABB& box, uint64_t mask) const {
+#if defined(RAYPACKET_X86)
+    if (simd_level() >= SIMD_AVX2)
+        return boxes_avx2(*this, box, mask);
+#endif
+    return boxes_scalar(*this, box, mask);
+}
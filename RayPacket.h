@@ -0,0 +1,68 @@
+#if !defined(_RAYPACKET_H_)
+
+#define _RAYPACKET_H_
+
+#include <stdint.h>
+
+#include "GeomLib.h"
+#include "Hit.h"
+#include "AABB.h"
+
+//////////////////////////////////////////////////////////
+//
+// Up to 8 x 8 coherent rays (neighbouring primary rays),
+// traced through the BVH together: every node box, sphere
+// and triangle is fetched once for the whole packet and
+// tested against 8 of its rays at a time.
+//
+// Sets of rays are bit masks: bit i is rays[i].
+//
+//////////////////////////////////////////////////////////
+
+class RayPacket {
+public:
+    static const int MAX_RAYS = 64;
+
+    RayPacket();
+
+    void clear();
+    void add(const Ray4& ray);
+    int size() const {return count;};
+
+    // All of the rays, as a mask
+    uint64_t all() const;
+
+    //
+    // Do all the directions lie in one octant?  If not, the
+    // packet is split up too often in the BVH to be worth it,
+    // and its rays should be traced one at a time.
+    //
+    bool coherent() const;
+
+    //
+    // Which of the rays in "mask" enter the box before their
+    // nearest hit so far (t)?
+    //
+    uint64_t intersects(const AABB& box, uint64_t mask) const;
+
+    int count;
+    Ray4 rays[MAX_RAYS];
+
+    // The rays unpacked, for the kernels
+    alignas(32) float sx[MAX_RAYS], sy[MAX_RAYS], sz[MAX_RAYS];
+    alignas(32) float dx[MAX_RAYS], dy[MAX_RAYS], dz[MAX_RAYS];
+    alignas(32) float inv_dx[MAX_RAYS], inv_dy[MAX_RAYS], inv_dz[MAX_RAYS];
+    alignas(32) float a[MAX_RAYS], inv_a[MAX_RAYS]; // for spheres: D.D and 1/(D.D)
+
+    // Results: t of each ray's nearest hit so far (FLT_MAX if
+    // none), and which sphere or triangle that was (else -1).
+    alignas(32) float t[MAX_RAYS];
+    int sphere[MAX_RAYS];
+    int triangle[MAX_RAYS];
+
+    // Filled in by Accelerator::first_hit() for the rays that hit
+    bool found[MAX_RAYS];
+    Hit hits[MAX_RAYS];
+};
+
+#endif
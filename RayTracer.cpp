@@ -0,0 +1,1170 @@
+////////////////////////////////////////////////////
+//
+// The ray tracing core: scene, camera, and the
+// recursive tracer itself.  Nothing in here needs a
+// window, GLFW or OpenGL; rt.cpp adds the viewer.
+//
+//////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+
+#include "RayTracer.h"
+#include "Grid.h"
+#include "KdTree.h"
+#include "SceneFile.h"
+#include "MeshReader.h"
+#include "Tokenizer.h"
+
+using namespace std;
+
+// USEFUL Flag:
+// Turns on debugging output outside the ray path (scene loading, resizing).
+// To debug ONE ray of your choosing, click on its pixel: the
+// mouse_button_callback traces it with a TraceContext whose "debug" is set.
+bool debugOn = false;
+
+// FRAME BUFFER Declarations.
+// The initial image is 300 x 300 x 3 bytes (3 bytes per pixel)
+int winWidth  = 300;
+int winHeight = 300;
+ubyte *img = NULL;   // image is allocated by resize_frame_buffer(), not here.
+
+// These are the camera parameters.
+// The camera position and orientation:
+Point4  eye;
+Point4  lookat;
+Vector4 vup;
+
+// The camera's HOME parameters, used in reset_camera()
+Point4  eye_home;
+Point4  lookat_home;
+Vector4 vup_home;
+
+// The clipping frustum
+float clipL = -1;
+float clipR = +1;
+float clipB = -1;
+float clipT = +1;
+float clipN =  2;
+
+// The camera's HOME frustum, also used in reset_camera()
+float clip_home[5] = {-1, +1, -1, +1, 2};
+
+vector<Sphere> scene_spheres; // every sphere in the scene
+vector<Triangle> scene_triangles; // every triangle in the scene
+vector<Mesh> scene_meshes; // every triangle mesh in the scene
+vector<Instance> scene_instances; // every instance of a group
+vector<ObjectRef> scene_order; // every object, in the order read
+vector<Object*> scene_objects; // list of objects in the scene, in scene_order
+unique_ptr<Accelerator> scene_accel(new BVH()); // spatial index over scene_objects, built by read_scene()
+AcceleratorType accel_type = ACCEL_BVH; // which kind read_scene() builds
+bool accel_fixed = false; // accel_type was given on the command line: the scene can't change it
+BuildMethod bvh_build = BUILD_SAH; // how read_scene() builds the BVHs
+vector<SceneGroup> scene_groups; // groups of objects, drawn by instances
+vector<Light> scene_lights; // list of lights in the scene
+LightTree scene_light_tree; // the same lights, as arrays plus a hierarchy
+float light_cutoff = 0; // skip groups of lights that add less than this
+MaterialTable scene_materials; // every material; objects hold an index into it
+StringArena scene_names; // the names of everything above
+Color ambient_light; // indirect light that shines when all lights are blocked
+float ambient_fraction; // how much of lights is ambient
+
+Matrix4 Mvcswcs;  // the inverse of the view matrix.
+
+// Rays which miss all objects have this color.
+const Color background_color(0.3, 0.4, 0.4); // dark blue
+
+// Reflected and refracted rays go at most this deep.
+int max_recursion_depth = 4;
+
+// A reflected or refracted ray is traced only if it can add
+// more than min_ray_weight to its pixel: its weight, the
+// product of the reflection or transmission coefficients on
+// the way to it, must be above that in some channel.  So
+// rays off surfaces with black rho or tau are never traced.
+// Rays that aren't are taken to see the background.
+float min_ray_weight = 1.0f / 512;
+
+// If set, rays weighing less than roulette_weight are traced
+// with probability weight / roulette_weight, and what they add
+// is scaled up to make up for the ones that aren't.  This is
+// unbiased, but noisy.
+bool russian_roulette = false;
+float roulette_weight = 0.05f;
+
+// If set, lights are blocked by objects between them and the
+// shaded point (the ambient term is never blocked).
+bool shadows_on = false;
+
+// render() splits the frame into tile_size x tile_size tiles,
+// and traces them on num_threads threads (0 = one per core).
+int num_threads = 0;
+int tile_size = 16;
+
+// Primary rays are traced in packet_size x packet_size packets
+// (at most 8 x 8); 1 traces every ray on its own.
+int packet_size = 8;
+
+// Counters summed over all render threads for the last frame.
+TraceStats frame_stats;
+// Where the time of the last frame went
+PhaseTimes frame_phases;
+
+
+//////////////////////////////////////////////////////////////////////
+// Compute Mvcstowcs.
+// YOU MUST IMPLEMENT THIS FUNCTION.
+//////////////////////////////////////////////////////////////////////
+void setup_camera() {
+    Mvcswcs = Matrix4::Identity();
+
+    // The camera's basis vectors
+    Vector4 z = (eye - lookat).normalized();
+    Vector4 x = (vup^z).normalized();
+    Vector4 y = z^x;
+
+    // The inverse of the view matrix
+    Mvcswcs.set(x.X(), y.X(), z.X(), eye.X(),
+                x.Y(), y.Y(), z.Y(), eye.Y(),
+                x.Z(), y.Z(), z.Z(), eye.Z(),
+                0.0,   0.0,   0.0,      1.0);
+}
+
+
+/////////////////////////////////////////////////////////
+//
+// Get glossy color of a ray
+//
+/////////////////////////////////////////////////////////
+Color glossy_color(Ray4& ray, Hit& hit, Object* obj, TraceContext& ctx) {
+    Color color = Color(0, 0, 0);
+    const Material& material = obj->getMaterial();
+
+    Vector4 negatedV = -ray.direction;
+
+    // Only the lights in front of the surface can add anything.
+    const Color& kd = material.getDiffuse();
+    const Color& ks = material.getSpecular();
+    float k_max = max(kd.R() + ks.R(), max(kd.G() + ks.G(), kd.B() + ks.B()));
+
+    ctx.lights.clear();
+    scene_light_tree.find(hit.hitPoint(), hit.normal(), k_max, light_cutoff, ctx.lights);
+
+    for (int i : ctx.lights) {
+        Color light_color = scene_light_tree.color(i);
+        Vector4 toLight = scene_light_tree.position(i) - hit.hitPoint();
+        Vector4 lightDirection = toLight.normalized();
+
+        // A light behind the surface adds nothing anyway, so only
+        // lights in front of it need a shadow ray.
+        if (shadows_on && hit.normal() * lightDirection > 0) {
+            Ray4 shadowRay(hit.hitPoint(), lightDirection);
+            if (occluded(shadowRay, toLight.length(), ctx))
+                continue;
+        }
+
+        color += local_illumination(negatedV, hit.normal(), lightDirection, material, light_color);
+    }
+    color += material.getAmbient() * ambient_light;
+    return color;
+}
+
+/////////////////////////////////////////////////////////
+// Get color of a ray passing through (x,y)DCS. - TODO
+// Find the first object hit.
+//
+// When a ray hits a surface and refracts, there are two indexes of
+// refraction: n_i and n_t.  Which one is which?  I suggest that you use N
+// dot L, to decide if the ray is entering or exiting the material.
+/////////////////////////////////////////////////////////
+Color ray_color(Ray4& ray, int depth, TraceContext& ctx, const Color& weight) {
+    Hit hit;
+
+    ctx.stats.rays++;
+    COUNT_STAT(ctx.stats.depth[min(depth, TraceStats::MAX_DEPTH - 1)]++);
+    COUNT_STAT(if (depth == 0) ctx.stats.primary_rays++);
+
+    if(first_hit(ray, hit, ctx)) {
+        COUNT_STAT(ctx.stats.hits++);
+        return hit_color(ray, hit, depth, ctx, weight);
+    }
+    else {
+        COUNT_STAT(ctx.stats.misses++);
+        return background_color;
+    }
+}
+
+/////////////////////////////////////////////////////////
+// Should a reflected or refracted ray of this weight be
+// traced?  Its color is to be multiplied by "scale": more
+// than 1 if it survived Russian roulette (and "weight" is
+// scaled to match), 0 if it didn't.  A ray too dim to trace
+// is taken to see the background, as one past the maximum
+// depth does.
+/////////////////////////////////////////////////////////
+static bool trace_branch(Color& weight, float& scale, TraceContext& ctx) {
+    scale = 1;
+    float w = max(weight.R(), max(weight.G(), weight.B()));
+    if (w <= min_ray_weight) {
+        COUNT_STAT(ctx.stats.pruned_rays++);
+        return false;
+    }
+
+    if (russian_roulette && w < roulette_weight) {
+        float survive = w / roulette_weight;
+        if (ctx.random() >= survive) {
+            COUNT_STAT(ctx.stats.roulette_kills++);
+            scale = 0;
+            return false;
+        }
+        scale = 1 / survive;
+        weight *= scale;
+    }
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+// Color of a ray, given the first thing it hits.
+/////////////////////////////////////////////////////////
+Color hit_color(Ray4& ray, Hit& hit, int depth, TraceContext& ctx, const Color& weight) {
+    const Material& material = hit.getObject()->getMaterial();
+
+    if(material.getType() == PHONG)
+        return glossy_color(ray, hit, hit.getObject(), ctx);
+    else {
+
+        if(depth >= max_recursion_depth)
+            return background_color;
+
+        Vector4 R = mirror_direction(ray.direction, hit.normal());
+
+        // Reflection
+        float n_i = 0;
+        float n_t = 0;
+
+        // If the ray is entering
+        if(hit.normal() * ray.direction < 0) {
+            n_i = 1;
+            n_t = material.refraction_index;
+        }
+
+        // If the ray is exiting
+        else {
+            n_t = 1;
+            n_i = material.refraction_index;
+        }
+
+        Vector4 T;
+        if(!refract(ray.direction, hit.normal(), n_i, n_t, T)) {
+            COUNT_STAT(ctx.stats.total_internal_reflections++);
+            return material.color;
+        }
+
+        Ray4 rayR = Ray4(hit.hitPoint(), R);
+        Ray4 rayT = Ray4(hit.hitPoint(), T);
+
+        const Color& rho = material.getReflection();
+        const Color& tau = material.getTransmission();
+        Color weightR = weight * rho;
+        Color weightT = weight * tau;
+        Color colorR = background_color, colorT = background_color;
+        float scale;
+
+        if (trace_branch(weightR, scale, ctx)) {
+            COUNT_STAT(ctx.stats.reflection_rays++);
+            colorR = ray_color(rayR, depth + 1, ctx, weightR);
+        }
+        colorR *= scale;
+        if (trace_branch(weightT, scale, ctx)) {
+            COUNT_STAT(ctx.stats.refraction_rays++);
+            colorT = ray_color(rayT, depth + 1, ctx, weightT);
+        }
+        colorT *= scale;
+
+        return colorR * rho + colorT * tau + material.color;
+    }
+}
+
+
+
+//////////////////////////////////////////////////////////////////////
+// (Re)allocate the frame buffer, if it doesn't exist yet or its size
+// has changed.  Returns true if it was (re)allocated.
+//////////////////////////////////////////////////////////////////////
+bool resize_frame_buffer(int width, int height) {
+    if (img != NULL && width == winWidth && height == winHeight) {
+        return false;
+    }
+
+    delete[] img;
+    winWidth  = width;
+    winHeight = height;
+
+    if (debugOn) {
+        cout << "ALLOCATING: (W H)=(" << winWidth
+             << " " << winHeight << ")\n";
+    }
+
+    img = new ubyte[winWidth * winHeight * 3];
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+// Initialize a ray starting at (x y)DCS.
+// YOU MUST IMPLEMENT THIS FUNCTION.
+/////////////////////////////////////////////////////////
+Ray4 get_ray(int xDCS, int yDCS) {
+    float dx = (clipR - clipL) / winWidth;
+    float xVcs = clipL + (xDCS + 0.5) * dx;
+
+    float dy = (clipT - clipB) / winHeight;
+    float yVcs = clipB + (yDCS + 0.5) * dy;
+
+    float zVcs = -clipN;
+    Point4 pVcs = Point4(xVcs, yVcs, zVcs);
+
+    Float4 F_wcs = Mvcswcs * pVcs;
+    Point4 pWcs(F_wcs.X(), F_wcs.Y(), F_wcs.Z());
+
+    Vector4 V = pWcs - eye;
+    V = V.normalized();
+
+    Ray4 ray = Ray4(pWcs, V);
+    return ray;
+}
+
+/////////////////////////////////////////////////////////
+// Find the first object hit by the ray, if any
+// YOU MUST IMPLEMENT THIS FUNCTION.
+/////////////////////////////////////////////////////////
+bool first_hit(Ray4 &ray, Hit& hit, TraceContext& ctx) {
+    long tests = ctx.stats.intersection_tests;
+
+    bool isThereMinHit = scene_accel->first_hit(ray, hit, ctx);
+
+    if (ctx.debug) {
+        cout << "first_hit: " << ctx.stats.intersection_tests - tests << " tests";
+        if (isThereMinHit)
+            cout << ", nearest hit at distance " << hit.getDistance();
+        else
+            cout << ", no hit";
+        cout << "\n";
+    }
+    return isThereMinHit;
+}
+
+/////////////////////////////////////////////////////////
+// Is anything between the ray's start and t_max?
+// (For shadow rays: no hit record, stops at the first blocker.)
+/////////////////////////////////////////////////////////
+bool occluded(Ray4 &ray, float t_max, TraceContext& ctx) {
+    ctx.stats.shadow_rays++;
+    return scene_accel->occluded(ray, t_max, ctx);
+}
+
+/////////////////////////////////////////////////////////
+// first_hit() for every ray of a packet.  Returns false,
+// having traced nothing, if the rays are too divergent
+// for a packet to pay off.
+/////////////////////////////////////////////////////////
+bool first_hit(RayPacket& packet, TraceContext& ctx) {
+    if (!packet.coherent())
+        return false;
+
+    scene_accel->first_hit(packet, ctx);
+    return true;
+}
+
+
+//////////////////////////////////////////////////////
+// A ray hits a mirror.
+// Return the direction of the reflected ray.
+//////////////////////////////////////////////////////
+Vector4 mirror_direction(Vector4& V, Vector4& N) {
+    float NV = N * V;
+    return V - (2.0f * NV) * N;
+}
+
+//////////////////////////////////////////////////////
+// A ray hits a specular surface.
+// Compute the direction of the refracted ray. - TODO
+// Given an incident ray’s direction, the surface’s normal, and the two indexes of refraction, set the refracted ray.
+// If there is total internal refraction, return false.
+// YOU MUST IMPLEMENT THIS FUNCTION.
+//////////////////////////////////////////////////////
+bool refract(Vector4& V, Vector4& N, float n_i, float n_t, Vector4& direction) {
+    Vector4 newN = N;
+    if(V*N > 0) newN = -N;
+
+    float alpha = -V * newN;
+    float beta = sqrtf(1 - alpha * alpha);
+    float Y = (n_i / n_t) * beta;
+
+    if(1 - Y * Y < 0)
+        return false;
+
+    float delta = sqrtf(1 - Y * Y);
+    Vector4 A = V + alpha * newN;
+    Vector4 C = -delta * newN;
+    Vector4 D = (n_i / n_t) * A;
+
+    direction = C + D;
+    direction = direction.normalized();
+    return true;
+}
+
+
+//////////////////////////////////////////////////////
+// A ray hits a phong surface.
+// Compute the color of the surface.
+// YOU MUST IMPLEMENT THIS FUNCTION.
+//////////////////////////////////////////////////////
+Color local_illumination(Vector4& V, Vector4& N, Vector4& L, const Material& mat, Color& ls) {
+    float NL = N.dot(L);
+    if (NL > 0) {
+        // light on up side of surface.
+
+        Vector4 R = mirror_direction(L, N);
+        float RV = R.dot(V);
+        if (RV < 0) {
+            // On back side of specular blob, use 0 instead.
+            RV = 0;
+        }
+
+        //
+        // Fast (R.V)^n
+        // Avoid pow().  It's SLOOOOWW!
+        //
+        float RVn = 1.0f;
+
+
+        if (RV <= 0.0f)
+            RVn = 0.0f;
+        else {
+            int n = mat.getShininess();
+            while (n > 0) {
+                if (n & 1)
+                    RVn *= RV;
+                RV *= RV;
+                n >>= 1;
+            }
+        }
+
+        const Color& kd = mat.getDiffuse();
+        const Color& ks = mat.getSpecular();
+
+        return ls * (kd * NL + ks * RVn);
+    }
+    else
+        return Color(0,0,0);  // light on back, no illumination.
+}
+
+/////////////////////////////////////////////////////////
+// Set up everything the render threads read but never
+// write: the camera matrix and the ambient light.
+/////////////////////////////////////////////////////////
+void prepare_frame() {
+    setup_camera();
+
+    ambient_light = Color(0,0,0);
+    for (const Light& light : scene_lights) {
+        ambient_light += light.c * ambient_fraction;
+    }
+}
+
+/////////////////////////////////////////////////////////
+// This function actually generates the ray-traced image.
+// The frame is cut into tiles, which are traced in parallel.
+/////////////////////////////////////////////////////////
+void render() {
+    auto start = chrono::steady_clock::now();
+    prepare_frame();
+    auto setup_done = chrono::steady_clock::now();
+
+    TileScheduler scheduler(winWidth, winHeight, tile_size, num_threads);
+
+    // One trace context per worker: the workers share nothing else.
+    vector<TraceContext> contexts(scheduler.workers());
+
+    scheduler.run([&contexts](const Tile& tile, int worker) {
+        render_tile(tile, contexts[worker], img);
+    });
+
+    auto stop = chrono::steady_clock::now();
+    frame_phases.setup = chrono::duration<double, milli>(setup_done - start).count();
+    frame_phases.trace = chrono::duration<double, milli>(stop - setup_done).count();
+
+    frame_stats.clear();
+    for (auto& ctx : contexts) {
+        frame_stats += ctx.stats;
+    }
+}
+
+/////////////////////////////////////////////////////////
+// Write the last frame's counters and phase times to a
+// JSON file.  Returns false, after printing why, if the
+// file can't be written.
+/////////////////////////////////////////////////////////
+bool write_frame_stats(const string& filename) {
+    ofstream out(filename.c_str());
+    if (!out) {
+        cerr << "Can't write " << filename << "\n";
+        return false;
+    }
+
+    out << "{\"width\": " << winWidth << ", \"height\": " << winHeight
+        << ", \"threads\": " << (num_threads > 0 ? num_threads : TileScheduler::hardware_threads())
+        << ", \"max_recursion_depth\": " << max_recursion_depth
+        << ", \"min_ray_weight\": " << min_ray_weight
+        << ", \"russian_roulette\": " << (russian_roulette ? "true" : "false")
+        << ", \"accelerator\": \"" << scene_accel->name() << "\""
+        << ", \"bvh\": \"" << build_method_name(bvh_build) << "\""
+        << ", \"detailed\": " << (RENDER_STATS ? "true" : "false") << ",\n";
+    out << " \"counters\": {";
+    frame_stats.write_json(out, max_recursion_depth);
+    out << "},\n";
+    out << " \"phase_ms\": {\"parse\": " << frame_phases.parse
+        << ", \"build\": " << frame_phases.build
+        << ", \"update\": " << frame_phases.update
+        << ", \"setup\": " << frame_phases.setup
+        << ", \"trace\": " << frame_phases.trace
+        << ", \"framebuffer\": " << frame_phases.framebuffer << "}}\n";
+    return true;
+}
+
+/////////////////////////////////////////////////////////
+// Store one pixel's color in a frame buffer (laid out as
+// "img" is).
+/////////////////////////////////////////////////////////
+static void set_pixel(ubyte* frame, int x, int y, Color pixel_color) {
+    pixel_color.clamp();
+
+    int p = (y*winWidth + x) * 3;
+
+    frame[p]   = (ubyte) (pixel_color.R() * 255.0);
+    frame[p+1] = (ubyte) (pixel_color.G() * 255.0);
+    frame[p+2] = (ubyte) (pixel_color.B() * 255.0);
+}
+
+/////////////////////////////////////////////////////////
+// Trace every pixel of one tile into a frame buffer.
+/////////////////////////////////////////////////////////
+void render_tile(const Tile& tile, TraceContext& ctx, ubyte* frame) {
+    ctx.seed(tile.y0 * winWidth + tile.x0);
+    int n = min(max(packet_size, 1), 8);
+
+    if (n > 1 && !ctx.debug) {
+        for (int y = tile.y0; y < tile.y1; y += n) {
+            for (int x = tile.x0; x < tile.x1; x += n) {
+                render_packet(x, y, min(x + n, tile.x1), min(y + n, tile.y1), ctx, frame);
+            }
+        }
+        return;
+    }
+
+    for (int y=tile.y0; y<tile.y1; y++) {
+        for (int x=tile.x0; x<tile.x1; x++) {
+
+            if (ctx.debug) {
+                cout << "pixel (" << x << " " << y << ")\n";
+                cout.flush();
+            }
+
+            Ray4 ray = get_ray(x, y);
+            set_pixel(frame, x, y, ray_color(ray, 0, ctx));
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+// A coarse version of render_tile(), for progressive
+// rendering: trace only the pixels whose x and y are
+// multiples of "step", and fill the step x step block
+// above and right of each with its color.  Pixels that are
+// also multiples of "skip" were traced by an earlier pass,
+// and are left alone (skip = 0 traces them all).
+//
+// The tile must start at multiples of step.
+/////////////////////////////////////////////////////////
+void render_coarse_tile(const Tile& tile, int step, int skip, TraceContext& ctx, ubyte* frame) {
+    ctx.seed(tile.y0 * winWidth + tile.x0);
+    for (int y = tile.y0; y < tile.y1; y += step) {
+        for (int x = tile.x0; x < tile.x1; x += step) {
+            if (skip > 0 && x % skip == 0 && y % skip == 0)
+                continue;
+
+            Ray4 ray = get_ray(x, y);
+            Color color = ray_color(ray, 0, ctx);
+
+            for (int by = y; by < min(y + step, tile.y1); by++) {
+                for (int bx = x; bx < min(x + step, tile.x1); bx++) {
+                    set_pixel(frame, bx, by, color);
+                }
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////
+// Trace the pixels x0 <= x < x1, y0 <= y < y1 (at most
+// 8 x 8) into a frame buffer, finding the first hits of
+// their primary rays as one packet.  Everything after the
+// first hit (shading, shadow and secondary rays) is traced
+// ray by ray.
+/////////////////////////////////////////////////////////
+void render_packet(int x0, int y0, int x1, int y1, TraceContext& ctx, ubyte* frame) {
+    RayPacket packet;
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            packet.add(get_ray(x, y));
+        }
+    }
+
+    if (!first_hit(packet, ctx)) {
+        // Too divergent: one ray at a time.
+        int i = 0;
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                set_pixel(frame, x, y, ray_color(packet.rays[i++], 0, ctx));
+            }
+        }
+        return;
+    }
+
+    ctx.stats.rays += packet.size();
+    COUNT_STAT(ctx.stats.primary_rays += packet.size());
+    COUNT_STAT(ctx.stats.depth[0] += packet.size());
+
+    int i = 0;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++, i++) {
+            if (packet.found[i]) {
+                COUNT_STAT(ctx.stats.hits++);
+                set_pixel(frame, x, y, hit_color(packet.rays[i], packet.hits[i], 0, ctx));
+            }
+            else {
+                COUNT_STAT(ctx.stats.misses++);
+                set_pixel(frame, x, y, background_color);
+            }
+        }
+    }
+}
+
+// Names live in scene_names, so freeing these arrays is all
+// it takes to free their elements.
+static_assert(is_trivially_destructible<Sphere>::value, "Sphere must be trivially destructible");
+static_assert(is_trivially_destructible<Triangle>::value, "Triangle must be trivially destructible");
+static_assert(is_trivially_destructible<Instance>::value, "Instance must be trivially destructible");
+static_assert(is_trivially_destructible<Light>::value, "Light must be trivially destructible");
+static_assert(is_trivially_destructible<Material>::value, "Material must be trivially destructible");
+
+// Empty a container and give back its memory
+template <class T>
+static void release(T& container) {
+    T().swap(container);
+}
+
+unique_ptr<Accelerator> make_accelerator(AcceleratorType type, BuildMethod method) {
+    switch (type) {
+    case ACCEL_GRID:   return unique_ptr<Accelerator>(new Grid());
+    case ACCEL_KDTREE: return unique_ptr<Accelerator>(new KdTree());
+    default:           return unique_ptr<Accelerator>(new BVH(method));
+    }
+}
+
+//////////////////////////////////////////////////////
+// Forget the scene, so another can be read.  The camera
+// is left alone: read_scene() sets what the file gives.
+/////////////////////////////////////////////////////
+void clear_scene() {
+    release(scene_objects);
+    release(scene_spheres);
+    release(scene_triangles);
+    release(scene_meshes);
+    release(scene_instances);
+    release(scene_groups);
+    release(scene_order);
+    release(scene_lights);
+    scene_materials = MaterialTable();
+    scene_accel.reset(new BVH());
+    if (!accel_fixed)
+        accel_type = ACCEL_BVH;
+    scene_light_tree = LightTree();
+    scene_names.clear();
+    ambient_light.set(0,0,0);
+}
+
+//////////////////////////////////////////////////////
+// This function sets up a simple scene.
+// YOU MUST IMPLEMENT THIS FUNCTION.
+/////////////////////////////////////////////////////
+// The keywords that start an entry in a scene file
+enum SceneKeyword {
+    KW_UNKNOWN, KW_MATERIALS, KW_LIGHTS, KW_OBJECTS, KW_LIGHT, KW_MATERIAL,
+    KW_SPHERE, KW_TRIANGLE, KW_MESH, KW_CAMERA_EYE, KW_CAMERA_LOOKAT, KW_CAMERA_VUP, KW_CAMERA_CLIP,
+    KW_GROUP, KW_END_GROUP, KW_INSTANCE, KW_ACCELERATOR
+};
+
+static const string_view keyword_names[] = {
+    "", "#materials", "#lights", "#objects", "light", "material",
+    "sphere", "triangle", "mesh", "camera_eye", "camera_lookat", "camera_vup", "camera_clip",
+    "group", "end_group", "instance", "accelerator"
+};
+
+// The length, and a character where needed, pick the only
+// keyword it can be; one compare checks it.
+static SceneKeyword scene_keyword(string_view word) {
+    SceneKeyword k = KW_UNKNOWN;
+    switch (word.size()) {
+    case 4:  k = KW_MESH; break;
+    case 5:  k = word[0] == 'l' ? KW_LIGHT : KW_GROUP; break;
+    case 6:  k = KW_SPHERE; break;
+    case 7:  k = KW_LIGHTS; break;
+    case 8:  k = word[0] == 'm' ? KW_MATERIAL : word[0] == '#' ? KW_OBJECTS :
+                 word[0] == 'i' ? KW_INSTANCE : KW_TRIANGLE; break;
+    case 9:  k = KW_END_GROUP; break;
+    case 10: k = word[0] == '#' ? KW_MATERIALS : word[7] == 'e' ? KW_CAMERA_EYE : KW_CAMERA_VUP; break;
+    case 11: k = word[0] == 'a' ? KW_ACCELERATOR : KW_CAMERA_CLIP; break;
+    case 13: k = KW_CAMERA_LOOKAT; break;
+    }
+    return word == keyword_names[k] ? k : KW_UNKNOWN;
+}
+
+// A path in a scene file, which is relative to the scene
+// file's directory unless it's absolute
+static string relative_path(const char *scene_file, string_view path) {
+    string scene(scene_file);
+    size_t slash = scene.find_last_of("/\\");
+    bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\' ||
+                                      (path.size() > 1 && path[1] == ':'));
+    if (absolute || slash == string::npos)
+        return string(path);
+    return scene.substr(0, slash + 1) + string(path);
+}
+
+static void read_scene_text(const char *filename) {
+    float r,g,b;
+    float x,y,z;
+    int nLights;
+    int nObjects = 0;
+    int objects_read = 0;
+
+    // Objects mostly come in runs with the same material
+    string last_material_name;
+    int last_material = -1;
+
+    auto find_material = [&](string_view name) {
+        if (last_material < 0 || name != last_material_name) {
+            last_material_name = name;
+            last_material = scene_materials.find(name);
+        }
+        return last_material;
+    };
+
+    // "#objects" says how many are coming, so a full array is
+    // grown to hold the rest, not doubled.
+    auto make_room = [&](auto& pool) {
+        int left = nObjects - objects_read++;
+        if (pool.size() == pool.capacity() && left > 0)
+            pool.reserve(pool.size() + left);
+    };
+
+    // Objects go in the scene, or in the group being read
+    vector<ObjectRef>* objects = &scene_order;
+    map<string, int, less<>> group_by_name;
+
+    Tokenizer toker(filename);
+
+    while (!toker.eof()) {
+        string_view keyword = toker.next_string();
+
+        switch (scene_keyword(keyword)) {
+        case KW_MATERIALS:
+            toker.next_number();
+            // Don't do anything (materials are now in scene_materials)
+            break;
+
+        case KW_LIGHTS:
+            nLights = toker.next_number();
+            scene_lights.reserve(nLights);
+            break;
+
+        case KW_OBJECTS:
+            nObjects = toker.next_number();
+            scene_order.reserve(scene_order.size() + nObjects);
+            break;
+
+        case KW_LIGHT: {
+            Color c;
+            Point4 p;
+
+            string_view name = scene_names.add(toker.next_string());
+
+            toker.match("color");
+            r = toker.next_number();
+            g = toker.next_number();
+            b = toker.next_number();
+            c.set(r,g,b);
+
+            ambient_light += c * ambient_fraction;
+
+            toker.match("position");
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            p.set(x,y,z);
+
+            Light l(c, p);
+            l.name = name;
+
+            scene_lights.push_back(l);
+            break;
+        }
+
+        case KW_CAMERA_EYE:
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            eye = Point4(x,y,z);
+            eye_home = eye;
+            break;
+
+        case KW_CAMERA_LOOKAT:
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            lookat = Point4(x,y,z);
+            lookat_home = lookat;
+            break;
+
+        case KW_CAMERA_VUP:
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            vup = Vector4(x,y,z);
+            vup_home = vup;
+            break;
+
+        case KW_CAMERA_CLIP:
+            clipL = toker.next_number();
+            clipR = toker.next_number();
+            clipB = toker.next_number();
+            clipT = toker.next_number();
+            clipN = toker.next_number();
+            clip_home[0] = clipL;
+            clip_home[1] = clipR;
+            clip_home[2] = clipB;
+            clip_home[3] = clipT;
+            clip_home[4] = clipN;
+            break;
+
+        case KW_MATERIAL: {
+            Material newMaterial;
+            newMaterial.name = scene_names.add(toker.next_string());
+
+            toker.next_string(); // material_type
+            string_view materialType = toker.next_string();
+
+            if (materialType == "phong") {
+                newMaterial.surface_type = PHONG;
+
+                toker.next_string();
+                r = toker.next_number();
+                g = toker.next_number();
+                b = toker.next_number();
+                Color ambient = Color(r,g,b);
+
+                toker.next_string();
+                r = toker.next_number();
+                g = toker.next_number();
+                b = toker.next_number();
+                Color diffuse = Color(r,g,b);
+
+                toker.next_string();
+                r = toker.next_number();
+                g = toker.next_number();
+                b = toker.next_number();
+                Color specular = Color(r,g,b);
+
+                toker.next_string();
+                auto shininess = (int)toker.next_number();
+
+                newMaterial.set(ambient, diffuse, specular, shininess);
+            }
+            else if (materialType == "specular") {
+                newMaterial.surface_type = SPECULAR;
+
+                toker.next_string();
+                float index = toker.next_number();
+
+                toker.next_string();
+                r = toker.next_number();
+                g = toker.next_number();
+                b = toker.next_number();
+                Color tau = Color(r,g,b);
+
+                toker.next_string();
+                r = toker.next_number();
+                g = toker.next_number();
+                b = toker.next_number();
+                Color rho = Color(r,g,b);
+
+                toker.next_string();
+                r = toker.next_number();
+                g = toker.next_number();
+                b = toker.next_number();
+                Color color = Color(r,g,b);
+
+                newMaterial.set(index, tau, rho, color);
+            }
+            else {
+                toker.error("unrecognized material type \"" + string(materialType) + "\"");
+            }
+            scene_materials.add(newMaterial);
+            last_material = -1; // the name may now mean this one
+            break;
+        }
+
+        case KW_SPHERE: {
+            string_view name = scene_names.add(toker.next_string());
+
+            toker.next_string();
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            Point4 center = Point4(x,y,z);
+
+            toker.next_string();
+            float radius = toker.next_number();
+
+            toker.next_string();
+            int material = find_material(toker.next_string());
+
+            make_room(scene_spheres);
+            objects->push_back({SPHERE, (int)scene_spheres.size()});
+            scene_spheres.push_back(Sphere(center, radius, material));
+            scene_spheres.back().name = name;
+            break;
+        }
+
+        case KW_TRIANGLE: {
+            string_view name = scene_names.add(toker.next_string());
+
+            toker.next_string();
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            Point4 v1 = Point4(x,y,z);
+
+            toker.next_string();
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            Point4 v2 = Point4(x,y,z);
+
+            toker.next_string();
+            x = toker.next_number();
+            y = toker.next_number();
+            z = toker.next_number();
+            Point4 v3 = Point4(x,y,z);
+
+            toker.next_string();
+            int material = find_material(toker.next_string());
+
+            make_room(scene_triangles);
+            objects->push_back({TRIANGLE, (int)scene_triangles.size()});
+            scene_triangles.push_back(Triangle(v1,v2,v3,material));
+            scene_triangles.back().name = name;
+            break;
+        }
+
+        case KW_MESH: {
+            string name(toker.next_string());
+
+            toker.next_string(); // file
+            string path = relative_path(filename, toker.next_token());
+
+            toker.next_string();
+            int material = find_material(toker.next_string());
+
+            Mesh mesh(material);
+            mesh.name = scene_names.add(name);
+            if (!read_mesh(path, mesh)) {
+                toker.error("can't read mesh \"" + name + "\"");
+            }
+            make_room(scene_meshes);
+            objects->push_back({MESH, (int)scene_meshes.size()});
+            scene_meshes.push_back(move(mesh));
+            break;
+        }
+
+        case KW_GROUP: {
+            if (objects != &scene_order)
+                toker.error("groups can't be nested");
+            SceneGroup group;
+            group.name = scene_names.add(toker.next_token());
+            if (group_by_name.count(group.name))
+                toker.error("group \"" + string(group.name) + "\" is already defined");
+            scene_groups.push_back(move(group));
+            objects = &scene_groups.back().members;
+            break;
+        }
+
+        case KW_END_GROUP: {
+            if (objects == &scene_order)
+                toker.error("end_group without a group");
+            SceneGroup& group = scene_groups.back();
+            if (group.members.empty())
+                toker.error("group \"" + string(group.name) + "\" is empty");
+            // Only now can instances refer to it, so groups can't contain themselves.
+            group_by_name[string(group.name)] = (int)scene_groups.size() - 1;
+            objects = &scene_order;
+            break;
+        }
+
+        case KW_INSTANCE: {
+            string name(toker.next_token());
+
+            toker.match("object");
+            string_view group_name = toker.next_token();
+            auto group = group_by_name.find(group_name);
+            if (group == group_by_name.end())
+                toker.error("no group named \"" + string(group_name) + "\"");
+
+            // Scale, then rotate about x, y and z, then translate
+            float t[3], angle[3], scale[3];
+            toker.match("translate");
+            for (float& v : t)
+                v = toker.next_number();
+            toker.match("rotate");
+            for (float& v : angle)
+                v = toker.next_number();
+            toker.match("scale");
+            for (float& v : scale)
+                v = toker.next_number();
+            Matrix4 M = Matrix4::Translation(t[0], t[1], t[2]) *
+                        Matrix4::ZRotation(angle[2]) * Matrix4::YRotation(angle[1]) *
+                        Matrix4::XRotation(angle[0]) *
+                        Matrix4::Scaling(scale[0], scale[1], scale[2]);
+            if (fabs(M.determinant()) < 1e-12f)
+                toker.error("instance \"" + name + "\" has a zero scale");
+
+            Instance instance(group->second, M);
+            instance.name = scene_names.add(name);
+            make_room(scene_instances);
+            objects->push_back({INSTANCE, (int)scene_instances.size()});
+            scene_instances.push_back(instance);
+            break;
+        }
+
+        case KW_ACCELERATOR: {
+            string_view name = toker.next_token();
+            AcceleratorType type;
+            if (!accelerator_type(name, type))
+                toker.error("unknown accelerator \"" + string(name) + "\" (bvh, grid or kdtree)");
+            if (!accel_fixed)
+                accel_type = type;
+            break;
+        }
+
+        default:
+            toker.error("unrecognized keyword \"" + string(keyword) + "\"");
+        }
+    }
+    if (objects != &scene_order)
+        toker.error("group \"" + string(scene_groups.back().name) + "\" has no end_group");
+}
+
+Object* scene_object(ObjectRef ref) {
+    switch (ref.type) {
+    case SPHERE:   return &scene_spheres[ref.index];
+    case TRIANGLE: return &scene_triangles[ref.index];
+    case MESH:     return &scene_meshes[ref.index];
+    default:       return &scene_instances[ref.index];
+    }
+}
+
+// Print what the scene takes up in memory, in one line
+static void print_scene_memory() {
+    auto array_bytes = [](auto& v) {
+        return v.capacity() * sizeof(v[0]);
+    };
+    size_t objects = array_bytes(scene_spheres) + array_bytes(scene_triangles)
+                   + array_bytes(scene_meshes) + array_bytes(scene_instances)
+                   + array_bytes(scene_order) + array_bytes(scene_objects);
+    for (auto& mesh : scene_meshes)
+        objects += mesh.bytes();
+    size_t groups = array_bytes(scene_groups);
+    for (auto& group : scene_groups)
+        groups += array_bytes(group.members) + array_bytes(group.objects) + group.bvh.bytes();
+    size_t accel = scene_accel->bytes();
+    size_t lights = array_bytes(scene_lights) + scene_light_tree.bytes();
+    size_t materials = scene_materials.bytes();
+    size_t names = scene_names.bytes();
+    size_t total = objects + groups + accel + lights + materials + names;
+
+    auto kb = [](size_t bytes) {return (bytes + 1023) / 1024;};
+    cerr << "Scene memory: " << kb(total) << " KB (objects " << kb(objects)
+         << ", groups " << kb(groups) << ", " << scene_accel->name() << " " << kb(accel)
+         << ", lights " << kb(lights) << ", materials " << kb(materials)
+         << ", names " << kb(names) << ")\n";
+}
+
+//////////////////////////////////////////////////////
+// Read a scene, text or compiled (see SceneFile.h),
+// and build its accelerator.
+/////////////////////////////////////////////////////
+void read_scene(const char *filename) {
+    auto start = chrono::steady_clock::now();
+    ambient_light.set(0,0,0);
+
+    if (is_scene_file(filename)) {
+        load_scene_file(filename);
+    }
+    else {
+        read_scene_text(filename);
+    }
+
+    // The arrays are done growing, so pointers into them stay put.
+    // A group may hold instances of earlier groups, whose BVHs
+    // must be built before its own.
+    for (auto& instance : scene_instances)
+        instance.setGroup(&scene_groups[instance.group()].bvh);
+    auto read = chrono::steady_clock::now();
+    for (auto& group : scene_groups) {
+        group.objects.clear();
+        for (auto ref : group.members)
+            group.objects.push_back(scene_object(ref));
+        group.bvh.setMethod(bvh_build);
+        group.bvh.build(group.objects, num_threads);
+    }
+
+    scene_objects.clear();
+    scene_objects.reserve(scene_order.size());
+    for (auto ref : scene_order)
+        scene_objects.push_back(scene_object(ref));
+
+    scene_accel = make_accelerator(accel_type, bvh_build);
+    scene_accel->build(scene_objects, num_threads);
+    scene_light_tree.build(scene_lights);
+
+    auto stop = chrono::steady_clock::now();
+    frame_phases.parse = chrono::duration<double, milli>(read - start).count();
+    frame_phases.build = chrono::duration<double, milli>(stop - read).count();
+    print_scene_memory();
+
+    if (debugOn) {
+        cout << *scene_accel << "\n";
+    }
+}
+
@@ -0,0 +1,140 @@
+#if !defined(_RAYTRACER_H_)
+
+#define _RAYTRACER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GeomLib.h"
+#include "Color.h"
+#include "Object.h"
+#include "Sphere.h"
+#include "Triangle.h"
+#include "Mesh.h"
+#include "Instance.h"
+#include "Hit.h"
+#include "Light.h"
+#include "LightTree.h"
+#include "Material.h"
+#include "MaterialTable.h"
+#include "StringArena.h"
+#include "BVH.h"
+#include "TileScheduler.h"
+#include "TraceContext.h"
+#include "RayPacket.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// The ray tracing core (RayTracer.cpp): reads a scene,
+// and renders it into the frame buffer "img".
+//
+// None of this touches GLFW or OpenGL, so it can run
+// without a display (see the --output option in rt.cpp).
+//
+//////////////////////////////////////////////////////////
+
+typedef unsigned char ubyte; // not "byte": with "using namespace std", that clashes with std::byte
+
+// Debugging output outside the ray path
+extern bool debugOn;
+
+// FRAME BUFFER: winWidth x winHeight x 3 bytes (RGB), bottom row first
+extern int winWidth;
+extern int winHeight;
+extern ubyte *img;
+
+// The camera
+extern Point4  eye;
+extern Point4  lookat;
+extern Vector4 vup;
+extern Point4  eye_home;
+extern Point4  lookat_home;
+extern Vector4 vup_home;
+extern float clipL, clipR, clipB, clipT, clipN;
+extern float clip_home[5];
+
+// The scene.  The objects live in one array per type;
+// scene_objects points into them, in the order read.
+struct ObjectRef {
+    ObjectType type; // which array
+    int index;       // where in it
+};
+extern vector<Sphere> scene_spheres;
+extern vector<Triangle> scene_triangles;
+extern vector<Mesh> scene_meshes;
+extern vector<Instance> scene_instances;
+extern vector<ObjectRef> scene_order;
+Object* scene_object(ObjectRef ref); // the object a reference names
+extern vector<Object*> scene_objects;
+extern unique_ptr<Accelerator> scene_accel;
+extern AcceleratorType accel_type;
+extern bool accel_fixed;
+extern BuildMethod bvh_build;
+
+// A new, empty accelerator of the given kind (for a BVH,
+// built with "method")
+unique_ptr<Accelerator> make_accelerator(AcceleratorType type, BuildMethod method);
+
+// A group of objects that instances place in the scene.
+// Its members live in the same arrays as the scene's, but
+// are only drawn through instances.  A group's members
+// may be instances of earlier groups.
+struct SceneGroup {
+    string_view name;
+    vector<ObjectRef> members;
+    vector<Object*> objects; // the members, linked
+    BVH bvh;                 // over objects, in the group's space
+};
+extern vector<SceneGroup> scene_groups;
+extern vector<Light> scene_lights;
+extern LightTree scene_light_tree;
+extern float light_cutoff;
+extern MaterialTable scene_materials;
+extern StringArena scene_names; // every name in the scene
+extern Color ambient_light;
+extern float ambient_fraction;
+
+extern Matrix4 Mvcswcs;
+
+extern const Color background_color;
+extern int max_recursion_depth;
+extern float min_ray_weight;
+extern bool russian_roulette;
+extern float roulette_weight;
+extern bool shadows_on;
+
+// Parallel rendering
+extern int num_threads;
+extern int tile_size;
+extern int packet_size;
+extern TraceStats frame_stats;
+extern PhaseTimes frame_phases;
+
+void setup_camera();
+bool resize_frame_buffer(int width, int height);
+Ray4 get_ray(int xDCS, int yDCS);
+bool first_hit(Ray4 &ray, Hit& hit, TraceContext& ctx);
+bool first_hit(RayPacket& packet, TraceContext& ctx);
+bool occluded(Ray4 &ray, float t_max, TraceContext& ctx);
+Color glossy_color(Ray4& ray, Hit& hit, Object* obj, TraceContext& ctx);
+// "weight" is the most the ray's color can add to its pixel
+// (see min_ray_weight); primary rays weigh 1.
+Color ray_color(Ray4& ray, int depth, TraceContext& ctx, const Color& weight = Color(1, 1, 1));
+Color hit_color(Ray4& ray, Hit& hit, int depth, TraceContext& ctx, const Color& weight = Color(1, 1, 1));
+Vector4 mirror_direction(Vector4& L, Vector4& N);
+bool refract(Vector4& L, Vector4& N, float n_in, float n_trans, Vector4& T);
+Color local_illumination(Vector4& V, Vector4& N, Vector4& L, const Material& mat, Color& ls);
+void read_scene(const char *sceneFile);
+void clear_scene();
+void prepare_frame();
+void render();
+bool write_frame_stats(const string& filename);
+void render_tile(const Tile& tile, TraceContext& ctx, ubyte* frame);
+void render_coarse_tile(const Tile& tile, int step, int skip, TraceContext& ctx, ubyte* frame);
+void render_packet(int x0, int y0, int x1, int y1, TraceContext& ctx, ubyte* frame);
+
+#endif
@@ -0,0 +1,426 @@
+#include "SceneFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "MappedFile.h"
+#include "RayTracer.h"
+
+bool is_scene_file(const char *filename) {
+    char magic[sizeof(SCENE_FILE_MAGIC)];
+    ifstream in(filename, ios::binary);
+    return in.read(magic, sizeof(magic)) && memcmp(magic, SCENE_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+//////////////////////////////////////////////////////////
+// Writing
+//////////////////////////////////////////////////////////
+
+static void put3(float out[3], const Float4& f) {
+    out[0] = f.X();
+    out[1] = f.Y();
+    out[2] = f.Z();
+}
+
+static SceneFileName put_name(string_view name, string& names) {
+    SceneFileName result;
+    result.offset = (uint32_t)names.size();
+    result.length = (uint32_t)name.size();
+    names += name;
+    return result;
+}
+
+// Round up to the next 8 byte boundary
+static uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+bool write_scene_file(const string& filename) {
+    string names;
+
+    vector<SceneFileMaterial> materials(scene_materials.size() - 1);
+    for (int i = 1; i < scene_materials.size(); i++) {
+        const Material& m = scene_materials[i];
+        SceneFileMaterial& record = materials[i - 1];
+        memset(&record, 0, sizeof(record));
+        record.name = put_name(m.name, names);
+        record.surface_type = m.surface_type;
+        record.shininess = m.n;
+        put3(record.ka, m.ka);
+        put3(record.kd, m.kd);
+        put3(record.ks, m.ks);
+        put3(record.tau, m.tau);
+        put3(record.rho, m.rho);
+        put3(record.color, m.color);
+        // Only specular materials set these.
+        if (m.surface_type == SPECULAR) {
+            record.refraction_index = m.refraction_index;
+            record.is_translucent = m.is_translucent;
+            record.is_reflective = m.is_reflective;
+        }
+    }
+
+    vector<SceneFileLight> lights(scene_lights.size());
+    for (int i = 0; i < (int)scene_lights.size(); i++) {
+        Light& light = scene_lights[i];
+        lights[i].name = put_name(light.name, names);
+        put3(lights[i].position, light.getPos());
+        put3(lights[i].color, light.getColor());
+    }
+
+    vector<SceneFileSphere> spheres(scene_spheres.size());
+    for (int i = 0; i < (int)scene_spheres.size(); i++) {
+        Sphere& sphere = scene_spheres[i];
+        put3(spheres[i].center, sphere.center());
+        spheres[i].radius = sphere.radius();
+        spheres[i].material = sphere.material_id;
+    }
+
+    vector<SceneFileTriangle> triangles(scene_triangles.size());
+    for (int i = 0; i < (int)scene_triangles.size(); i++) {
+        Triangle& triangle = scene_triangles[i];
+        put3(triangles[i].v1, triangle.vertex());
+        put3(triangles[i].v2, triangle.vertex2());
+        put3(triangles[i].v3, triangle.vertex3());
+        triangles[i].material = triangle.material_id;
+    }
+
+    vector<SceneFileMesh> meshes(scene_meshes.size());
+    for (int i = 0; i < (int)scene_meshes.size(); i++) {
+        Mesh& mesh = scene_meshes[i];
+        memset(&meshes[i], 0, sizeof(SceneFileMesh));
+        meshes[i].name = put_name(mesh.name, names);
+        meshes[i].material = mesh.material_id;
+        meshes[i].n_vertices = (uint32_t)mesh.vertices();
+        meshes[i].n_triangles = (uint32_t)mesh.triangles();
+        meshes[i].has_normals = mesh.hasNormals();
+    }
+
+    vector<SceneFileObject> objects(scene_order.size());
+    for (int i = 0; i < (int)scene_order.size(); i++) {
+        objects[i].type = scene_order[i].type;
+        objects[i].index = scene_order[i].index;
+    }
+
+    vector<SceneFileGroup> groups(scene_groups.size());
+    vector<SceneFileObject> members;
+    for (int i = 0; i < (int)scene_groups.size(); i++) {
+        SceneGroup& group = scene_groups[i];
+        groups[i].name = put_name(group.name, names);
+        groups[i].first = (uint32_t)members.size();
+        groups[i].count = (uint32_t)group.members.size();
+        for (auto ref : group.members)
+            members.push_back({ref.type, ref.index});
+    }
+
+    vector<SceneFileInstance> instances(scene_instances.size());
+    for (int i = 0; i < (int)scene_instances.size(); i++) {
+        Instance& instance = scene_instances[i];
+        memset(&instances[i], 0, sizeof(SceneFileInstance));
+        instances[i].name = put_name(instance.name, names);
+        instances[i].group = instance.group();
+        for (int row = 0; row < 4; row++)
+            for (int col = 0; col < 4; col++)
+                instances[i].transform[row * 4 + col] = instance.transform()[row][col];
+    }
+
+    SceneFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.byte_order = SCENE_FILE_BYTE_ORDER;
+    put3(header.eye, eye_home);
+    put3(header.lookat, lookat_home);
+    put3(header.vup, vup_home);
+    for (int i = 0; i < 5; i++)
+        header.clip[i] = clip_home[i];
+
+    header.n_materials = (uint32_t)materials.size();
+    header.n_lights = (uint32_t)lights.size();
+    header.n_spheres = (uint32_t)spheres.size();
+    header.n_triangles = (uint32_t)triangles.size();
+    header.n_objects = (uint32_t)objects.size();
+    header.names_size = (uint32_t)names.size();
+    header.n_meshes = (uint32_t)meshes.size();
+    header.n_groups = (uint32_t)groups.size();
+    header.n_members = (uint32_t)members.size();
+    header.n_instances = (uint32_t)instances.size();
+    header.accelerator = (uint32_t)accel_type;
+
+    header.materials = align8(sizeof(header));
+    header.lights = align8(header.materials + materials.size() * sizeof(SceneFileMaterial));
+    header.spheres = align8(header.lights + lights.size() * sizeof(SceneFileLight));
+    header.triangles = align8(header.spheres + spheres.size() * sizeof(SceneFileSphere));
+    header.objects = align8(header.triangles + triangles.size() * sizeof(SceneFileTriangle));
+    header.names = align8(header.objects + objects.size() * sizeof(SceneFileObject));
+    header.meshes = align8(header.names + names.size());
+    header.groups = align8(header.meshes + meshes.size() * sizeof(SceneFileMesh));
+    header.members = align8(header.groups + groups.size() * sizeof(SceneFileGroup));
+    header.instances = align8(header.members + members.size() * sizeof(SceneFileObject));
+
+    uint64_t offset = header.instances + instances.size() * sizeof(SceneFileInstance);
+    for (auto& mesh : meshes) {
+        mesh.positions = align8(offset);
+        offset = mesh.positions + mesh.n_vertices * 3 * sizeof(float);
+        if (mesh.has_normals) {
+            mesh.normals = align8(offset);
+            offset = mesh.normals + mesh.n_vertices * 3 * sizeof(float);
+        }
+        mesh.indices = align8(offset);
+        offset = mesh.indices + mesh.n_triangles * 3 * sizeof(int32_t);
+    }
+
+    ofstream out(filename, ios::binary);
+    if (!out.is_open()) {
+        cerr << "Can't write to " << filename << endl;
+        return false;
+    }
+
+    // Write a section at its offset, padding up to it with zeros
+    auto section = [&](uint64_t offset, const void *data, size_t bytes) {
+        static const char zeros[8] = {0};
+        out.write(zeros, offset - (uint64_t)out.tellp());
+        out.write((const char *)data, bytes);
+    };
+    out.write((const char *)&header, sizeof(header));
+    section(header.materials, materials.data(), materials.size() * sizeof(SceneFileMaterial));
+    section(header.lights, lights.data(), lights.size() * sizeof(SceneFileLight));
+    section(header.spheres, spheres.data(), spheres.size() * sizeof(SceneFileSphere));
+    section(header.triangles, triangles.data(), triangles.size() * sizeof(SceneFileTriangle));
+    section(header.objects, objects.data(), objects.size() * sizeof(SceneFileObject));
+    section(header.names, names.data(), names.size());
+    section(header.meshes, meshes.data(), meshes.size() * sizeof(SceneFileMesh));
+    section(header.groups, groups.data(), groups.size() * sizeof(SceneFileGroup));
+    section(header.members, members.data(), members.size() * sizeof(SceneFileObject));
+    section(header.instances, instances.data(), instances.size() * sizeof(SceneFileInstance));
+    for (int i = 0; i < (int)meshes.size(); i++) {
+        Mesh& mesh = scene_meshes[i];
+        section(meshes[i].positions, mesh.positions.data(), mesh.positions.size() * sizeof(float));
+        if (meshes[i].has_normals)
+            section(meshes[i].normals, mesh.normals.data(), mesh.normals.size() * sizeof(float));
+        section(meshes[i].indices, mesh.indices.data(), mesh.indices.size() * sizeof(int32_t));
+    }
+
+    if (!out.good()) {
+        cerr << "Error writing " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////
+// Reading
+//////////////////////////////////////////////////////////
+
+static void bad_scene_file(const char *filename, const string& why) {
+    cerr << "Bad scene file " << filename << ": " << why << "\n";
+    exit(EXIT_FAILURE);
+}
+
+static Color get_color(const float c[3]) {
+    return Color(c[0], c[1], c[2]);
+}
+
+void load_scene_file(const char *filename) {
+    MappedFile file;
+    if (!file.open(filename)) {
+        cerr << "Can't read from " << filename << endl;
+        exit(EXIT_FAILURE);
+    }
+    const char *base = file.data();
+    size_t size = file.size();
+
+    if (size < sizeof(SceneFileHeader))
+        bad_scene_file(filename, "too short");
+    const SceneFileHeader& header = *(const SceneFileHeader *)base;
+    if (memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0)
+        bad_scene_file(filename, "not a compiled scene");
+    if (header.byte_order != SCENE_FILE_BYTE_ORDER)
+        bad_scene_file(filename, "written on a machine with the other byte order");
+    if (header.version != SCENE_FILE_VERSION)
+        bad_scene_file(filename, "version " + to_string(header.version) +
+                       ", expected " + to_string(SCENE_FILE_VERSION) + ": compile it again");
+
+    // Find an array, and check that it's inside the file
+    auto section = [&](uint64_t offset, uint64_t count, size_t record, const char *what) {
+        if (offset % 8 != 0 || offset > size || count > (size - offset) / record)
+            bad_scene_file(filename, string(what) + " run past the end of the file");
+        return base + offset;
+    };
+    auto materials = (const SceneFileMaterial *)section(header.materials, header.n_materials,
+                                                        sizeof(SceneFileMaterial), "materials");
+    auto lights = (const SceneFileLight *)section(header.lights, header.n_lights,
+                                                  sizeof(SceneFileLight), "lights");
+    auto spheres = (const SceneFileSphere *)section(header.spheres, header.n_spheres,
+                                                    sizeof(SceneFileSphere), "spheres");
+    auto triangles = (const SceneFileTriangle *)section(header.triangles, header.n_triangles,
+                                                        sizeof(SceneFileTriangle), "triangles");
+    auto objects = (const SceneFileObject *)section(header.objects, header.n_objects,
+                                                    sizeof(SceneFileObject), "objects");
+    const char *names = section(header.names, header.names_size, 1, "names");
+    auto meshes = (const SceneFileMesh *)section(header.meshes, header.n_meshes,
+                                                 sizeof(SceneFileMesh), "meshes");
+    auto groups = (const SceneFileGroup *)section(header.groups, header.n_groups,
+                                                  sizeof(SceneFileGroup), "groups");
+    auto members = (const SceneFileObject *)section(header.members, header.n_members,
+                                                    sizeof(SceneFileObject), "group members");
+    auto instances = (const SceneFileInstance *)section(header.instances, header.n_instances,
+                                                        sizeof(SceneFileInstance), "instances");
+
+    auto get_name = [&](const SceneFileName& name) {
+        if (name.offset > header.names_size || name.length > header.names_size - name.offset)
+            bad_scene_file(filename, "a name runs past the end of the file");
+        return scene_names.add(string_view(names + name.offset, name.length));
+    };
+
+    eye = eye_home = Point4(header.eye[0], header.eye[1], header.eye[2]);
+    lookat = lookat_home = Point4(header.lookat[0], header.lookat[1], header.lookat[2]);
+    vup = vup_home = Vector4(header.vup[0], header.vup[1], header.vup[2]);
+    for (int i = 0; i < 5; i++)
+        clip_home[i] = header.clip[i];
+    clipL = clip_home[0];
+    clipR = clip_home[1];
+    clipB = clip_home[2];
+    clipT = clip_home[3];
+    clipN = clip_home[4];
+
+    if (header.accelerator > ACCEL_KDTREE)
+        bad_scene_file(filename, "unknown accelerator " + to_string(header.accelerator));
+    if (!accel_fixed)
+        accel_type = (AcceleratorType)header.accelerator;
+
+    // Objects' material indices count from the file's first
+    // material; entry 0, the default, is shared.
+    int material_base = scene_materials.size() - 1;
+    for (uint32_t i = 0; i < header.n_materials; i++) {
+        const SceneFileMaterial& record = materials[i];
+        if (record.surface_type != PHONG && record.surface_type != SPECULAR)
+            bad_scene_file(filename, "unknown material type " + to_string(record.surface_type));
+        Material m;
+        m.name = get_name(record.name);
+        m.surface_type = (SurfaceType)record.surface_type;
+        m.ka = get_color(record.ka);
+        m.kd = get_color(record.kd);
+        m.ks = get_color(record.ks);
+        m.n = record.shininess;
+        m.tau = get_color(record.tau);
+        m.rho = get_color(record.rho);
+        m.color = get_color(record.color);
+        m.refraction_index = record.refraction_index;
+        m.is_translucent = record.is_translucent != 0;
+        m.is_reflective = record.is_reflective != 0;
+        scene_materials.add(m);
+    }
+    auto material_index = [&](int32_t m) {
+        if (m < 0 || m > (int32_t)header.n_materials)
+            bad_scene_file(filename, "bad material index " + to_string(m));
+        return m == 0 ? 0 : m + material_base;
+    };
+
+    scene_lights.reserve(scene_lights.size() + header.n_lights);
+    for (uint32_t i = 0; i < header.n_lights; i++) {
+        Color c = get_color(lights[i].color);
+        Point4 p(lights[i].position[0], lights[i].position[1], lights[i].position[2]);
+        Light light(c, p);
+        light.name = get_name(lights[i].name);
+        scene_lights.push_back(light);
+        ambient_light += c * ambient_fraction;
+    }
+
+    int sphere_base = (int)scene_spheres.size();
+    scene_spheres.reserve(sphere_base + header.n_spheres);
+    for (uint32_t i = 0; i < header.n_spheres; i++) {
+        const SceneFileSphere& record = spheres[i];
+        Point4 center(record.center[0], record.center[1], record.center[2]);
+        scene_spheres.push_back(Sphere(center, record.radius, material_index(record.material)));
+    }
+
+    int triangle_base = (int)scene_triangles.size();
+    scene_triangles.reserve(triangle_base + header.n_triangles);
+    for (uint32_t i = 0; i < header.n_triangles; i++) {
+        const SceneFileTriangle& record = triangles[i];
+        Point4 v1(record.v1[0], record.v1[1], record.v1[2]);
+        Point4 v2(record.v2[0], record.v2[1], record.v2[2]);
+        Point4 v3(record.v3[0], record.v3[1], record.v3[2]);
+        scene_triangles.push_back(Triangle(v1, v2, v3, material_index(record.material)));
+    }
+
+    int mesh_base = (int)scene_meshes.size();
+    scene_meshes.reserve(mesh_base + header.n_meshes);
+    for (uint32_t i = 0; i < header.n_meshes; i++) {
+        const SceneFileMesh& record = meshes[i];
+        uint64_t n_values = (uint64_t)record.n_vertices * 3;
+        auto positions = (const float *)section(record.positions, n_values, sizeof(float), "mesh vertices");
+        auto indices = (const int32_t *)section(record.indices, (uint64_t)record.n_triangles * 3,
+                                                sizeof(int32_t), "mesh triangles");
+
+        Mesh mesh(material_index(record.material));
+        mesh.name = get_name(record.name);
+        mesh.positions.assign(positions, positions + n_values);
+        if (record.has_normals) {
+            auto normals = (const float *)section(record.normals, n_values, sizeof(float), "mesh normals");
+            mesh.normals.assign(normals, normals + n_values);
+        }
+        mesh.indices.assign(indices, indices + (uint64_t)record.n_triangles * 3);
+        for (int v : mesh.indices) {
+            if (v < 0 || v >= (int)record.n_vertices)
+                bad_scene_file(filename, "mesh \"" + string(mesh.name) + "\" has a bad vertex index");
+        }
+        scene_meshes.push_back(move(mesh));
+    }
+
+    int group_base = (int)scene_groups.size();
+    int instance_base = (int)scene_instances.size();
+    scene_instances.reserve(instance_base + header.n_instances);
+    for (uint32_t i = 0; i < header.n_instances; i++) {
+        const SceneFileInstance& record = instances[i];
+        if (record.group < 0 || (uint32_t)record.group >= header.n_groups)
+            bad_scene_file(filename, "instance " + to_string(i) + " has a bad group");
+        Matrix4 M;
+        for (int row = 0; row < 4; row++)
+            for (int col = 0; col < 4; col++)
+                M[row][col] = record.transform[row * 4 + col];
+        Instance instance(record.group + group_base, M);
+        instance.name = get_name(record.name);
+        scene_instances.push_back(instance);
+    }
+
+    // An object, checked and moved past what was already loaded.
+    // "group" is the group it's in (-1 for none): it may only
+    // be an instance of an earlier group.
+    auto get_object = [&](const SceneFileObject& record, int group, const string& what) {
+        ObjectRef ref;
+        ref.type = (ObjectType)record.type;
+        ref.index = record.index;
+        uint32_t count = (ref.type == SPHERE) ? header.n_spheres :
+                         (ref.type == TRIANGLE) ? header.n_triangles :
+                         (ref.type == MESH) ? header.n_meshes :
+                         (ref.type == INSTANCE) ? header.n_instances : 0;
+        if (ref.index < 0 || (uint32_t)ref.index >= count)
+            bad_scene_file(filename, "bad " + what);
+        if (ref.type == INSTANCE && group >= 0 && instances[ref.index].group >= group)
+            bad_scene_file(filename, what + " is an instance of a later group");
+        ref.index += (ref.type == SPHERE) ? sphere_base :
+                     (ref.type == TRIANGLE) ? triangle_base :
+                     (ref.type == MESH) ? mesh_base : instance_base;
+        return ref;
+    };
+
+    scene_groups.reserve(group_base + header.n_groups);
+    for (uint32_t i = 0; i < header.n_groups; i++) {
+        const SceneFileGroup& record = groups[i];
+        if (record.first > header.n_members || record.count > header.n_members - record.first)
+            bad_scene_file(filename, "group " + to_string(i) + " has bad members");
+        SceneGroup group;
+        group.name = get_name(record.name);
+        for (uint32_t m = 0; m < record.count; m++)
+            group.members.push_back(get_object(members[record.first + m], (int)i,
+                                               "member " + to_string(m) + " of group " + to_string(i)));
+        scene_groups.push_back(move(group));
+    }
+
+    scene_order.reserve(scene_order.size() + header.n_objects);
+    for (uint32_t i = 0; i < header.n_objects; i++)
+        scene_order.push_back(get_object(objects[i], -1, "object " + to_string(i)));
+}
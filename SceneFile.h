@@ -0,0 +1,163 @@
+#if !defined(_SCENEFILE_H_)
+
+#define _SCENEFILE_H_
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// The compiled scene format (".rtscene"), written by the
+// scenec tool and read by read_scene() in place of the
+// text format.
+//
+// It is the parsed scene, laid out as fixed-size records:
+// a header, then one array per record type, then the
+// names, then the meshes' buffers.  Every array starts on
+// an 8 byte boundary.  The file is mapped, and the scene's
+// objects are built once straight from the records, with
+// no parsing; the mapping isn't kept after that.  Numbers
+// are in the writer's byte order; the header says which
+// that was.
+//
+// Bump SCENE_FILE_VERSION whenever a record changes.
+//
+//////////////////////////////////////////////////////////
+
+const char SCENE_FILE_MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+const uint32_t SCENE_FILE_VERSION = 3;
+const uint32_t SCENE_FILE_BYTE_ORDER = 0x01020304;
+
+struct SceneFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+
+    // The camera's home position and frustum
+    float eye[3];
+    float lookat[3];
+    float vup[3];
+    float clip[5];
+
+    uint32_t n_materials;
+    uint32_t n_lights;
+    uint32_t n_spheres;
+    uint32_t n_triangles;
+    uint32_t n_objects;
+    uint32_t names_size;
+    uint32_t n_meshes;
+    uint32_t n_groups;
+    uint32_t n_members;   // of all the groups
+    uint32_t n_instances;
+    uint32_t accelerator; // an AcceleratorType (0: the BVH)
+    uint32_t reserved;
+
+    // Where each array starts, in bytes from the start of the file
+    uint64_t materials;
+    uint64_t lights;
+    uint64_t spheres;
+    uint64_t triangles;
+    uint64_t objects;
+    uint64_t names;
+    uint64_t meshes;
+    uint64_t groups;
+    uint64_t members;
+    uint64_t instances;
+};
+
+// A name: "length" bytes, at "offset" in the names
+struct SceneFileName {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// The scene's materials, after the default (entry 0)
+struct SceneFileMaterial {
+    SceneFileName name;
+    int32_t surface_type;
+    int32_t shininess;
+    float ka[3], kd[3], ks[3];
+    float tau[3], rho[3], color[3];
+    float refraction_index;
+    uint8_t is_translucent;
+    uint8_t is_reflective;
+    uint8_t pad[2];
+};
+
+struct SceneFileLight {
+    SceneFileName name;
+    float position[3];
+    float color[3];
+};
+
+struct SceneFileSphere {
+    float center[3];
+    float radius;
+    int32_t material; // index in the material table
+};
+
+struct SceneFileTriangle {
+    float v1[3], v2[3], v3[3];
+    int32_t material;
+};
+
+// A mesh, and where its buffers are in the file
+struct SceneFileMesh {
+    SceneFileName name;
+    int32_t material;
+    uint32_t n_vertices;
+    uint32_t n_triangles;
+    uint32_t has_normals;
+    uint64_t positions; // x, y, z of each vertex
+    uint64_t normals;   // x, y, z of each vertex, if has_normals
+    uint64_t indices;   // three int32 per triangle
+};
+
+// The objects, in the order they were read (which the BVH
+// build depends on): type is an ObjectType, and index is
+// where in its array.  Groups' members are objects too.
+struct SceneFileObject {
+    int32_t type;
+    int32_t index;
+};
+
+// A group's members are "count" objects, from "first" in
+// the members array.
+struct SceneFileGroup {
+    SceneFileName name;
+    uint32_t first;
+    uint32_t count;
+};
+
+struct SceneFileInstance {
+    SceneFileName name;
+    int32_t group;
+    uint32_t pad;
+    float transform[16]; // group to scene, by rows
+};
+
+static_assert(sizeof(SceneFileHeader) == 200, "SceneFileHeader layout changed");
+static_assert(sizeof(SceneFileMaterial) == 96, "SceneFileMaterial layout changed");
+static_assert(sizeof(SceneFileLight) == 32, "SceneFileLight layout changed");
+static_assert(sizeof(SceneFileSphere) == 20, "SceneFileSphere layout changed");
+static_assert(sizeof(SceneFileTriangle) == 40, "SceneFileTriangle layout changed");
+static_assert(sizeof(SceneFileMesh) == 48, "SceneFileMesh layout changed");
+static_assert(sizeof(SceneFileObject) == 8, "SceneFileObject layout changed");
+static_assert(sizeof(SceneFileGroup) == 16, "SceneFileGroup layout changed");
+static_assert(sizeof(SceneFileInstance) == 80, "SceneFileInstance layout changed");
+
+// True if the file starts with SCENE_FILE_MAGIC
+bool is_scene_file(const char *filename);
+
+// Write the current scene.  False (after saying why) if
+// the file can't be written.
+bool write_scene_file(const string& filename);
+
+// Read a compiled scene into the scene globals, the way
+// read_scene() reads a text one: the caller links the
+// objects and builds the BVH.  Exits on a bad file.
+void load_scene_file(const char *filename);
+
+#endif
@@ -0,0 +1,52 @@
+#include "Simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#endif
+
+// Indexed by SimdLevel
+static const char* level_names[] = {"scalar", "sse", "avx2", "avx512"};
+static const int level_widths[] = {1, 4, 8, 16};
+
+static SimdLevel current_level = SIMD_SCALAR;
+
+// Pick the best level before main() runs
+static struct SimdInit {
+    SimdInit() {set_simd("auto");}
+} simd_init;
+
+static bool supported(SimdLevel level) {
+#if defined(SIMD_X86)
+    __builtin_cpu_init();
+    switch (level) {
+    case SIMD_AVX512: return __builtin_cpu_supports("avx512f");
+    case SIMD_AVX2:   return __builtin_cpu_supports("avx2");
+    case SIMD_SSE:    return __builtin_cpu_supports("sse2");
+    default:          return true;
+    }
+#else
+    return level == SIMD_SCALAR;
+#endif
+}
+
+bool set_simd(const string& name) {
+    for (int level = SIMD_AVX512; level >= SIMD_SCALAR; level--) {
+        if ((name == "auto" || name == level_names[level]) && supported((SimdLevel)level)) {
+            current_level = (SimdLevel)level;
+            return true;
+        }
+    }
+    return false;
+}
+
+SimdLevel simd_level() {
+    return current_level;
+}
+
+string simd_name() {
+    return level_names[current_level];
+}
+
+int simd_width() {
+    return level_widths[current_level];
+}
@@ -0,0 +1,32 @@
+#if !defined(_SIMD_H_)
+
+#define _SIMD_H_
+
+#include <string>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Which vector instructions the intersection kernels
+// (SphereSet, TriangleSet) use.  The widest one the CPU
+// supports is picked before main() runs; --simd overrides it.
+//
+//////////////////////////////////////////////////////////
+
+enum SimdLevel {SIMD_SCALAR, SIMD_SSE, SIMD_AVX2, SIMD_AVX512};
+
+//
+// "scalar", "sse", "avx2", "avx512", or "auto" for the best
+// one this CPU supports.  Returns false if the CPU (or the
+// compiler) can't run the one asked for.
+//
+bool set_simd(const string& name);
+
+SimdLevel simd_level();
+string simd_name();
+
+// How many objects a kernel tests at once: 1, 4, 8 or 16
+int simd_width();
+
+#endif
@@ -6,26 +6,25 @@
 using namespace std;
 extern bool debugOn;
 
-Sphere::Sphere(Point4& center, float radius, Material& color) : Object(color) {
+Sphere::Sphere(Point4& center, float radius, int material_id) : Object(SPHERE, material_id) {
     c = center;
     r = radius;
     name = "unnamed";
 }
 
-bool Sphere::intersects(Ray4& ray, Hit& hit) {
+bool Sphere::intersects(Ray4& ray, float t_max, Hit& hit) {
     float as = ray.direction * ray.direction;
     float bs = 2 * ray.direction * (ray.start - c);
     float cs = (ray.start - c)*(ray.start - c) - (r*r);
 
     float ds = bs*bs - 4*as*cs;
     float t_sphere = -1;
-    Point4 P_sphere;
-    Vector4 N;
 
     if (ds > EPSILON) {
         // Two real roots
-        float t1 = (-bs - sqrt(ds)) / (2 * as);
-        float t2 = (-bs + sqrt(ds)) / (2 * as);
+        float root = sqrt(ds);
+        float t1 = (-bs - root) / (2 * as);
+        float t2 = (-bs + root) / (2 * as);
 
         if (t1 > EPSILON) {
             t_sphere = t1;
@@ -36,18 +35,55 @@ bool Sphere::intersects(Ray4& ray, Hit& hit) {
         else {
             return false;
         }
-        P_sphere = ray.start + t_sphere * ray.direction;
-        N = (P_sphere - c).normalized();
 
-        hit.p = P_sphere;
-        hit.N = N;
-        hit.obj = this;
-        hit.dist = ray.start.distanceTo(P_sphere);
+        // Something nearer was already hit: don't bother with the
+        // hit point and normal.
+        if (t_sphere >= t_max) {
+            return false;
+        }
+
+        setHit(ray, t_sphere, hit);
         return true;
     }
     return false;
 }
 
+void Sphere::setHit(Ray4& ray, float t, Hit& hit) {
+    hit.p = ray.start + t * ray.direction;
+    hit.N = (hit.p - c).normalized();
+    hit.obj = this;
+    hit.dist = t;
+}
+
+bool Sphere::occludes(Ray4& ray, float t_max) {
+    float as = ray.direction * ray.direction;
+    float bs = 2 * ray.direction * (ray.start - c);
+    float cs = (ray.start - c)*(ray.start - c) - (r*r);
+
+    float ds = bs*bs - 4*as*cs;
+    if (ds <= EPSILON) {
+        return false;
+    }
+
+    float root = sqrt(ds);
+    float t1 = (-bs - root) / (2 * as);
+    float t2 = (-bs + root) / (2 * as);
+
+    // The nearest root in front of the ray
+    float t = (t1 > EPSILON) ? t1 : t2;
+    return EPSILON < t && t < t_max;
+}
+
+AABB Sphere::bounds() {
+    return AABB(Point4(c.X() - r, c.Y() - r, c.Z() - r),
+                Point4(c.X() + r, c.Y() + r, c.Z() + r));
+}
+
+void Sphere::transform(const Matrix4& M) {
+    c = M * c;
+    r *= cbrtf(fabsf(M.determinant()));
+}
+
 ostream& operator<<(ostream& os, const Sphere& sphere) {
     os << "Sphere \"" << sphere.name << "\" center " << sphere.c
        << " radius " << sphere.r;
@@ -7,10 +7,22 @@
 #include "Material.h"
 #include "Hit.h"
 
-class Sphere : public virtual Object {
+class Sphere final : public Object {
 public:
-    Sphere(Point4& center, float radius, Material& color);
-    bool intersects(Ray4& ray, Hit& hit);
+    Sphere(Point4& center, float radius, int material_id);
+    bool intersects(Ray4& ray, float t_max, Hit& hit);
+    bool occludes(Ray4& ray, float t_max);
+    AABB bounds();
+
+    // Move the center by M; the radius is scaled by the cube
+    // root of M's change in volume (a sphere stays a sphere).
+    void transform(const Matrix4& M);
+
+    // Fill in "hit" for the point at t along the ray
+    void setHit(Ray4& ray, float t, Hit& hit);
+
+    Point4& center() {return c;};
+    float radius() {return r;};
 
     friend ostream& operator<<(ostream& os, const Sphere& sphere);
 
@@ -0,0 +1,392 @@
+#include "SphereSet.h"
+
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPHERESET_X86 1
+#include <immintrin.h>
+#endif
+
+static const float EPS = (float)EPSILON;
+
+SphereRay::SphereRay(const Ray4& ray) {
+    sx = ray.start.X();
+    sy = ray.start.Y();
+    sz = ray.start.Z();
+    dx = ray.direction.X();
+    dy = ray.direction.Y();
+    dz = ray.direction.Z();
+    a = dx*dx + dy*dy + dz*dz;
+    inv_a = 1.0f / a;
+}
+
+//////////////////////////////////////////////////////////
+// The kernels.
+//
+// For each sphere, with O = start - center, solve
+//     a t^2 + 2 b t + c = 0
+// where a = D.D, b = D.O, c = O.O - r^2.  Take the nearer
+// root beyond EPSILON, else the farther one.  If any_hit is
+// set, return the first sphere hit rather than the nearest.
+//////////////////////////////////////////////////////////
+
+typedef int (*SphereKernel)(const SphereSet& s, const SphereRay& ray,
+                            int first, int count, float& t_max, bool any_hit);
+
+// One ray against sphere i: is it hit at EPSILON < t < t_max?
+static inline bool hit_sphere(const SphereSet& s, int i,
+                              float sx, float sy, float sz,
+                              float dx, float dy, float dz,
+                              float a, float inv_a, float t_max, float& t) {
+    float ox = sx - s.cx[i];
+    float oy = sy - s.cy[i];
+    float oz = sz - s.cz[i];
+    float b = dx*ox + dy*oy + dz*oz;
+    float c = ox*ox + oy*oy + oz*oz - s.r2[i];
+    float disc = b*b - a*c;
+    if (!(4*disc > EPS))
+        return false;
+
+    float root = sqrtf(disc);
+    float t1 = (-b - root) * inv_a;
+    float t2 = (-b + root) * inv_a;
+    t = (t1 > EPS) ? t1 : t2;
+    return t > EPS && t < t_max;
+}
+
+static int kernel_scalar(const SphereSet& s, const SphereRay& ray,
+                         int first, int count, float& t_max, bool any_hit) {
+    int best = -1;
+    for (int i = first; i < first + count; i++) {
+        float t;
+        if (hit_sphere(s, i, ray.sx, ray.sy, ray.sz, ray.dx, ray.dy, ray.dz,
+                       ray.a, ray.inv_a, t_max, t)) {
+            t_max = t;
+            best = i;
+            if (any_hit)
+                return best;
+        }
+    }
+    return best;
+}
+
+#if defined(SPHERESET_X86)
+
+// Lanes (of "width") that are inside the range, as a bit mask
+static inline unsigned tail_mask(int remaining, int width) {
+    return remaining >= width ? (1u << width) - 1 : (1u << remaining) - 1;
+}
+
+__attribute__((target("sse2")))
+static int kernel_sse(const SphereSet& s, const SphereRay& ray,
+                      int first, int count, float& t_max, bool any_hit) {
+    const __m128 eps  = _mm_set1_ps(EPS);
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 sx = _mm_set1_ps(ray.sx), sy = _mm_set1_ps(ray.sy), sz = _mm_set1_ps(ray.sz);
+    const __m128 dx = _mm_set1_ps(ray.dx), dy = _mm_set1_ps(ray.dy), dz = _mm_set1_ps(ray.dz);
+    const __m128 a = _mm_set1_ps(ray.a), inv_a = _mm_set1_ps(ray.inv_a);
+    __m128 t_far = _mm_set1_ps(t_max);
+
+    int best = -1;
+    int end = first + count;
+    for (int i = first; i < end; i += 4) {
+        __m128 ox = _mm_sub_ps(sx, _mm_loadu_ps(&s.cx[i]));
+        __m128 oy = _mm_sub_ps(sy, _mm_loadu_ps(&s.cy[i]));
+        __m128 oz = _mm_sub_ps(sz, _mm_loadu_ps(&s.cz[i]));
+        __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ox), _mm_mul_ps(dy, oy)), _mm_mul_ps(dz, oz));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)),
+                              _mm_loadu_ps(&s.r2[i]));
+        __m128 disc = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+        __m128 valid = _mm_cmpgt_ps(_mm_mul_ps(four, disc), eps);
+
+        __m128 root = _mm_sqrt_ps(disc);
+        __m128 neg_b = _mm_xor_ps(b, sign);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(neg_b, root), inv_a);
+        __m128 t2 = _mm_mul_ps(_mm_add_ps(neg_b, root), inv_a);
+        __m128 use_t1 = _mm_cmpgt_ps(t1, eps);
+        __m128 t = _mm_or_ps(_mm_and_ps(use_t1, t1), _mm_andnot_ps(use_t1, t2));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, eps), _mm_cmplt_ps(t, t_far)));
+
+        unsigned mask = _mm_movemask_ps(valid) & tail_mask(end - i, 4);
+        if (mask) {
+            if (any_hit)
+                return i + __builtin_ctz(mask);
+            float ts[4];
+            _mm_storeu_ps(ts, t);
+            for (int j = 0; j < 4; j++) {
+                if ((mask >> j & 1) && ts[j] < t_max) {
+                    t_max = ts[j];
+                    best = i + j;
+                }
+            }
+            t_far = _mm_set1_ps(t_max);
+        }
+    }
+    return best;
+}
+
+__attribute__((target("avx2")))
+static int kernel_avx2(const SphereSet& s, const SphereRay& ray,
+                       int first, int count, float& t_max, bool any_hit) {
+    const __m256 eps  = _mm256_set1_ps(EPS);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 sx = _mm256_set1_ps(ray.sx), sy = _mm256_set1_ps(ray.sy), sz = _mm256_set1_ps(ray.sz);
+    const __m256 dx = _mm256_set1_ps(ray.dx), dy = _mm256_set1_ps(ray.dy), dz = _mm256_set1_ps(ray.dz);
+    const __m256 a = _mm256_set1_ps(ray.a), inv_a = _mm256_set1_ps(ray.inv_a);
+    __m256 t_far = _mm256_set1_ps(t_max);
+
+    int best = -1;
+    int end = first + count;
+    for (int i = first; i < end; i += 8) {
+        __m256 ox = _mm256_sub_ps(sx, _mm256_loadu_ps(&s.cx[i]));
+        __m256 oy = _mm256_sub_ps(sy, _mm256_loadu_ps(&s.cy[i]));
+        __m256 oz = _mm256_sub_ps(sz, _mm256_loadu_ps(&s.cz[i]));
+        __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ox), _mm256_mul_ps(dy, oy)),
+                                 _mm256_mul_ps(dz, oz));
+        __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)),
+                                               _mm256_mul_ps(oz, oz)),
+                                 _mm256_loadu_ps(&s.r2[i]));
+        __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+        __m256 valid = _mm256_cmp_ps(_mm256_mul_ps(four, disc), eps, _CMP_GT_OQ);
+
+        __m256 root = _mm256_sqrt_ps(disc);
+        __m256 neg_b = _mm256_xor_ps(b, sign);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(neg_b, root), inv_a);
+        __m256 t2 = _mm256_mul_ps(_mm256_add_ps(neg_b, root), inv_a);
+        __m256 t = _mm256_blendv_ps(t2, t1, _mm256_cmp_ps(t1, eps, _CMP_GT_OQ));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, eps, _CMP_GT_OQ),
+                                                   _mm256_cmp_ps(t, t_far, _CMP_LT_OQ)));
+
+        unsigned mask = _mm256_movemask_ps(valid) & tail_mask(end - i, 8);
+        if (mask) {
+            if (any_hit)
+                return i + __builtin_ctz(mask);
+            float ts[8];
+            _mm256_storeu_ps(ts, t);
+            for (int j = 0; j < 8; j++) {
+                if ((mask >> j & 1) && ts[j] < t_max) {
+                    t_max = ts[j];
+                    best = i + j;
+                }
+            }
+            t_far = _mm256_set1_ps(t_max);
+        }
+    }
+    return best;
+}
+
+// AVX-512 implies FMA; don't let the compiler fuse the multiplies
+// and adds, or its hits would differ (slightly) from the others'.
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static int kernel_avx512(const SphereSet& s, const SphereRay& ray,
+                         int first, int count, float& t_max, bool any_hit) {
+    const __m512 eps  = _mm512_set1_ps(EPS);
+    const __m512 four = _mm512_set1_ps(4.0f);
+    const __m512 sx = _mm512_set1_ps(ray.sx), sy = _mm512_set1_ps(ray.sy), sz = _mm512_set1_ps(ray.sz);
+    const __m512 dx = _mm512_set1_ps(ray.dx), dy = _mm512_set1_ps(ray.dy), dz = _mm512_set1_ps(ray.dz);
+    const __m512 a = _mm512_set1_ps(ray.a), inv_a = _mm512_set1_ps(ray.inv_a);
+    const __m512 zero = _mm512_setzero_ps();
+    __m512 t_far = _mm512_set1_ps(t_max);
+
+    int best = -1;
+    int end = first + count;
+    for (int i = first; i < end; i += 16) {
+        __m512 ox = _mm512_sub_ps(sx, _mm512_loadu_ps(&s.cx[i]));
+        __m512 oy = _mm512_sub_ps(sy, _mm512_loadu_ps(&s.cy[i]));
+        __m512 oz = _mm512_sub_ps(sz, _mm512_loadu_ps(&s.cz[i]));
+        __m512 b = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, ox), _mm512_mul_ps(dy, oy)),
+                                 _mm512_mul_ps(dz, oz));
+        __m512 c = _mm512_sub_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(ox, ox), _mm512_mul_ps(oy, oy)),
+                                               _mm512_mul_ps(oz, oz)),
+                                 _mm512_loadu_ps(&s.r2[i]));
+        __m512 disc = _mm512_sub_ps(_mm512_mul_ps(b, b), _mm512_mul_ps(a, c));
+        __mmask16 valid = _mm512_cmp_ps_mask(_mm512_mul_ps(four, disc), eps, _CMP_GT_OQ)
+                        & (__mmask16)tail_mask(end - i, 16);
+
+        __m512 root = _mm512_maskz_sqrt_ps(valid, disc);
+        __m512 neg_b = _mm512_sub_ps(zero, b);
+        __m512 t1 = _mm512_mul_ps(_mm512_sub_ps(neg_b, root), inv_a);
+        __m512 t2 = _mm512_mul_ps(_mm512_add_ps(neg_b, root), inv_a);
+        __m512 t = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(t1, eps, _CMP_GT_OQ), t2, t1);
+        valid &= _mm512_cmp_ps_mask(t, eps, _CMP_GT_OQ) & _mm512_cmp_ps_mask(t, t_far, _CMP_LT_OQ);
+
+        unsigned mask = valid;
+        if (mask) {
+            if (any_hit)
+                return i + __builtin_ctz(mask);
+            float ts[16];
+            _mm512_storeu_ps(ts, t);
+            for (int j = 0; j < 16; j++) {
+                if ((mask >> j & 1) && ts[j] < t_max) {
+                    t_max = ts[j];
+                    best = i + j;
+                }
+            }
+            t_far = _mm512_set1_ps(t_max);
+        }
+    }
+    return best;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////
+// Packet kernels: one sphere at a time, against 8 rays at
+// a time.  Each ray's t comes out exactly as it would from
+// the kernels above.
+//////////////////////////////////////////////////////////
+
+static void packet_scalar(const SphereSet& s, RayPacket& p,
+                          int first, int count, uint64_t rays) {
+    for (int i = first; i < first + count; i++) {
+        for (uint64_t m = rays; m; m &= m - 1) {
+            int j = __builtin_ctzll(m);
+            float t;
+            if (hit_sphere(s, i, p.sx[j], p.sy[j], p.sz[j], p.dx[j], p.dy[j], p.dz[j],
+                           p.a[j], p.inv_a[j], p.t[j], t)) {
+                p.t[j] = t;
+                p.sphere[j] = i;
+                p.triangle[j] = -1;
+            }
+        }
+    }
+}
+
+#if defined(SPHERESET_X86)
+
+__attribute__((target("avx2")))
+static void packet_avx2(const SphereSet& s, RayPacket& p,
+                        int first, int count, uint64_t rays) {
+    const __m256 eps  = _mm256_set1_ps(EPS);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256i no_triangle = _mm256_set1_epi32(-1);
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+    for (int j = 0; j < RayPacket::MAX_RAYS; j += 8) {
+        unsigned lanes = (unsigned)(rays >> j) & 0xff;
+        if (!lanes)
+            continue;
+
+        // The rays of these 8 that are in the mask, as a vector mask
+        __m256i bits = _mm256_and_si256(_mm256_set1_epi32(lanes), lane_bits);
+        const __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, lane_bits));
+
+        __m256 sx = _mm256_load_ps(&p.sx[j]), sy = _mm256_load_ps(&p.sy[j]), sz = _mm256_load_ps(&p.sz[j]);
+        __m256 dx = _mm256_load_ps(&p.dx[j]), dy = _mm256_load_ps(&p.dy[j]), dz = _mm256_load_ps(&p.dz[j]);
+        __m256 a = _mm256_load_ps(&p.a[j]), inv_a = _mm256_load_ps(&p.inv_a[j]);
+        __m256 t_far = _mm256_load_ps(&p.t[j]);
+        __m256 best = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)&p.sphere[j]));
+        __m256 hit_any = _mm256_setzero_ps();
+
+        for (int i = first; i < first + count; i++) {
+            __m256 ox = _mm256_sub_ps(sx, _mm256_set1_ps(s.cx[i]));
+            __m256 oy = _mm256_sub_ps(sy, _mm256_set1_ps(s.cy[i]));
+            __m256 oz = _mm256_sub_ps(sz, _mm256_set1_ps(s.cz[i]));
+            __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ox), _mm256_mul_ps(dy, oy)),
+                                     _mm256_mul_ps(dz, oz));
+            __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)),
+                                                   _mm256_mul_ps(oz, oz)),
+                                     _mm256_set1_ps(s.r2[i]));
+            __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(a, c));
+            __m256 valid = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_mul_ps(four, disc), eps, _CMP_GT_OQ));
+            if (_mm256_testz_ps(valid, valid))
+                continue;
+
+            __m256 root = _mm256_sqrt_ps(disc);
+            __m256 neg_b = _mm256_xor_ps(b, sign);
+            __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(neg_b, root), inv_a);
+            __m256 t2 = _mm256_mul_ps(_mm256_add_ps(neg_b, root), inv_a);
+            __m256 t = _mm256_blendv_ps(t2, t1, _mm256_cmp_ps(t1, eps, _CMP_GT_OQ));
+            valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, eps, _CMP_GT_OQ),
+                                                       _mm256_cmp_ps(t, t_far, _CMP_LT_OQ)));
+
+            t_far = _mm256_blendv_ps(t_far, t, valid);
+            best = _mm256_blendv_ps(best, _mm256_castsi256_ps(_mm256_set1_epi32(i)), valid);
+            hit_any = _mm256_or_ps(hit_any, valid);
+        }
+
+        _mm256_store_ps(&p.t[j], t_far);
+        _mm256_storeu_si256((__m256i*)&p.sphere[j], _mm256_castps_si256(best));
+        __m256 triangle = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)&p.triangle[j]));
+        triangle = _mm256_blendv_ps(triangle, _mm256_castsi256_ps(no_triangle), hit_any);
+        _mm256_storeu_si256((__m256i*)&p.triangle[j], _mm256_castps_si256(triangle));
+    }
+}
+
+#endif
+
+// Indexed by SimdLevel
+#if defined(SPHERESET_X86)
+static const SphereKernel kernels[] = {kernel_scalar, kernel_sse, kernel_avx2, kernel_avx512};
+#else
+static const SphereKernel kernels[] = {kernel_scalar};
+#endif
+
+//////////////////////////////////////////////////////////
+// The set itself
+//////////////////////////////////////////////////////////
+
+SphereSet::SphereSet() {
+    clear();
+}
+
+void SphereSet::clear() {
+    objects.clear();
+    cx.assign(PADDING, 0);
+    cy.assign(PADDING, 0);
+    cz.assign(PADDING, 0);
+    r2.assign(PADDING, 0);
+}
+
+void SphereSet::reserve(int n) {
+    cx.reserve(n + PADDING);
+    cy.reserve(n + PADDING);
+    cz.reserve(n + PADDING);
+    r2.reserve(n + PADDING);
+    objects.reserve(n);
+}
+
+size_t SphereSet::bytes() const {
+    return (cx.capacity() + cy.capacity() + cz.capacity() + r2.capacity()) * sizeof(float)
+         + objects.capacity() * sizeof(Sphere*);
+}
+
+void SphereSet::add(Sphere* sphere) {
+    // Overwrite the first padding entry, and add a new one at the end
+    objects.push_back(sphere);
+    update((int)objects.size() - 1);
+    cx.push_back(0);
+    cy.push_back(0);
+    cz.push_back(0);
+    r2.push_back(0);
+}
+
+void SphereSet::update(int i) {
+    Sphere* sphere = objects[i];
+    cx[i] = sphere->center().X();
+    cy[i] = sphere->center().Y();
+    cz[i] = sphere->center().Z();
+    r2[i] = sphere->radius() * sphere->radius();
+}
+
+int SphereSet::nearest(const SphereRay& ray, int first, int count, float& t_max) const {
+    return kernels[simd_level()](*this, ray, first, count, t_max, false);
+}
+
+bool SphereSet::any(const SphereRay& ray, int first, int count, float t_max) const {
+    return kernels[simd_level()](*this, ray, first, count, t_max, true) >= 0;
+}
+
+// Packets are 8 rays wide at most, so AVX-512 uses the AVX2 kernel.
+void SphereSet::nearest(RayPacket& packet, int first, int count, uint64_t rays) const {
+#if defined(SPHERESET_X86)
+    if (simd_level() >= SIMD_AVX2) {
+        packet_avx2(*this, packet, first, count, rays);
+        return;
+    }
+#endif
+    packet_scalar(*this, packet, first, count, rays);
+}
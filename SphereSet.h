@@ -0,0 +1,80 @@
+#if !defined(_SPHERESET_H_)
+
+#define _SPHERESET_H_
+
+#include <vector>
+
+#include "GeomLib.h"
+#include "Sphere.h"
+#include "Simd.h"
+#include "RayPacket.h"
+
+//////////////////////////////////////////////////////////
+//
+// Spheres stored as a structure of arrays (all the center
+// X's together, then the Y's, ...), so one ray can be tested
+// against 4, 8 or 16 spheres at a time with SSE, AVX2 or
+// AVX-512, as chosen by simd_level().  There is a plain C++
+// kernel for everything else.
+//
+// Every kernel does the same float arithmetic in the same
+// order, so they all find exactly the same hits.
+//
+//////////////////////////////////////////////////////////
+
+// A ray, unpacked for the sphere kernels
+struct SphereRay {
+    SphereRay(const Ray4& ray);
+
+    float sx, sy, sz;  // start
+    float dx, dy, dz;  // direction
+    float a;           // direction . direction
+    float inv_a;       // 1 / a
+};
+
+class SphereSet {
+public:
+    SphereSet();
+
+    void clear();
+    // Make room for n spheres in all
+    void reserve(int n);
+    void add(Sphere* sphere);
+    int size() const {return (int)objects.size();};
+
+    // Memory held, in bytes
+    size_t bytes() const;
+    Sphere* object(int i) const {return objects[i];};
+
+    // Copy sphere i again, after it has moved
+    void update(int i);
+
+    //
+    // Find the nearest of spheres first .. first+count-1 hit at
+    // EPSILON < t < t_max.  If there is one, set t_max to its t
+    // and return its index; otherwise return -1.
+    //
+    int nearest(const SphereRay& ray, int first, int count, float& t_max) const;
+
+    // Is any of them hit at EPSILON < t < t_max?
+    bool any(const SphereRay& ray, int first, int count, float t_max) const;
+
+    //
+    // The same as nearest(), for each ray of the packet in the
+    // mask "rays": if it hits one of the spheres before its t,
+    // update its t and sphere (and clear its triangle).
+    //
+    void nearest(RayPacket& packet, int first, int count, uint64_t rays) const;
+
+    // The arrays are padded by this many unused entries, so the
+    // kernels can load a full vector starting at any sphere.
+    static const int PADDING = 16;
+
+    vector<float> cx, cy, cz; // centers
+    vector<float> r2;         // radius squared
+
+private:
+    vector<Sphere*> objects;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "StringArena.h"
+
+#include <algorithm>
+#include <cstring>
+
+StringArena::StringArena() {
+    used = room = total = 0;
+}
+
+string_view StringArena::add(string_view s) {
+    if (s.empty())
+        return string_view();
+
+    if (s.size() > room) {
+        size_t size = max(min(max(FIRST_BLOCK, total), MAX_BLOCK), s.size());
+        blocks.push_back(unique_ptr<char[]>(new char[size]));
+        used = 0;
+        room = size;
+        total += size;
+    }
+    char *copy = blocks.back().get() + used;
+    memcpy(copy, s.data(), s.size());
+    used += s.size();
+    room -= s.size();
+    return string_view(copy, s.size());
+}
+
+void StringArena::clear() {
+    blocks.clear();
+    blocks.shrink_to_fit();
+    used = room = total = 0;
+}
@@ -0,0 +1,46 @@
+#if !defined(_STRINGARENA_H_)
+
+#define _STRINGARENA_H_
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Storage for the scene's names.  Each is copied into a
+// large block and handed out as a string_view, and clear()
+// frees them all at once.  So the objects, lights and
+// materials that carry names need no destructors, and a
+// scene is freed with one free() per array, however many
+// objects it has.
+//
+//////////////////////////////////////////////////////////
+
+class StringArena {
+public:
+    StringArena();
+
+    // A copy of "s", which lives until clear()
+    string_view add(string_view s);
+
+    // Free every string
+    void clear();
+
+    // Bytes allocated
+    size_t bytes() const {return total;};
+
+private:
+    // Blocks start small, for small scenes, and double in size
+    static constexpr size_t FIRST_BLOCK = 1024;
+    static constexpr size_t MAX_BLOCK = 64 * 1024;
+
+    vector<unique_ptr<char[]>> blocks;
+    size_t used;  // of the last block
+    size_t room;  // left in the last block
+    size_t total;
+};
+
+#endif
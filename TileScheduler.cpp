@@ -0,0 +1,89 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+int TileScheduler::hardware_threads() {
+    int n = (int)thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+TileScheduler::TileScheduler(int width, int height, int tile_size, int n_workers)
+    : n_workers(n_workers > 0 ? n_workers : hardware_threads()),
+      queues(this->n_workers)
+{
+    if (tile_size < 1)
+        tile_size = 1;
+
+    int nx = (width  + tile_size - 1) / tile_size;
+    int ny = (height + tile_size - 1) / tile_size;
+
+    for (int ty = 0; ty < ny; ty++) {
+        for (int tx = 0; tx < nx; tx++) {
+            Tile tile;
+            tile.x0 = tx * tile_size;
+            tile.y0 = ty * tile_size;
+            tile.x1 = min(tile.x0 + tile_size, width);
+            tile.y1 = min(tile.y0 + tile_size, height);
+            all_tiles.push_back(tile);
+        }
+    }
+}
+
+// Take a tile from the front of our own queue
+bool TileScheduler::pop(int worker, Tile& tile) {
+    WorkQueue& q = queues[worker];
+    lock_guard<mutex> guard(q.lock);
+    if (q.tiles.empty())
+        return false;
+    tile = q.tiles.front();
+    q.tiles.pop_front();
+    return true;
+}
+
+// Take a tile from the back of somebody else's queue
+bool TileScheduler::steal(int thief, Tile& tile) {
+    for (int i = 1; i < n_workers; i++) {
+        WorkQueue& q = queues[(thief + i) % n_workers];
+        lock_guard<mutex> guard(q.lock);
+        if (!q.tiles.empty()) {
+            tile = q.tiles.back();
+            q.tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TileScheduler::work_loop(int worker, const function<void(const Tile&, int)>& work) {
+    Tile tile;
+    // Tiles are never added once run() starts, so when every
+    // queue is empty, we are done.
+    while (pop(worker, tile) || steal(worker, tile)) {
+        work(tile, worker);
+    }
+}
+
+void TileScheduler::run(const function<void(const Tile&, int)>& work) {
+    // Deal the tiles out in contiguous runs, so neighbouring tiles
+    // (which usually cost about the same) start on the same worker.
+    int n_tiles = (int)all_tiles.size();
+    for (int i = 0; i < n_tiles; i++) {
+        int owner = (int)((long)i * n_workers / n_tiles);
+        queues[owner].tiles.push_back(all_tiles[i]);
+    }
+
+    vector<thread> threads;
+    threads.reserve(n_workers - 1);
+
+    for (int w = 1; w < n_workers; w++) {
+        threads.push_back(thread(&TileScheduler::work_loop, this, w, cref(work)));
+    }
+
+    // The calling thread is worker 0.
+    work_loop(0, work);
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
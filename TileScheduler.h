@@ -0,0 +1,60 @@
+#if !defined(_TILESCHEDULER_H_)
+
+#define _TILESCHEDULER_H_
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Splits a W x H frame into square tiles, and renders them
+// on a pool of worker threads.
+//
+// Every worker owns a deque of tiles.  It takes work from
+// the front of its own deque; when that runs dry, it steals
+// from the back of another worker's deque.  So a few slow
+// tiles (lots of glass) don't leave the other cores idle.
+//
+//////////////////////////////////////////////////////////
+
+// A rectangle of pixels: x0 <= x < x1, y0 <= y < y1
+struct Tile {
+    int x0, y0;
+    int x1, y1;
+};
+
+class TileScheduler {
+public:
+    // n_workers <= 0 means one worker per hardware thread.
+    TileScheduler(int width, int height, int tile_size, int n_workers);
+
+    // Call work(tile, worker) once for every tile, spread over
+    // the workers.  Returns when all tiles are done.
+    void run(const function<void(const Tile&, int)>& work);
+
+    int workers() {return n_workers;};
+    int tiles() {return (int)all_tiles.size();};
+
+    // Number of hardware threads (at least 1)
+    static int hardware_threads();
+
+private:
+    struct WorkQueue {
+        mutex lock;
+        deque<Tile> tiles;
+    };
+
+    bool pop(int worker, Tile& tile);
+    bool steal(int thief, Tile& tile);
+    void work_loop(int worker, const function<void(const Tile&, int)>& work);
+
+    int n_workers;
+    vector<WorkQueue> queues;
+    vector<Tile> all_tiles;
+};
+
+#endif
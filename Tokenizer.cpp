@@ -1,17 +1,10 @@
 #include "Tokenizer.h"
 
-#include <sstream>
-#include <string>
-
-string downcase(const string &s) {
-    string result = "";
-    for (int i=0; i<(int)s.length(); i++) {
-        char c = s[i];
-        if ('A' <= c && c <= 'Z')
-            c = c - 'A' + 'a';
-        result += c;
-    }
-    return result;
+#include <charconv>
+#include <cstring>
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
 }
 
 // Tokenize a file, given its name
@@ -24,48 +17,110 @@ Tokenizer::Tokenizer(const string& filename) {
 }
 
 void Tokenizer::open(const string& filename) {
-    stream.open(filename);
-    if (!stream.is_open()) {
+    this->filename = filename;
+    if (!file.open(filename)) {
         cerr << "Can't read from " << filename << endl;
         exit(EXIT_FAILURE);
     }
+    pos = file.data();
+    end = pos + file.size();
+    line_start = pos;
+    line = 1;
+    token_line = 1;
+    token_column = 1;
 }
 
-// Return next token, as a string
-string Tokenizer::next_string() {
-    string token;
-    stream >> token;
-    return downcase(token);
+void Tokenizer::skip_space() {
+    while (pos < end && is_space(*pos)) {
+        if (*pos == '\n') {
+            line++;
+            line_start = pos + 1;
+        }
+        pos++;
+    }
 }
 
-void Tokenizer::match(const char *pattern) {
-    match(string(pattern));
+string_view Tokenizer::next_token() {
+    skip_space();
+    token_line = line;
+    token_column = (int)(pos - line_start) + 1;
+
+    const char *start = pos;
+    while (pos < end && !is_space(*pos))
+        pos++;
+    return string_view(start, pos - start);
 }
 
-void Tokenizer::match(const string& pattern) {
-    string token = next_string();
-    if (token != string(pattern)) {
-        cerr << "Expected \"" << pattern << "\", got \"" << token << "\"\n";
-        exit(EXIT_FAILURE);
+// Return next token, as a string
+string_view Tokenizer::next_string() {
+    string_view token = next_token();
+    for (size_t i = 0; i < token.size(); i++) {
+        if ('A' <= token[i] && token[i] <= 'Z') {
+            lowered.assign(token.data(), token.size());
+            for (size_t j = i; j < lowered.size(); j++) {
+                char c = lowered[j];
+                if ('A' <= c && c <= 'Z')
+                    lowered[j] = c - 'A' + 'a';
+            }
+            return lowered;
+        }
+    }
+    return token;
+}
+
+void Tokenizer::match(string_view pattern) {
+    string_view token = next_string();
+    if (token != pattern) {
+        error("expected \"" + string(pattern) + "\", got \"" + string(token) + "\"");
     }
 }
 
+bool parse_number(string_view token, float& number) {
+    if (token.empty())
+        return false;
+
+    const char *first = token.data();
+    const char *last = first + token.size();
+    if (*first == '+')
+        first++; // from_chars doesn't take a leading '+'
+
+#if defined(__cpp_lib_to_chars)
+    from_chars_result result = from_chars(first, last, number);
+    return result.ec == errc() && result.ptr == last;
+#else
+    // No from_chars for floats in this library: strtof needs a terminated copy
+    char copy[64];
+    size_t n = last - first;
+    if (n == 0 || n >= sizeof(copy))
+        return false;
+    memcpy(copy, first, n);
+    copy[n] = '\0';
+    char *stop;
+    number = strtof(copy, &stop);
+    return stop == copy + n;
+#endif
+}
+
 // Return next token, as a number
 float Tokenizer::next_number() {
-    string token;
-    stream >> token;
-    // This, from stackoverflow: convert string to float, detect error
-    stringstream ss(token);
+    string_view token = next_token();
+    if (token.empty()) {
+        error("expected a number, got the end of the file");
+    }
+
     float number;
-    ss >> number;
-    if (ss.fail()) {
-        cerr << "Can't convert " << token << " to number\n";
-        exit(EXIT_FAILURE);
+    if (!parse_number(token, number)) {
+        error("can't convert \"" + string(token) + "\" to a number");
     }
     return number;
 }
 
 bool Tokenizer::eof() {
-    return stream.eof();
+    skip_space();
+    return pos >= end;
 }
 
+void Tokenizer::error(const string& message) {
+    cerr << filename << ":" << token_line << ":" << token_column << ": " << message << "\n";
+    exit(EXIT_FAILURE);
+}
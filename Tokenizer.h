@@ -3,45 +3,65 @@
 #define _TOKENIZER_H_
 
 #include <cstdlib>
-#include <cstdio>
 #include <iostream>
-#include <fstream>
-#include <vector>
+#include <string>
+#include <string_view>
+
+#include "MappedFile.h"
 
 using namespace std;
 
 //////////////////////////////////////////////////////////
 //
-// Given a text file, read it, and break its lines into
-// tokens, using whitespace.  Then, recognize whether each
-// token is a number or not.
+// Given a text file, break it into tokens, using
+// whitespace.  Then, recognize whether each token is a
+// number or not.
+//
+// The file is mapped, not read, and tokens are views into
+// it, so nothing is copied or allocated per token.  A view
+// is only good until the next call.  Errors give the line
+// and column of the token that caused them.
 //
 //////////////////////////////////////////////////////////
 
+// Convert a whole token to a number; false if it isn't one
+bool parse_number(string_view token, float& number);
+
 class Tokenizer {
 public:
-    // Default constructors
-
     // Tokenize a file, given its name
     Tokenizer(const string& filename);
     Tokenizer(const char *filename);
 
-    // Return next token, as a string
-    string next_string();
+    // Return next token, downcased; empty at end of file
+    string_view next_string();
+
+    // Return next token, as it is in the file
+    string_view next_token();
 
     // Return next token, as a number
     float next_number();
 
-    // End of file
+    // End of file (nothing but whitespace left)
     bool eof();
 
     // Get a string token, and die if it doesn't match the pattern
-    void match(const string& pattern);
-    void match(const char *pattern);
+    void match(string_view pattern);
+
+    // Report an error at the latest token, and exit
+    [[noreturn]] void error(const string& message);
 
 private:
     void open(const string& filename);
-    ifstream stream;
+    void skip_space();
+
+    string filename;
+    MappedFile file;
+    const char *pos, *end;
+    const char *line_start; // first character of the current line
+    int line;
+    int token_line, token_column;
+    string lowered; // next_string()'s result, when it had to downcase
 };
 
 #endif
@@ -0,0 +1,88 @@
+#include "TraceContext.h"
+
+#include <algorithm>
+
+TraceStats::TraceStats() {
+    clear();
+}
+
+void TraceStats::clear() {
+    rays = 0;
+    shadow_rays = 0;
+    intersection_tests = 0;
+#if RENDER_STATS
+    primary_rays = 0;
+    reflection_rays = 0;
+    refraction_rays = 0;
+    sphere_tests = 0;
+    triangle_tests = 0;
+    instance_tests = 0;
+    hits = 0;
+    misses = 0;
+    total_internal_reflections = 0;
+    pruned_rays = 0;
+    roulette_kills = 0;
+    for (int i = 0; i < MAX_DEPTH; i++)
+        depth[i] = 0;
+#endif
+}
+
+TraceStats& TraceStats::operator+=(const TraceStats& other) {
+    rays += other.rays;
+    shadow_rays += other.shadow_rays;
+    intersection_tests += other.intersection_tests;
+#if RENDER_STATS
+    primary_rays += other.primary_rays;
+    reflection_rays += other.reflection_rays;
+    refraction_rays += other.refraction_rays;
+    sphere_tests += other.sphere_tests;
+    triangle_tests += other.triangle_tests;
+    instance_tests += other.instance_tests;
+    hits += other.hits;
+    misses += other.misses;
+    total_internal_reflections += other.total_internal_reflections;
+    pruned_rays += other.pruned_rays;
+    roulette_kills += other.roulette_kills;
+    for (int i = 0; i < MAX_DEPTH; i++)
+        depth[i] += other.depth[i];
+#endif
+    return *this;
+}
+
+//
+// The depth histogram is written for depths 0 .. max_depth.
+//
+void TraceStats::write_json(ostream& os, int max_depth) const {
+    os << "\"rays\": " << rays
+       << ", \"shadow_rays\": " << shadow_rays
+       << ", \"intersection_tests\": " << intersection_tests;
+#if RENDER_STATS
+    os << ", \"primary_rays\": " << primary_rays
+       << ", \"reflection_rays\": " << reflection_rays
+       << ", \"refraction_rays\": " << refraction_rays
+       << ", \"sphere_tests\": " << sphere_tests
+       << ", \"triangle_tests\": " << triangle_tests
+       << ", \"instance_tests\": " << instance_tests
+       << ", \"hits\": " << hits
+       << ", \"misses\": " << misses
+       << ", \"total_internal_reflections\": " << total_internal_reflections
+       << ", \"pruned_rays\": " << pruned_rays
+       << ", \"roulette_kills\": " << roulette_kills
+       << ", \"depth_histogram\": [";
+    int last = min(max_depth, MAX_DEPTH - 1);
+    for (int i = 0; i <= last; i++)
+        os << (i > 0 ? ", " : "") << depth[i];
+    os << "]";
+#else
+    (void)max_depth;
+#endif
+}
+
+PhaseTimes::PhaseTimes() {
+    parse = build = update = setup = trace = framebuffer = 0;
+}
+
+TraceContext::TraceContext() {
+    debug = false;
+    seed(0);
+}
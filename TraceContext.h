@@ -0,0 +1,112 @@
+#if !defined(_TRACECONTEXT_H_)
+
+#define _TRACECONTEXT_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "Hit.h"
+
+using namespace std;
+
+//////////////////////////////////////////////////////////
+//
+// Everything that changes while a ray is traced.
+//
+// ray_color(), first_hit() and glossy_color() only write
+// to their arguments and the context, never to globals, so
+// each render thread can trace with its own context
+// without any locking.
+//
+//////////////////////////////////////////////////////////
+
+//
+// The detailed counters below cost an increment here and
+// there.  Build with -DRENDER_STATS=0 to compile them, and
+// every COUNT_STAT() that updates them, out entirely.
+//
+#if !defined(RENDER_STATS)
+#define RENDER_STATS 1
+#endif
+
+#if RENDER_STATS
+#define COUNT_STAT(statement) statement
+#else
+#define COUNT_STAT(statement)
+#endif
+
+// Counters, summed over every ray traced with a context
+struct TraceStats {
+    long rays;               // calls to ray_color()
+    long shadow_rays;        // calls to occluded()
+    long intersection_tests; // ray-object tests
+
+#if RENDER_STATS
+    // Deeper rays land in the last bucket of the histogram
+    static const int MAX_DEPTH = 16;
+
+    long primary_rays;
+    long reflection_rays;
+    long refraction_rays;
+    long sphere_tests;       // the intersection tests, by type
+    long triangle_tests;
+    long instance_tests;
+    long hits;               // rays that hit something (not shadow rays)
+    long misses;
+    long total_internal_reflections;
+    long pruned_rays;        // reflected or refracted rays not traced: too dim
+    long roulette_kills;     // ...or lost at Russian roulette
+    long depth[MAX_DEPTH];   // rays traced at each recursion depth
+#endif
+
+    TraceStats();
+    void clear();
+    TraceStats& operator+=(const TraceStats& other);
+
+    // Write the counters as the members of a JSON object
+    void write_json(ostream& os, int max_depth) const;
+};
+
+// Wall time of each step of the last frame, in ms
+struct PhaseTimes {
+    double parse;        // read_scene(), reading the file
+    double build;        // read_scene(), building the BVHs and light tree
+    double update;       // an animation's frame: moving objects, refitting or rebuilding
+    double setup;        // setup_camera() and the other per-frame setup
+    double trace;        // tracing every pixel
+    double framebuffer;  // turning the frame buffer into an image file
+
+    PhaseTimes();
+};
+
+class TraceContext {
+public:
+    TraceContext();
+
+    bool debug;       // print details about the rays traced
+    TraceStats stats;
+
+    // Scratch list for glossy_color(): the lights that may
+    // reach the current point.  Kept here to reuse its memory.
+    vector<int> lights;
+
+    // Random numbers for Russian roulette.  Seeding each tile
+    // by its position keeps frames the same whatever thread
+    // traces it.
+    void seed(uint32_t s) {random_state = s * 2654435761u + 1;};
+
+    // Uniform in [0, 1)
+    float random() {
+        // xorshift32
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        return (random_state >> 8) * (1.0f / 16777216.0f);
+    };
+
+private:
+    uint32_t random_state;
+};
+
+#endif
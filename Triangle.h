@@ -6,17 +6,77 @@
 #include "GeomLib.h"
 #include "Hit.h"
 
-class Triangle : public virtual Object {
+class Triangle final : public Object {
 public:
-    Triangle(Point4& v1, Point4& v2, Point4& v3, Material& color);
+    Triangle(Point4& v1, Point4& v2, Point4& v3, int material_id);
     void setNormal();
-    bool intersects(Ray4& ray, Hit& hit);
+    bool intersects(Ray4& ray, float t_max, Hit& hit);
+    bool occludes(Ray4& ray, float t_max);
+    AABB bounds();
+
+    // Move the vertices by M
+    void transform(const Matrix4& M);
+
+    // Fill in the hit record for a hit at t along the ray
+    void setHit(Ray4& ray, float t, Hit& hit);
+
+    Point4& vertex() {return v1;};
+    Point4& vertex2() {return v2;};
+    Point4& vertex3() {return v3;};
+    Vector4& edge1() {return e1;};  // v2 - v1
+    Vector4& edge2() {return e2;};  // v3 - v1
 
     friend ostream& operator<<(ostream& os, const Triangle& triangle);
 
 
 private:
     Point4 v1,v2,v3;
+    Vector4 e1,e2;
     Vector4 N;
 };
+
+//
+// Moller-Trumbore, on the triangle v1, v1 + e1, v1 + e2:
+// returns t, or -1 for a miss.  The barycentric u, v and t
+// are kept scaled by the determinant until the ray is known
+// to hit, so misses cost no division at all.
+//
+inline float triangle_intersect_t(const Ray4& ray, const Point4& v1,
+                                  const Vector4& e1, const Vector4& e2, float t_max) {
+    float dx = ray.direction.X(), dy = ray.direction.Y(), dz = ray.direction.Z();
+    float e1x = e1.X(), e1y = e1.Y(), e1z = e1.Z();
+    float e2x = e2.X(), e2y = e2.Y(), e2z = e2.Z();
+
+    float px = dy*e2z - dz*e2y;
+    float py = dz*e2x - dx*e2z;
+    float pz = dx*e2y - dy*e2x;
+    float det = e1x*px + e1y*py + e1z*pz;
+
+    float tx = ray.start.X() - v1.X();
+    float ty = ray.start.Y() - v1.Y();
+    float tz = ray.start.Z() - v1.Z();
+    float u = tx*px + ty*py + tz*pz;
+
+    float qx = ty*e1z - tz*e1y;
+    float qy = tz*e1x - tx*e1z;
+    float qz = tx*e1y - ty*e1x;
+    float v = dx*qx + dy*qy + dz*qz;
+    float t = e2x*qx + e2y*qy + e2z*qz;
+
+    // Flip everything so det > 0, then test against it
+    if (det < 0) {
+        det = -det;
+        u = -u;
+        v = -v;
+        t = -t;
+    }
+    if (!(det > 0 && u >= 0 && v >= 0 && u + v <= det &&
+          t >= EPSILON * det && t < t_max * det)) {
+        return -1;
+    }
+
+    t = t / det;
+    return (EPSILON <= t && t < t_max) ? t : -1;
+}
+
 #endif
@@ -0,0 +1,546 @@
+#include "TriangleSet.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRIANGLESET_X86 1
+#include <immintrin.h>
+#endif
+
+static const float EPS = (float)EPSILON;
+
+TriangleRay::TriangleRay(const Ray4& ray) {
+    sx = ray.start.X();
+    sy = ray.start.Y();
+    sz = ray.start.Z();
+    dx = ray.direction.X();
+    dy = ray.direction.Y();
+    dz = ray.direction.Z();
+}
+
+//////////////////////////////////////////////////////////
+// The kernels.
+//
+// With T = start - v0, P = D x e2, Q = T x e1:
+//     det = e1.P,  u = T.P,  v = D.Q,  t = e2.Q
+// all scaled by det.  Flip their signs so det > 0; the ray
+// hits if u >= 0, v >= 0, u + v <= det and t is in range.
+// If any_hit is set, return the first triangle hit rather
+// than the nearest.
+//////////////////////////////////////////////////////////
+
+typedef int (*TriangleKernel)(const TriangleSet& s, const TriangleRay& ray,
+                              int first, int count, float& t_max, bool any_hit);
+
+// One ray against triangle i: is it hit at EPSILON <= t < t_max?
+static inline bool hit_triangle(const TriangleSet& s, int i,
+                                float sx, float sy, float sz,
+                                float dx, float dy, float dz,
+                                float t_max, float& t_hit) {
+    float px = dy*s.e2z[i] - dz*s.e2y[i];
+    float py = dz*s.e2x[i] - dx*s.e2z[i];
+    float pz = dx*s.e2y[i] - dy*s.e2x[i];
+    float det = s.e1x[i]*px + s.e1y[i]*py + s.e1z[i]*pz;
+
+    float tx = sx - s.vx[i];
+    float ty = sy - s.vy[i];
+    float tz = sz - s.vz[i];
+    float u = tx*px + ty*py + tz*pz;
+
+    float qx = ty*s.e1z[i] - tz*s.e1y[i];
+    float qy = tz*s.e1x[i] - tx*s.e1z[i];
+    float qz = tx*s.e1y[i] - ty*s.e1x[i];
+    float v = dx*qx + dy*qy + dz*qz;
+    float t = s.e2x[i]*qx + s.e2y[i]*qy + s.e2z[i]*qz;
+
+    if (det < 0) {
+        det = -det;
+        u = -u;
+        v = -v;
+        t = -t;
+    }
+    if (!(det > 0 && u >= 0 && v >= 0 && u + v <= det &&
+          t >= EPS*det && t < t_max*det))
+        return false;
+
+    t_hit = t / det;
+    return EPS <= t_hit && t_hit < t_max;
+}
+
+static int kernel_scalar(const TriangleSet& s, const TriangleRay& ray,
+                         int first, int count, float& t_max, bool any_hit) {
+    int best = -1;
+    for (int i = first; i < first + count; i++) {
+        float t;
+        if (hit_triangle(s, i, ray.sx, ray.sy, ray.sz, ray.dx, ray.dy, ray.dz, t_max, t)) {
+            t_max = t;
+            best = i;
+            if (any_hit)
+                return best;
+        }
+    }
+    return best;
+}
+
+#if defined(TRIANGLESET_X86)
+
+// Lanes (of "width") that are inside the range, as a bit mask
+static inline unsigned tail_mask(int remaining, int width) {
+    return remaining >= width ? (1u << width) - 1 : (1u << remaining) - 1;
+}
+
+__attribute__((target("sse2")))
+static int kernel_sse(const TriangleSet& s, const TriangleRay& ray,
+                      int first, int count, float& t_max, bool any_hit) {
+    const __m128 eps  = _mm_set1_ps(EPS);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 sx = _mm_set1_ps(ray.sx), sy = _mm_set1_ps(ray.sy), sz = _mm_set1_ps(ray.sz);
+    const __m128 dx = _mm_set1_ps(ray.dx), dy = _mm_set1_ps(ray.dy), dz = _mm_set1_ps(ray.dz);
+    __m128 t_far = _mm_set1_ps(t_max);
+
+    int best = -1;
+    int end = first + count;
+    for (int i = first; i < end; i += 4) {
+        __m128 e1x = _mm_loadu_ps(&s.e1x[i]), e1y = _mm_loadu_ps(&s.e1y[i]), e1z = _mm_loadu_ps(&s.e1z[i]);
+        __m128 e2x = _mm_loadu_ps(&s.e2x[i]), e2y = _mm_loadu_ps(&s.e2y[i]), e2z = _mm_loadu_ps(&s.e2z[i]);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+
+        __m128 tx = _mm_sub_ps(sx, _mm_loadu_ps(&s.vx[i]));
+        __m128 ty = _mm_sub_ps(sy, _mm_loadu_ps(&s.vy[i]));
+        __m128 tz = _mm_sub_ps(sz, _mm_loadu_ps(&s.vz[i]));
+        __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz));
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz));
+        __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz));
+
+        __m128 flip = _mm_and_ps(det, sign);
+        det = _mm_xor_ps(det, flip);
+        u = _mm_xor_ps(u, flip);
+        v = _mm_xor_ps(v, flip);
+        t = _mm_xor_ps(t, flip);
+
+        __m128 valid = _mm_and_ps(_mm_cmpgt_ps(det, zero),
+                       _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), det));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t, _mm_mul_ps(eps, det)),
+                                             _mm_cmplt_ps(t, _mm_mul_ps(t_far, det))));
+
+        unsigned mask = _mm_movemask_ps(valid) & tail_mask(end - i, 4);
+        if (!mask)
+            continue;
+
+        t = _mm_div_ps(t, det);
+        valid = _mm_and_ps(_mm_cmpge_ps(t, eps), _mm_cmplt_ps(t, t_far));
+        mask &= _mm_movemask_ps(valid);
+        if (mask) {
+            if (any_hit)
+                return i + __builtin_ctz(mask);
+            float ts[4];
+            _mm_storeu_ps(ts, t);
+            for (int j = 0; j < 4; j++) {
+                if ((mask >> j & 1) && ts[j] < t_max) {
+                    t_max = ts[j];
+                    best = i + j;
+                }
+            }
+            t_far = _mm_set1_ps(t_max);
+        }
+    }
+    return best;
+}
+
+__attribute__((target("avx2")))
+static int kernel_avx2(const TriangleSet& s, const TriangleRay& ray,
+                       int first, int count, float& t_max, bool any_hit) {
+    const __m256 eps  = _mm256_set1_ps(EPS);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 sx = _mm256_set1_ps(ray.sx), sy = _mm256_set1_ps(ray.sy), sz = _mm256_set1_ps(ray.sz);
+    const __m256 dx = _mm256_set1_ps(ray.dx), dy = _mm256_set1_ps(ray.dy), dz = _mm256_set1_ps(ray.dz);
+    __m256 t_far = _mm256_set1_ps(t_max);
+
+    int best = -1;
+    int end = first + count;
+    for (int i = first; i < end; i += 8) {
+        __m256 e1x = _mm256_loadu_ps(&s.e1x[i]), e1y = _mm256_loadu_ps(&s.e1y[i]), e1z = _mm256_loadu_ps(&s.e1z[i]);
+        __m256 e2x = _mm256_loadu_ps(&s.e2x[i]), e2y = _mm256_loadu_ps(&s.e2y[i]), e2z = _mm256_loadu_ps(&s.e2z[i]);
+
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+                                   _mm256_mul_ps(e1z, pz));
+
+        __m256 tx = _mm256_sub_ps(sx, _mm256_loadu_ps(&s.vx[i]));
+        __m256 ty = _mm256_sub_ps(sy, _mm256_loadu_ps(&s.vy[i]));
+        __m256 tz = _mm256_sub_ps(sz, _mm256_loadu_ps(&s.vz[i]));
+        __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)),
+                                 _mm256_mul_ps(tz, pz));
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+        __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                                 _mm256_mul_ps(dz, qz));
+        __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)),
+                                 _mm256_mul_ps(e2z, qz));
+
+        __m256 flip = _mm256_and_ps(det, sign);
+        det = _mm256_xor_ps(det, flip);
+        u = _mm256_xor_ps(u, flip);
+        v = _mm256_xor_ps(v, flip);
+        t = _mm256_xor_ps(t, flip);
+
+        __m256 valid = _mm256_and_ps(_mm256_cmp_ps(det, zero, _CMP_GT_OQ),
+                       _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, zero, _CMP_GE_OQ)));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), det, _CMP_LE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, _mm256_mul_ps(eps, det), _CMP_GE_OQ),
+                                                   _mm256_cmp_ps(t, _mm256_mul_ps(t_far, det), _CMP_LT_OQ)));
+
+        unsigned mask = _mm256_movemask_ps(valid) & tail_mask(end - i, 8);
+        if (!mask)
+            continue;
+
+        t = _mm256_div_ps(t, det);
+        valid = _mm256_and_ps(_mm256_cmp_ps(t, eps, _CMP_GE_OQ), _mm256_cmp_ps(t, t_far, _CMP_LT_OQ));
+        mask &= _mm256_movemask_ps(valid);
+        if (mask) {
+            if (any_hit)
+                return i + __builtin_ctz(mask);
+            float ts[8];
+            _mm256_storeu_ps(ts, t);
+            for (int j = 0; j < 8; j++) {
+                if ((mask >> j & 1) && ts[j] < t_max) {
+                    t_max = ts[j];
+                    best = i + j;
+                }
+            }
+            t_far = _mm256_set1_ps(t_max);
+        }
+    }
+    return best;
+}
+
+// As for the sphere kernel: no FMA, so the hits match the others'.
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static int kernel_avx512(const TriangleSet& s, const TriangleRay& ray,
+                         int first, int count, float& t_max, bool any_hit) {
+    const __m512 eps  = _mm512_set1_ps(EPS);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512i sign = _mm512_set1_epi32((int)0x80000000);
+    const __m512 sx = _mm512_set1_ps(ray.sx), sy = _mm512_set1_ps(ray.sy), sz = _mm512_set1_ps(ray.sz);
+    const __m512 dx = _mm512_set1_ps(ray.dx), dy = _mm512_set1_ps(ray.dy), dz = _mm512_set1_ps(ray.dz);
+    __m512 t_far = _mm512_set1_ps(t_max);
+
+    int best = -1;
+    int end = first + count;
+    for (int i = first; i < end; i += 16) {
+        __m512 e1x = _mm512_loadu_ps(&s.e1x[i]), e1y = _mm512_loadu_ps(&s.e1y[i]), e1z = _mm512_loadu_ps(&s.e1z[i]);
+        __m512 e2x = _mm512_loadu_ps(&s.e2x[i]), e2y = _mm512_loadu_ps(&s.e2y[i]), e2z = _mm512_loadu_ps(&s.e2z[i]);
+
+        __m512 px = _mm512_sub_ps(_mm512_mul_ps(dy, e2z), _mm512_mul_ps(dz, e2y));
+        __m512 py = _mm512_sub_ps(_mm512_mul_ps(dz, e2x), _mm512_mul_ps(dx, e2z));
+        __m512 pz = _mm512_sub_ps(_mm512_mul_ps(dx, e2y), _mm512_mul_ps(dy, e2x));
+        __m512 det = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e1x, px), _mm512_mul_ps(e1y, py)),
+                                   _mm512_mul_ps(e1z, pz));
+
+        __m512 tx = _mm512_sub_ps(sx, _mm512_loadu_ps(&s.vx[i]));
+        __m512 ty = _mm512_sub_ps(sy, _mm512_loadu_ps(&s.vy[i]));
+        __m512 tz = _mm512_sub_ps(sz, _mm512_loadu_ps(&s.vz[i]));
+        __m512 u = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(tx, px), _mm512_mul_ps(ty, py)),
+                                 _mm512_mul_ps(tz, pz));
+
+        __m512 qx = _mm512_sub_ps(_mm512_mul_ps(ty, e1z), _mm512_mul_ps(tz, e1y));
+        __m512 qy = _mm512_sub_ps(_mm512_mul_ps(tz, e1x), _mm512_mul_ps(tx, e1z));
+        __m512 qz = _mm512_sub_ps(_mm512_mul_ps(tx, e1y), _mm512_mul_ps(ty, e1x));
+        __m512 v = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, qx), _mm512_mul_ps(dy, qy)),
+                                 _mm512_mul_ps(dz, qz));
+        __m512 t = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e2x, qx), _mm512_mul_ps(e2y, qy)),
+                                 _mm512_mul_ps(e2z, qz));
+
+        // AVX-512F has no float XOR: flip the sign bits as integers
+        __m512i flip = _mm512_and_si512(_mm512_castps_si512(det), sign);
+        det = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(det), flip));
+        u = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(u), flip));
+        v = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), flip));
+        t = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(t), flip));
+
+        __mmask16 valid = _mm512_cmp_ps_mask(det, zero, _CMP_GT_OQ)
+                        & _mm512_cmp_ps_mask(u, zero, _CMP_GE_OQ)
+                        & _mm512_cmp_ps_mask(v, zero, _CMP_GE_OQ)
+                        & _mm512_cmp_ps_mask(_mm512_add_ps(u, v), det, _CMP_LE_OQ)
+                        & _mm512_cmp_ps_mask(t, _mm512_mul_ps(eps, det), _CMP_GE_OQ)
+                        & _mm512_cmp_ps_mask(t, _mm512_mul_ps(t_far, det), _CMP_LT_OQ)
+                        & (__mmask16)tail_mask(end - i, 16);
+        if (!valid)
+            continue;
+
+        t = _mm512_maskz_div_ps(valid, t, det);
+        valid &= _mm512_cmp_ps_mask(t, eps, _CMP_GE_OQ) & _mm512_cmp_ps_mask(t, t_far, _CMP_LT_OQ);
+
+        unsigned mask = valid;
+        if (mask) {
+            if (any_hit)
+                return i + __builtin_ctz(mask);
+            float ts[16];
+            _mm512_storeu_ps(ts, t);
+            for (int j = 0; j < 16; j++) {
+                if ((mask >> j & 1) && ts[j] < t_max) {
+                    t_max = ts[j];
+                    best = i + j;
+                }
+            }
+            t_far = _mm512_set1_ps(t_max);
+        }
+    }
+    return best;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////
+// Packet kernels: one triangle at a time, against 8 rays
+// at a time.  Each ray's t comes out exactly as it would
+// from the kernels above.
+//////////////////////////////////////////////////////////
+
+static void packet_scalar(const TriangleSet& s, RayPacket& p,
+                          int first, int count, uint64_t rays) {
+    for (int i = first; i < first + count; i++) {
+        for (uint64_t m = rays; m; m &= m - 1) {
+            int j = __builtin_ctzll(m);
+            float t;
+            if (hit_triangle(s, i, p.sx[j], p.sy[j], p.sz[j], p.dx[j], p.dy[j], p.dz[j], p.t[j], t)) {
+                p.t[j] = t;
+                p.triangle[j] = i;
+                p.sphere[j] = -1;
+            }
+        }
+    }
+}
+
+#if defined(TRIANGLESET_X86)
+
+__attribute__((target("avx2")))
+static void packet_avx2(const TriangleSet& s, RayPacket& p,
+                        int first, int count, uint64_t rays) {
+    const __m256 eps  = _mm256_set1_ps(EPS);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256i no_sphere = _mm256_set1_epi32(-1);
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+    for (int j = 0; j < RayPacket::MAX_RAYS; j += 8) {
+        unsigned lanes = (unsigned)(rays >> j) & 0xff;
+        if (!lanes)
+            continue;
+
+        // The rays of these 8 that are in the mask, as a vector mask
+        __m256i bits = _mm256_and_si256(_mm256_set1_epi32(lanes), lane_bits);
+        const __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, lane_bits));
+
+        __m256 sx = _mm256_load_ps(&p.sx[j]), sy = _mm256_load_ps(&p.sy[j]), sz = _mm256_load_ps(&p.sz[j]);
+        __m256 dx = _mm256_load_ps(&p.dx[j]), dy = _mm256_load_ps(&p.dy[j]), dz = _mm256_load_ps(&p.dz[j]);
+        __m256 t_far = _mm256_load_ps(&p.t[j]);
+        __m256 best = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)&p.triangle[j]));
+        __m256 hit_any = _mm256_setzero_ps();
+
+        for (int i = first; i < first + count; i++) {
+            __m256 e1x = _mm256_set1_ps(s.e1x[i]), e1y = _mm256_set1_ps(s.e1y[i]), e1z = _mm256_set1_ps(s.e1z[i]);
+            __m256 e2x = _mm256_set1_ps(s.e2x[i]), e2y = _mm256_set1_ps(s.e2y[i]), e2z = _mm256_set1_ps(s.e2z[i]);
+
+            __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+            __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+            __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+            __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+                                       _mm256_mul_ps(e1z, pz));
+
+            __m256 tx = _mm256_sub_ps(sx, _mm256_set1_ps(s.vx[i]));
+            __m256 ty = _mm256_sub_ps(sy, _mm256_set1_ps(s.vy[i]));
+            __m256 tz = _mm256_sub_ps(sz, _mm256_set1_ps(s.vz[i]));
+            __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)),
+                                     _mm256_mul_ps(tz, pz));
+
+            __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+            __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+            __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+            __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                                     _mm256_mul_ps(dz, qz));
+            __m256 t = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)),
+                                     _mm256_mul_ps(e2z, qz));
+
+            __m256 flip = _mm256_and_ps(det, sign);
+            det = _mm256_xor_ps(det, flip);
+            u = _mm256_xor_ps(u, flip);
+            v = _mm256_xor_ps(v, flip);
+            t = _mm256_xor_ps(t, flip);
+
+            __m256 valid = _mm256_and_ps(active, _mm256_cmp_ps(det, zero, _CMP_GT_OQ));
+            valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                       _mm256_cmp_ps(v, zero, _CMP_GE_OQ)));
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), det, _CMP_LE_OQ));
+            valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, _mm256_mul_ps(eps, det), _CMP_GE_OQ),
+                                                       _mm256_cmp_ps(t, _mm256_mul_ps(t_far, det), _CMP_LT_OQ)));
+            if (_mm256_testz_ps(valid, valid))
+                continue;
+
+            t = _mm256_div_ps(t, det);
+            valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, eps, _CMP_GE_OQ),
+                                                       _mm256_cmp_ps(t, t_far, _CMP_LT_OQ)));
+
+            t_far = _mm256_blendv_ps(t_far, t, valid);
+            best = _mm256_blendv_ps(best, _mm256_castsi256_ps(_mm256_set1_epi32(i)), valid);
+            hit_any = _mm256_or_ps(hit_any, valid);
+        }
+
+        _mm256_store_ps(&p.t[j], t_far);
+        _mm256_storeu_si256((__m256i*)&p.triangle[j], _mm256_castps_si256(best));
+        __m256 sphere = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)&p.sphere[j]));
+        sphere = _mm256_blendv_ps(sphere, _mm256_castsi256_ps(no_sphere), hit_any);
+        _mm256_storeu_si256((__m256i*)&p.sphere[j], _mm256_castps_si256(sphere));
+    }
+}
+
+#endif
+
+// Indexed by SimdLevel
+#if defined(TRIANGLESET_X86)
+static const TriangleKernel kernels[] = {kernel_scalar, kernel_sse, kernel_avx2, kernel_avx512};
+#else
+static const TriangleKernel kernels[] = {kernel_scalar};
+#endif
+
+//////////////////////////////////////////////////////////
+// The set itself
+//////////////////////////////////////////////////////////
+
+TriangleSet::TriangleSet() {
+    clear();
+}
+
+void TriangleSet::clear() {
+    objects.clear();
+    meshes.clear();
+    mesh_triangles.clear();
+    vx.assign(PADDING, 0);
+    vy.assign(PADDING, 0);
+    vz.assign(PADDING, 0);
+    e1x.assign(PADDING, 0);
+    e1y.assign(PADDING, 0);
+    e1z.assign(PADDING, 0);
+    e2x.assign(PADDING, 0);
+    e2y.assign(PADDING, 0);
+    e2z.assign(PADDING, 0);
+}
+
+void TriangleSet::reserve(int n) {
+    for (auto array : {&vx, &vy, &vz, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z})
+        array->reserve(n + PADDING);
+    objects.reserve(n);
+    meshes.reserve(n);
+    mesh_triangles.reserve(n);
+}
+
+size_t TriangleSet::bytes() const {
+    size_t floats = vx.capacity() + vy.capacity() + vz.capacity()
+                  + e1x.capacity() + e1y.capacity() + e1z.capacity()
+                  + e2x.capacity() + e2y.capacity() + e2z.capacity();
+    return floats * sizeof(float) + objects.capacity() * sizeof(Triangle*)
+         + meshes.capacity() * sizeof(Mesh*) + mesh_triangles.capacity() * sizeof(int);
+}
+
+void TriangleSet::add(Triangle* triangle) {
+    push(triangle->vertex(), triangle->edge1(), triangle->edge2());
+    objects.push_back(triangle);
+    meshes.push_back(NULL);
+    mesh_triangles.push_back(-1);
+}
+
+void TriangleSet::add(Mesh* mesh, int triangle) {
+    Point4 v1 = mesh->corner(triangle, 0);
+    push(v1, mesh->corner(triangle, 1) - v1, mesh->corner(triangle, 2) - v1);
+    objects.push_back(NULL);
+    meshes.push_back(mesh);
+    mesh_triangles.push_back(triangle);
+}
+
+void TriangleSet::push(const Point4& v, const Vector4& e1, const Vector4& e2) {
+    // Overwrite the first padding entry, and add a new one at the end
+    store((int)objects.size(), v, e1, e2);
+    vx.push_back(0);
+    vy.push_back(0);
+    vz.push_back(0);
+    e1x.push_back(0);
+    e1y.push_back(0);
+    e1z.push_back(0);
+    e2x.push_back(0);
+    e2y.push_back(0);
+    e2z.push_back(0);
+}
+
+void TriangleSet::store(int i, const Point4& v, const Vector4& e1, const Vector4& e2) {
+    vx[i] = v.X();
+    vy[i] = v.Y();
+    vz[i] = v.Z();
+    e1x[i] = e1.X();
+    e1y[i] = e1.Y();
+    e1z[i] = e1.Z();
+    e2x[i] = e2.X();
+    e2y[i] = e2.Y();
+    e2z[i] = e2.Z();
+}
+
+Object* TriangleSet::object(int i) const {
+    if (objects[i] != NULL)
+        return objects[i];
+    return meshes[i];
+}
+
+AABB TriangleSet::bounds(int i) const {
+    if (objects[i] != NULL)
+        return objects[i]->bounds();
+    return meshes[i]->bounds(mesh_triangles[i]);
+}
+
+void TriangleSet::update(int i) {
+    if (objects[i] != NULL) {
+        store(i, objects[i]->vertex(), objects[i]->edge1(), objects[i]->edge2());
+    }
+    else {
+        Point4 v1 = meshes[i]->corner(mesh_triangles[i], 0);
+        store(i, v1, meshes[i]->corner(mesh_triangles[i], 1) - v1,
+              meshes[i]->corner(mesh_triangles[i], 2) - v1);
+    }
+}
+
+void TriangleSet::setHit(int i, Ray4& ray, float t, Hit& hit) const {
+    if (objects[i] != NULL)
+        objects[i]->setHit(ray, t, hit);
+    else
+        meshes[i]->setHit(ray, t, mesh_triangles[i], hit);
+}
+
+int TriangleSet::nearest(const TriangleRay& ray, int first, int count, float& t_max) const {
+    return kernels[simd_level()](*this, ray, first, count, t_max, false);
+}
+
+bool TriangleSet::any(const TriangleRay& ray, int first, int count, float t_max) const {
+    return kernels[simd_level()](*this, ray, first, count, t_max, true) >= 0;
+}
+
+// Packets are 8 rays wide at most, so AVX-512 uses the AVX2 kernel.
+void TriangleSet::nearest(RayPacket& packet, int first, int count, uint64_t rays) const {
+#if defined(TRIANGLESET_X86)
+    if (simd_level() >= SIMD_AVX2) {
+        packet_avx2(*this, packet, first, count, rays);
+        return;
+    }
+#endif
+    packet_scalar(*this, packet, first, count, rays);
+}
@@ -0,0 +1,96 @@
+#if !defined(_TRIANGLESET_H_)
+
+#define _TRIANGLESET_H_
+
+#include <vector>
+
+#include "GeomLib.h"
+#include "Triangle.h"
+#include "Mesh.h"
+#include "Simd.h"
+#include "RayPacket.h"
+
+//////////////////////////////////////////////////////////
+//
+// Triangles stored as a structure of arrays: one vertex
+// and the two edges from it, precomputed, so a ray can be
+// tested against 4, 8 or 16 triangles at a time with the
+// Moller-Trumbore algorithm.  The kernel is chosen by
+// simd_level(), as for SphereSet.  Each one is either a
+// Triangle or one triangle of a Mesh.
+//
+// The kernels test the barycentric coordinates and t while
+// they are still scaled by the determinant, so the one
+// division is only done once some triangle is known to be
+// hit.  Like the sphere kernels, they all do the same float
+// arithmetic in the same order, and find the same hits.
+//
+//////////////////////////////////////////////////////////
+
+// A ray, unpacked for the triangle kernels
+struct TriangleRay {
+    TriangleRay(const Ray4& ray);
+
+    float sx, sy, sz;  // start
+    float dx, dy, dz;  // direction
+};
+
+class TriangleSet {
+public:
+    TriangleSet();
+
+    void clear();
+    // Make room for n triangles in all
+    void reserve(int n);
+    void add(Triangle* triangle);
+    void add(Mesh* mesh, int triangle);
+    int size() const {return (int)objects.size();};
+
+    // Memory held, in bytes
+    size_t bytes() const;
+
+    // Triangle i's Triangle or Mesh, and its box
+    Object* object(int i) const;
+    AABB bounds(int i) const;
+
+    // Copy triangle i again, after it has moved
+    void update(int i);
+
+    // Fill in the hit record for a hit on triangle i, at t
+    void setHit(int i, Ray4& ray, float t, Hit& hit) const;
+
+    //
+    // Find the nearest of triangles first .. first+count-1 hit
+    // at EPSILON <= t < t_max.  If there is one, set t_max to
+    // its t and return its index; otherwise return -1.
+    //
+    int nearest(const TriangleRay& ray, int first, int count, float& t_max) const;
+
+    // Is any of them hit at EPSILON <= t < t_max?
+    bool any(const TriangleRay& ray, int first, int count, float t_max) const;
+
+    //
+    // The same as nearest(), for each ray of the packet in the
+    // mask "rays": if it hits one of the triangles before its t,
+    // update its t and triangle (and clear its sphere).
+    //
+    void nearest(RayPacket& packet, int first, int count, uint64_t rays) const;
+
+    // The arrays are padded by this many unused entries, so the
+    // kernels can load a full vector starting at any triangle.
+    static const int PADDING = 16;
+
+    vector<float> vx, vy, vz;    // first vertex
+    vector<float> e1x, e1y, e1z; // second vertex - first
+    vector<float> e2x, e2y, e2z; // third vertex - first
+
+private:
+    void push(const Point4& v, const Vector4& e1, const Vector4& e2);
+    void store(int i, const Point4& v, const Vector4& e1, const Vector4& e2);
+
+    vector<Triangle*> objects;  // each entry's Triangle, or NULL if it's a mesh's
+    vector<Mesh*> meshes;       // each entry's Mesh, or NULL
+    vector<int> mesh_triangles; // which of its mesh's triangles it is
+};
+
+#endif
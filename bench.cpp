@@ -0,0 +1,270 @@
+//////////////////////////////////////////////////////
+//
+// The benchmark suite.  Headless: it links the tracer
+// but not the viewer, GLFW or OpenGL.
+//
+// It times the per-ray math, then renders each scene at
+// several sizes and thread counts, then builds each
+// scene's accelerator every way (BVH by SAH and LBVH,
+// grid, k-d tree) and renders with each, and writes
+// everything as one JSON document, so runs can be compared
+// across versions and machines.
+//
+//////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "RayTracer.h"
+#include "Benchmark.h"
+#include "Simd.h"
+
+using namespace std;
+
+struct FrameSize {
+    int width, height;
+};
+
+// "s" as a JSON string literal
+string json_string(const string& s) {
+    string quoted = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void usage() {
+    cerr << "Usage:\n";
+    cerr << "  bench [options] [scene-file.txt ...]\n";
+    cerr << "Renders simple.txt, five_balls.txt and box_sphere.txt unless\n";
+    cerr << "scene files are given.\n";
+    cerr << "Options:\n";
+    cerr << "  --output FILE   write the JSON results to FILE (default: stdout)\n";
+    cerr << "  --frames N      frames timed per scene, size and thread count\n";
+    cerr << "                  (default: 10)\n";
+    cerr << "  --rounds N      passes over the inputs of each math benchmark\n";
+    cerr << "                  (default: 256)\n";
+    cerr << "  --threads N     time only N threads (default: 1, 2, 4, ... cores)\n";
+    cerr << "  --shadows       cast shadow rays toward each light\n";
+    cerr << "  --max-depth N   trace reflections and refractions N deep (default: 4)\n";
+    cerr << "  --min-weight X  skip reflected and refracted rays that add at most X\n";
+    cerr << "                  to a pixel (default: 1/512)\n";
+    cerr << "  --roulette      Russian roulette on the dimmest rays\n";
+    cerr << "  --accel NAME    render with a bvh, grid or kdtree (default: bvh)\n";
+    cerr << "  --bvh NAME      build the BVH with sah or lbvh (default: sah)\n";
+    cerr << "  --quick         one small size and 3 frames, for a smoke test\n";
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output_file = NULL;
+    int frames = 10;
+    int rounds = 256;
+    bool quick = false;
+    vector<string> scenes;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+
+        if (arg == "--output" && has_value) {
+            output_file = argv[++i];
+        }
+        else if (arg == "--frames" && has_value) {
+            frames = atoi(argv[++i]);
+        }
+        else if (arg == "--rounds" && has_value) {
+            rounds = atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && has_value) {
+            num_threads = atoi(argv[++i]);
+        }
+        else if (arg == "--shadows") {
+            shadows_on = true;
+        }
+        else if (arg == "--max-depth" && has_value) {
+            max_recursion_depth = atoi(argv[++i]);
+        }
+        else if (arg == "--min-weight" && has_value) {
+            min_ray_weight = atof(argv[++i]);
+        }
+        else if (arg == "--roulette") {
+            russian_roulette = true;
+        }
+        else if (arg == "--accel" && has_value) {
+            if (!accelerator_type(argv[++i], accel_type))
+                usage();
+            accel_fixed = true;
+        }
+        else if (arg == "--bvh" && has_value) {
+            if (!build_method(argv[++i], bvh_build))
+                usage();
+        }
+        else if (arg == "--quick") {
+            quick = true;
+        }
+        else if (arg[0] == '-') {
+            usage();
+        }
+        else {
+            scenes.push_back(arg);
+        }
+    }
+
+    if (frames < 1 || rounds < 1 || max_recursion_depth < 0) {
+        usage();
+    }
+
+    if (scenes.empty()) {
+        scenes.push_back("simple.txt");
+        scenes.push_back("five_balls.txt");
+        scenes.push_back("box_sphere.txt");
+    }
+
+    vector<FrameSize> sizes;
+    if (quick) {
+        sizes.push_back({100, 100});
+        frames = 3;
+        rounds = 16;
+    }
+    else {
+        sizes.push_back({150, 150});
+        sizes.push_back({300, 300});
+        sizes.push_back({640, 480});
+    }
+
+    vector<int> thread_counts;
+    if (num_threads > 0) {
+        thread_counts.push_back(num_threads);
+    }
+    else {
+        int cores = TileScheduler::hardware_threads();
+        for (int n = 1; n < cores; n *= 2)
+            thread_counts.push_back(n);
+        thread_counts.push_back(cores);
+    }
+
+    FILE *out = stdout;
+    if (output_file != NULL) {
+        out = fopen(output_file, "w");
+        if (out == NULL) {
+            cerr << "Can't write " << output_file << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"version\": 1,\n");
+#if defined(__VERSION__)
+    string compiler = __VERSION__;
+#else
+    string compiler = "unknown";
+#endif
+    fprintf(out, "  \"config\": {\"compiler\": %s, \"simd\": \"%s\", \"hardware_threads\": %d, "
+                 "\"tile_size\": %d, \"packet\": %d, \"shadows\": %s, \"max_depth\": %d, "
+                 "\"min_weight\": %g, \"roulette\": %s, \"accelerator\": \"%s\", \"bvh\": \"%s\"},\n",
+            json_string(compiler).c_str(), simd_name().c_str(), TileScheduler::hardware_threads(),
+            tile_size, packet_size, shadows_on ? "true" : "false", max_recursion_depth,
+            min_ray_weight, russian_roulette ? "true" : "false",
+            accelerator_type_name(accel_type).c_str(), build_method_name(bvh_build).c_str());
+
+    cerr << "math\n";
+    vector<MicroResult> micro = benchmark_micro(rounds);
+    fprintf(out, "  \"micro\": [\n");
+    for (int i = 0; i < (int)micro.size(); i++) {
+        fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"mops_per_s\": %.2f}%s\n",
+                micro[i].name.c_str(), micro[i].ns_per_op, 1000.0 / micro[i].ns_per_op,
+                i + 1 < (int)micro.size() ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+
+    fprintf(out, "  \"frames\": [\n");
+    bool first = true;
+    for (auto& scene : scenes) {
+        clear_scene();
+        read_scene(scene.c_str());
+
+        for (auto& size : sizes) {
+            resize_frame_buffer(size.width, size.height);
+
+            double one_thread_ms = 0;
+            for (int n : thread_counts) {
+                cerr << scene << " " << size.width << "x" << size.height
+                     << ", " << n << " threads\n";
+                num_threads = n;
+                FrameTimes times = time_frames(frames);
+
+                double median = times.percentile(50);
+                if (n == 1)
+                    one_thread_ms = median;
+
+                fprintf(out, "%s    {\"scene\": %s, \"width\": %d, \"height\": %d, "
+                             "\"threads\": %d, \"frames\": %d, \"rays_per_frame\": %ld,\n",
+                        first ? "" : ",\n", json_string(scene).c_str(), size.width, size.height,
+                        n, frames, times.rays);
+                fprintf(out, "     \"frame_ms\": {\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, "
+                             "\"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+                        times.min(), times.mean(), median,
+                        times.percentile(90), times.percentile(99), times.max());
+                fprintf(out, "     \"mrays_per_s\": %.3f, \"ns_per_ray\": %.2f",
+                        times.rays / (median * 1000.0), median * 1e6 / times.rays);
+                if (one_thread_ms > 0)
+                    fprintf(out, ", \"speedup\": %.3f", one_thread_ms / median);
+                fprintf(out, "}");
+                first = false;
+            }
+        }
+    }
+    fprintf(out, "\n  ],\n");
+
+    //
+    // The accelerators side by side: build time and memory,
+    // against the frame time and ray rate they give, at the
+    // first size and the most threads timed above.
+    //
+    struct Choice {
+        AcceleratorType type;
+        BuildMethod method;
+    };
+    const Choice choices[] = {
+        {ACCEL_BVH, BUILD_SAH}, {ACCEL_BVH, BUILD_LBVH}, {ACCEL_GRID, BUILD_SAH}, {ACCEL_KDTREE, BUILD_SAH}
+    };
+    fprintf(out, "  \"accelerators\": [\n");
+    first = true;
+    for (auto& scene : scenes) {
+        clear_scene();
+        read_scene(scene.c_str());
+        resize_frame_buffer(sizes[0].width, sizes[0].height);
+
+        for (auto& choice : choices) {
+            unique_ptr<Accelerator> accel = make_accelerator(choice.type, choice.method);
+            cerr << scene << " " << accel->name() << "\n";
+            auto start = chrono::steady_clock::now();
+            accel->build(scene_objects, num_threads);
+            auto stop = chrono::steady_clock::now();
+            double build_ms = chrono::duration<double, milli>(stop - start).count();
+            scene_accel = move(accel);
+            FrameTimes times = time_frames(frames);
+
+            double median = times.percentile(50);
+            fprintf(out, "%s    {\"scene\": %s, \"accelerator\": \"%s\", \"build_ms\": %.3f, "
+                         "\"bytes\": %zu, \"frame_ms\": %.3f, \"mrays_per_s\": %.3f}",
+                    first ? "" : ",\n", json_string(scene).c_str(), scene_accel->name().c_str(),
+                    build_ms, scene_accel->bytes(), median, times.rays / (median * 1000.0));
+            first = false;
+        }
+    }
+    fprintf(out, "\n  ]\n");
+    fprintf(out, "}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -2,6 +2,10 @@
 //
 // A recursive ray tracer.
 //
+// This file holds the interactive viewer (GLFW window,
+// keyboard UI) and main().  The tracer itself is in
+// RayTracer.cpp.
+//
 //////////////////////////////////////////////////////
 
 #include <glad/glad.h>
@@ -9,25 +13,25 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <cfloat>
 #include <iostream>
 #include <fstream>
 #include <cmath>
 #include <vector>
 #include <map>
+#include <chrono>
+#include <random>
 
 #include "Camera.h"
 #include "KBUI.h"
 
-#include "GeomLib.h"
-#include "Color.h"
-#include "Object.h"
-#include "Triangle.h"
+#include "RayTracer.h"
 #include "Sphere.h"
-#include "Hit.h"
-#include "HitList.h"
-#include "Tokenizer.h"
-#include "Light.h"
-#include "Material.h"
+#include "Simd.h"
+#include "Benchmark.h"
+#include "ImageWriter.h"
+#include "ProgressiveRenderer.h"
+#include "Animation.h"
 
 using namespace std;
 
@@ -39,19 +43,19 @@ Camera cam;
 ////////////////////////////////////////////////////
 
 // Forward declarations for functions in this file
+// (the tracer's are in RayTracer.h)
 void init_UI();
-void setup_camera();
 void check_for_resize();
-Ray4 get_ray(int xDCS, int yDCS);
-bool first_hit(Ray4 &ray, Hit& hit);
-Color ray_color(Ray4& ray, int depth);
-Vector4 mirror_direction(Vector4& L, Vector4& N);
-bool refract(Vector4& L, Vector4& N, float n_in, float n_trans, Vector4& T);
-Color local_illumination(Vector4& V, Vector4& N, Vector4& L, Material& mat, Color& ls);
-void read_scene(const char *sceneFile);
-void render();
+void benchmark(int frames);
+void benchmark_bvh();
+void benchmark_packets(int frames);
+void benchmark_math();
+void render_animation(const char *animation_file, const char *output_file);
+void usage();
 void camera_changed();
 void cam_param_changed(float);
+void shadows_changed(float);
+void max_depth_changed(float);
 bool get_was_window_resized();
 void reset_camera(float);
 void init_scene();
@@ -61,364 +65,35 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 void display ();
 int main(int argc, char *argv[]);
 
-typedef unsigned char byte; // In case compiler doesn't define "byte" type
-
-// USEFUL Flag:
-// When the user clicks on a pixel, the mouse_button_callback does two things:
-//   1. sets this flag.
-//   2. calls ray_color() on that pixel
-// This lets you check all your intersection code, for ONE ray of your choosing.
-bool debugOn = false;
-
-// FRAME BUFFER Declarations.
-// The initial image is 300 x 300 x 3 bytes (3 bytes per pixel)
-int winWidth  = 300;
-int winHeight = 300;
-byte *img = NULL;   // image is allocated by check_for_resize(), not here.
-
-// These are the camera parameters.
-// The camera position and orientation:
-Point4  eye;
-Point4  lookat;
-Vector4 vup;
-
-// The camera's HOME parameters, used in reset_camera()
-Point4  eye_home;
-Point4  lookat_home;
-Vector4 vup_home;
-
-// The clipping frustum
-float clipL = -1;
-float clipR = +1;
-float clipB = -1;
-float clipT = +1;
-float clipN =  2;
-
-// The camera's HOME frustum, also used in reset_camera()
-float clip_home[5] = {-1, +1, -1, +1, 2};
-
-vector<Object*> scene_objects; // list of objects in the scene
-vector<Light> scene_lights; // list of lights in the scene
-map<string, Material> materials_by_name; // named materials
-Color ambient_light; // indirect light that shines when all lights are blocked
-float ambient_fraction; // how much of lights is ambient
-
-Matrix4 Mvcswcs;  // the inverse of the view matrix.
-HitList hits;     // list of hit records for current ray
-Hit* hitPool;
-
-// Used to trigger render() when camera has changed.
+// Used to trigger a new render when camera has changed.
 bool frame_buffer_stale = true;
 
-// Rays which miss all objects have this color.
-const Color background_color(0.3, 0.4, 0.4); // dark blue
-
-const int max_recursion_depth = 4;
-
-//////////////////////////////////////////////////////////////////////
-// Compute Mvcstowcs.
-// YOU MUST IMPLEMENT THIS FUNCTION.
-//////////////////////////////////////////////////////////////////////
-void setup_camera() {
-    Mvcswcs = Matrix4::Identity();
-
-    // The camera's basis vectors
-    Vector4 z = (eye - lookat).normalized();
-    Vector4 x = (vup^z).normalized();
-    Vector4 y = z^x;
-
-    // The inverse of the view matrix
-    Mvcswcs.set(x.X(), y.X(), z.X(), eye.X(),
-                x.Y(), y.Y(), z.Y(), eye.Y(),
-                x.Z(), y.Z(), z.Z(), eye.Z(),
-                0.0,   0.0,   0.0,      1.0);
-
-    check_for_resize();
-}
-
-/////////////////////////////////////////////////////////
-//
-// Get glossy color of a ray
-//
-/////////////////////////////////////////////////////////
-Color glossy_color(Ray4& ray, Hit& hit, Object* obj) {
-    Color color = Color(0, 0, 0);
-
-    Vector4 negatedV = -ray.direction;
-
-    for(int i = 0; i < scene_lights.size(); i++) {
-        Light light = scene_lights[i];
-        Vector4 lightDirection = (light.getPos() - hit.hitPoint()).normalized();
-
-        color += local_illumination(negatedV, hit.normal(), lightDirection, obj->getMaterial(), light.getColor());
-    }
-    color += obj->getMaterial().getAmbient() * ambient_light;
-    return color;
-}
-
-/////////////////////////////////////////////////////////
-// Get color of a ray passing through (x,y)DCS. - TODO
-// Find the first object hit.
-//
-// When a ray hits a surface and refracts, there are two indexes of
-// refraction: n_i and n_t.  Which one is which?  I suggest that you use N
-// dot L, to decide if the ray is entering or exiting the material.
-/////////////////////////////////////////////////////////
-Color ray_color(Ray4& ray, int depth) {
-    Hit hit;
-
-    if(first_hit(ray, hit)) {
-
-        if(hit.getObject()->getMaterial().getType() == PHONG)
-            return glossy_color(ray, hit, hit.getObject());
-
-        else {
-
-            if(depth >= max_recursion_depth)
-                return background_color;
-
-            Vector4 R = mirror_direction(ray.direction, hit.normal());
+// Renders in the background, so the UI never waits for a frame.
+ProgressiveRenderer progressive;
 
-            // Reflection
-            float n_i = 0;
-            float n_t = 0;
-
-            // If the ray is entering
-            if(hit.normal() * ray.direction < 0) {
-                n_i = 1;
-                n_t = hit.getObject()->material.refraction_index;
-            }
-
-            // If the ray is exiting
-            else {
-                n_t = 1;
-                n_i = hit.getObject()->material.refraction_index;
-            }
-
-            Vector4 T;
-            if(!refract(ray.direction, hit.normal(), n_i, n_t, T))
-                return hit.getObject()->getMaterial().color;
-
-            Ray4 rayR = Ray4(hit.hitPoint(), R);
-            Ray4 rayT = Ray4(hit.hitPoint(), T);
-
-            Color colorR = ray_color(rayR, depth + 1);
-            Color colorT = ray_color(rayT, depth + 1);
-
-            Material hitMaterial = hit.getObject()->getMaterial();
-            return colorR * hitMaterial.getReflection() + colorT * hitMaterial.getTransmission() + hitMaterial.color;
-        }
-    }
-    else
-        return background_color;
-}
+// The scene being shown, so "r" can read it again
+const char *scene_file = NULL;
 
+// The UI's copy of shadows_on (KBUI variables are floats)
+float shadows_ui = 0;
+float max_depth_ui = 4;
 
 //////////////////////////////////////////////////////////////////////
 // If window size has changed, re-allocate the frame buffer
 //////////////////////////////////////////////////////////////////////
 void check_for_resize() {
-    // Now, check if the frame buffer needs to be created,
-    // or re-created.
-
-    bool should_allocate = false;
-    if (img == NULL) {
-        // frame buffer not yet allocated.
-        should_allocate = true;
+    // The render thread writes to a buffer of the old size.
+    if (img == NULL || cam.get_win_W() != winWidth || cam.get_win_H() != winHeight) {
+        progressive.cancel();
     }
-    else if (winWidth  != cam.get_win_W() ||
-             winHeight != cam.get_win_H()) {
-
-        // frame buffer allocated, but has changed size.
-        delete[] img;
-        should_allocate = true;
-        winWidth  = cam.get_win_W();
-        winHeight = cam.get_win_H();
-    }
-
-    if (should_allocate) {
 
-        if (debugOn) {
-            cout << "ALLOCATING: (W H)=(" << winWidth
-                 << " " << winHeight << ")\n";
-        }
-
-        img = new byte[winWidth * winHeight * 3];
+    // Now, check if the frame buffer needs to be created,
+    // or re-created.
+    if (resize_frame_buffer(cam.get_win_W(), cam.get_win_H())) {
         camera_changed();
     }
 }
 
-/////////////////////////////////////////////////////////
-// Initialize a ray starting at (x y)DCS.
-// YOU MUST IMPLEMENT THIS FUNCTION.
-/////////////////////////////////////////////////////////
-Ray4 get_ray(int xDCS, int yDCS) {
-    float dx = (clipR - clipL) / winWidth;
-    float xVcs = clipL + (xDCS + 0.5) * dx;
-
-    float dy = (clipT - clipB) / winHeight;
-    float yVcs = clipB + (yDCS + 0.5) * dy;
-
-    float zVcs = -clipN;
-    Point4 pVcs = Point4(xVcs, yVcs, zVcs);
-
-    Float4 F_wcs = Mvcswcs * pVcs;
-    Point4 pWcs(F_wcs.X(), F_wcs.Y(), F_wcs.Z());
-
-    Vector4 V = pWcs - eye;
-    V = V.normalized();
-
-    Ray4 ray = Ray4(pWcs, V);
-    return ray;
-}
-
-/////////////////////////////////////////////////////////
-// Find the first object hit by the ray, if any
-// YOU MUST IMPLEMENT THIS FUNCTION.
-/////////////////////////////////////////////////////////
-bool first_hit(Ray4 &ray, Hit& hit) {
-    hits.clear();
-
-    for(int i = 0; i < scene_objects.size(); i++) {
-        Object* currentObject = scene_objects[i];
-        Hit theIntersectingHit;
-
-        if(currentObject->intersects(ray, theIntersectingHit))
-            hits.add(theIntersectingHit);
-    }
-
-    bool isThereMinHit = false;
-    if(!hits.isEmpty()) {
-        hit = hits.getMin();
-        isThereMinHit = true;
-    }
-    return isThereMinHit;
-}
-
-//////////////////////////////////////////////////////
-// A ray hits a mirror.
-// Return the direction of the reflected ray.
-//////////////////////////////////////////////////////
-Vector4 mirror_direction(Vector4& V, Vector4& N) {
-    float NV = N * V;
-    return V - (2.0f * NV) * N;
-}
-
-//////////////////////////////////////////////////////
-// A ray hits a specular surface.
-// Compute the direction of the refracted ray. - TODO
-// Given an incident ray’s direction, the surface’s normal, and the two indexes of refraction, set the refracted ray.
-// If there is total internal refraction, return false.
-// YOU MUST IMPLEMENT THIS FUNCTION.
-//////////////////////////////////////////////////////
-bool refract(Vector4& V, Vector4& N, float n_i, float n_t, Vector4& direction) {
-    Vector4 newN = N;
-    if(V*N > 0) newN = -N;
-
-    float alpha = -V * newN;
-    float beta = sqrtf(1 - alpha * alpha);
-    float Y = (n_i / n_t) * beta;
-
-    if(1 - Y * Y < 0)
-        return false;
-
-    float delta = sqrtf(1 - Y * Y);
-    Vector4 A = V + alpha * newN;
-    Vector4 C = -delta * newN;
-    Vector4 D = (n_i / n_t) * A;
-
-    direction = C + D;
-    direction = direction.normalized();
-    return true;
-}
-
-
-//////////////////////////////////////////////////////
-// A ray hits a phong surface.
-// Compute the color of the surface.
-// YOU MUST IMPLEMENT THIS FUNCTION.
-//////////////////////////////////////////////////////
-Color local_illumination(Vector4& V, Vector4& N, Vector4& L, Material& mat, Color& ls) {
-    float NL = N.dot(L);
-    if (NL > 0) {
-        // light on up side of surface.
-
-        Vector4 R = mirror_direction(L, N);
-        float RV = R.dot(V);
-        if (RV < 0) {
-            // On back side of specular blob, use 0 instead.
-            RV = 0;
-        }
-
-        //
-        // Fast (R.V)^n
-        // Avoid pow().  It's SLOOOOWW!
-        //
-        float RVn = 1.0f;
-
-
-        if (RV <= 0.0f)
-            RVn = 0.0f;
-        else {
-            int n = mat.getShininess();
-            while (n > 0) {
-                if (n & 1)
-                    RVn *= RV;
-                RV *= RV;
-                n >>= 1;
-            }
-        }
-
-        Color& kd = mat.getDiffuse();
-        Color& ks = mat.getSpecular();
-
-        return ls * (kd * NL + ks * RVn);
-    }
-    else
-        return Color(0,0,0);  // light on back, no illumination.
-}
-
-/////////////////////////////////////////////////////////
-// This function actually generates the ray-traced image.
-// You don't have to change this function.
-/////////////////////////////////////////////////////////
-void render() {
-    int x,y;
-    byte r,g,b;
-    int p;
-
-    setup_camera();
-
-    ambient_light = Color(0,0,0);
-    for (auto light : scene_lights) {
-        ambient_light += light.getColor() * ambient_fraction;
-    }
-
-    for (y=0; y<winHeight; y++) {
-        for (x=0; x<winWidth; x++) {
-
-            if (debugOn) {
-                cout << "pixel (" << x << " " << y << ")\n";
-                cout.flush();
-            }
-
-            Ray4 ray = get_ray(x, y);
-            Color pixel_color = ray_color(ray, 0);
-            pixel_color.clamp();
-
-            r = (byte) (pixel_color.R() * 255.0);
-            g = (byte) (pixel_color.G() * 255.0);
-            b = (byte) (pixel_color.B() * 255.0);
-
-            p = (y*winWidth + x) * 3;
-
-            img[p]   = r;
-            img[p+1] = g;
-            img[p+2] = b;
-        }
-    }
-}
-
 //////////////////////////////////////////////////////
 //
 // Displays, on STDOUT, the colour of the pixel that
@@ -437,7 +112,8 @@ void mouse_button_callback( GLFWwindow* window, int button,
 
     if (action == GLFW_PRESS)
     {
-        debugOn = true;
+        TraceContext ctx;
+        ctx.debug = true;
 
         // Get the mouse's position.
 
@@ -456,16 +132,13 @@ void mouse_button_callback( GLFWwindow* window, int button,
         int yDCS = (int)(mouse_fy * winHeight + 0.5);
 
         Ray4 ray = get_ray(xDCS, yDCS);
-        Color pixelColor = ray_color(ray, 0);
+        Color pixelColor = ray_color(ray, 0, ctx);
 
-        if (debugOn) {
-            cout << "cursorpos:" << xpos << " " << ypos << "\n";
-            cout << "Width Height: " << winWidth << " " << winHeight << "\n";
-            cout << "Window Size: " << W << " " << H << "\n";
-            cout << "Pixel at (x y)=(" << xDCS << " " << yDCS << ")\n";
-            cout << "Pixel Color = " << pixelColor << endl;
-        }
-        debugOn = false;
+        cout << "cursorpos:" << xpos << " " << ypos << "\n";
+        cout << "Width Height: " << winWidth << " " << winHeight << "\n";
+        cout << "Window Size: " << W << " " << H << "\n";
+        cout << "Pixel at (x y)=(" << xDCS << " " << yDCS << ")\n";
+        cout << "Pixel Color = " << pixelColor << endl;
     }
 }
 
@@ -487,6 +160,19 @@ void cam_param_changed(float param) {
     frame_buffer_stale = true;
 }
 
+/////////////////////////////////////////////////////////
+// Called when user toggles shadows.
+/////////////////////////////////////////////////////////
+void shadows_changed(float value) {
+    shadows_on = (value > 0.5f);
+    camera_changed();
+}
+
+void max_depth_changed(float value) {
+    max_recursion_depth = (int)(value + 0.5f);
+    camera_changed();
+}
+
 /////////////////////////////////////////////////////////
 // Check if window was resized.
 // You don't have to change this function.
@@ -505,241 +191,6 @@ bool get_was_window_resized() {
     return false;
 }
 
-//////////////////////////////////////////////////////
-// This function sets up a simple scene.
-// YOU MUST IMPLEMENT THIS FUNCTION.
-/////////////////////////////////////////////////////
-void read_scene(const char *filename) {
-    ambient_light.set(0,0,0);
-    float r,g,b;
-    float x,y,z;
-    int nMaterials;
-    int nLights;
-    int nObjects;
-
-    Tokenizer toker(filename);
-
-    while (!toker.eof()) {
-        string keyword = toker.next_string();
-
-        // cout << "keyword:" << keyword << "\n";
-
-        if (keyword == string("")) {
-            continue; // skip blank lines
-        }
-        else if (keyword == string("#materials")) {
-            nMaterials = toker.next_number();
-            // Don't do anything (materials are now in a map)
-        }
-        else if (keyword == string("#lights")) {
-            nLights = toker.next_number();
-            scene_lights.reserve(nLights);
-        }
-        else if (keyword == string("#objects")) {
-            nObjects = toker.next_number();
-            scene_objects.reserve(nObjects);
-            hitPool = new Hit[nObjects*2];
-        }
-        else if (keyword == string("light")) {
-            Color c;
-            Point4 p;
-
-            string name = toker.next_string();
-
-            toker.match("color");
-            r = toker.next_number();
-            g = toker.next_number();
-            b = toker.next_number();
-            c.set(r,g,b);
-
-            ambient_light += c * ambient_fraction;
-
-            toker.match("position");
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            p.set(x,y,z);
-
-            Light l(c, p);
-            l.name = name;
-
-            scene_lights.push_back(l);
-        }
-
-        else if (keyword == string("camera_eye")) {
-            double x,y,z;
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            eye = Point4(x,y,z);
-            eye_home = eye;
-        }
-        else if (keyword == string("camera_lookat")) {
-            double x,y,z;
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            lookat = Point4(x,y,z);
-            lookat_home = lookat;
-        }
-        else if (keyword == string("camera_vup")) {
-            double x,y,z;
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            vup = Vector4(x,y,z);
-            vup_home = vup;
-        }
-        else if (keyword == string("camera_clip")) {
-            clipL = toker.next_number();
-            clipR = toker.next_number();
-            clipB = toker.next_number();
-            clipT = toker.next_number();
-            clipN = toker.next_number();
-            clip_home[0] = clipL;
-            clip_home[1] = clipR;
-            clip_home[2] = clipB;
-            clip_home[3] = clipT;
-            clip_home[4] = clipN;
-        }
-
-        /////////////////////////////////////////////////////
-        // IMPLEMENT THE CODE BELOW
-        // |    |    |    |    |
-        // v    v    v    v    v
-
-        else if (keyword == string("material")) {
-            Material newMaterial;
-            string name = toker.next_string();
-            newMaterial.name = name;
-
-            keyword = toker.next_string();
-            string materialType = toker.next_string();
-
-            if(materialType == "phong") {
-                newMaterial.surface_type = PHONG;
-
-                keyword = toker.next_string();
-                r = toker.next_number();
-                g = toker.next_number();
-                b = toker.next_number();
-                Color ambient = Color(r,g,b);
-
-                keyword = toker.next_string();
-                r = toker.next_number();
-                g = toker.next_number();
-                b = toker.next_number();
-                Color diffuse = Color(r,g,b);
-
-                keyword = toker.next_string();
-                r = toker.next_number();
-                g = toker.next_number();
-                b = toker.next_number();
-                Color specular = Color(r,g,b);
-
-                keyword = toker.next_string();
-                auto shininess = (int)toker.next_number();
-
-                newMaterial.set(ambient, diffuse, specular, shininess);
-                materials_by_name[name] = newMaterial;
-            }
-            else if(materialType == "specular") {
-                newMaterial.surface_type = SPECULAR;
-
-                keyword = toker.next_string();
-                float index = toker.next_number();
-
-                keyword = toker.next_string();
-                r = toker.next_number();
-                g = toker.next_number();
-                b = toker.next_number();
-                Color tau = Color(r,g,b);
-
-                keyword = toker.next_string();
-                r = toker.next_number();
-                g = toker.next_number();
-                b = toker.next_number();
-                Color rho = Color(r,g,b);
-
-                keyword = toker.next_string();
-                r = toker.next_number();
-                g = toker.next_number();
-                b = toker.next_number();
-                Color color = Color(r,g,b);
-
-                newMaterial.set(index, tau, rho, color);
-                materials_by_name[name] = newMaterial;
-            }
-            else {
-                newMaterial.surface_type = NO_SURFACE;
-                cerr << "Parse error: unrecognized material type \"" << materialType << "\"\n";
-                exit(EXIT_FAILURE);
-            }
-        }
-        else if (keyword == string("sphere")) {
-            string sphereName = toker.next_string();
-
-            keyword = toker.next_string();
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            Point4 center = Point4(x,y,z);
-
-            keyword = toker.next_string();
-            float radius = toker.next_number();
-
-            keyword = toker.next_string();
-            string materialName = toker.next_string();
-            Material material;
-
-            for (std::map<string,Material>::iterator it = materials_by_name.begin(); it != materials_by_name.end(); ++it) {
-                if(it->first == materialName) {
-                    material = it->second;
-                    break;
-                }
-            }
-            scene_objects.push_back(new Sphere(center, radius, material));
-        }
-        else if (keyword == string("triangle")) {
-            string triangleName = toker.next_string();
-
-            keyword = toker.next_string();
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            Point4 v1 = Point4(x,y,z);
-
-            keyword = toker.next_string();
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            Point4 v2 = Point4(x,y,z);
-
-            keyword = toker.next_string();
-            x = toker.next_number();
-            y = toker.next_number();
-            z = toker.next_number();
-            Point4 v3 = Point4(x,y,z);
-
-            keyword = toker.next_string();
-            string materialName = toker.next_string();
-            Material material;
-
-            for (std::map<string,Material>::iterator it = materials_by_name.begin(); it != materials_by_name.end(); ++it) {
-               if(it->first == materialName) {
-                   material = it->second;
-                   break;
-               }
-            }
-            scene_objects.push_back(new Triangle(v1,v2,v3,material));
-        }
-        else {
-            cerr << "Parse error: unrecognized keyword \"" << keyword << "\"\n";
-            exit(EXIT_FAILURE);
-        }
-    }
-}
-
 ///////////////////////////////////////////////////
 // Resets the camera parameters.
 // You don't have to change this function.
@@ -768,7 +219,8 @@ static void error_callback(int error, const char* description) {
 }
 
 //////////////////////////////////////////////////////
-// Quit if the user hits "q" or "ESC".
+// Quit if the user hits "q" or "ESC", and read the
+// scene file again (after it's been edited) on "r".
 // All other key presses are passed to the UI.
 // You don't have to change this function.
 //////////////////////////////////////////////////////
@@ -779,6 +231,18 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
     else if (action == GLFW_RELEASE) {
+        // Up and down change a variable (the camera, say), which
+        // the render thread may be reading: stop it first.
+        // display() starts a new render if anything changed.
+        if (key == GLFW_KEY_UP || key == GLFW_KEY_DOWN)
+            progressive.cancel();
+        if (key == GLFW_KEY_R) {
+            progressive.cancel();
+            clear_scene();
+            read_scene(scene_file);
+            camera_changed();
+            return;
+        }
         the_ui.handle_key(key);
     }
 }
@@ -807,12 +271,17 @@ void display () {
         // Resizing triggers a call to handleReshape, which sets
         // frameBufferStale.
         //
-        render();
+        // The render runs in the background: until its first pass
+        // is done, the old image stays up.
+        //
+        progressive.start();
         frame_buffer_stale = false;
     }
 
+    progressive.latest(img);
+
     //
-    // This paints the current image buffer onto the screen.
+    // This paints the latest finished pass onto the screen.
     //
     glDrawPixels(winWidth,winHeight,
                  GL_RGB,GL_UNSIGNED_BYTE,img);
@@ -833,6 +302,12 @@ void init_UI() {
     the_ui.add_variable("Ambient Fraction", &ambient_fraction, 0, 1, 0.1,
         cam_param_changed);
 
+    shadows_ui = shadows_on ? 1 : 0;
+    the_ui.add_variable("Shadows", &shadows_ui, 0, 1, 1, shadows_changed);
+
+    max_depth_ui = max_recursion_depth;
+    the_ui.add_variable("Max Depth", &max_depth_ui, 0, 16, 1, max_depth_changed);
+
     the_ui.add_variable("Ref X", &lookat.X(), -10, 10, 0.2, cam_param_changed);
     the_ui.add_variable("Ref Y", &lookat.Y(), -10, 10, 0.2, cam_param_changed);
     the_ui.add_variable("Ref Z", &lookat.Z(), -10, 10, 0.2, cam_param_changed);
@@ -868,6 +343,349 @@ void test_surface(Vector4& V, Vector4& N) {
 }
 
 
+//////////////////////////////////////////////////////
+// Print the command line options, and quit.
+//////////////////////////////////////////////////////
+void usage() {
+    cerr << "Usage:\n";
+    cerr << "  rt [options] <scene-file.txt>\n";
+    cerr << "Options:\n";
+    cerr << "  --output FILE   render one frame to FILE (.ppm or .png) and quit,\n";
+    cerr << "                  without opening a window\n";
+    cerr << "  --stats FILE    with --output, also write the frame's ray counts\n";
+    cerr << "                  and phase times to FILE, as JSON (with --animate,\n";
+    cerr << "                  the last frame's)\n";
+    cerr << "  --animate FILE  with --output, render each frame of the animation\n";
+    cerr << "                  in FILE, numbering the images (out_0000.ppm, ...,\n";
+    cerr << "                  or as a printf pattern in the name says: out%03d.png)\n";
+    cerr << "  --width N       image width in pixels (default: 300)\n";
+    cerr << "  --height N      image height in pixels (default: 300)\n";
+    cerr << "  --shadows       cast shadow rays toward each light\n";
+    cerr << "  --light-cutoff X\n";
+    cerr << "                  skip groups of lights that add less than X to a\n";
+    cerr << "                  pixel (default: 0, every light that can add anything)\n";
+    cerr << "  --max-depth N   trace reflections and refractions N deep (default: 4)\n";
+    cerr << "  --min-weight X  skip reflected and refracted rays that add at most X\n";
+    cerr << "                  to a pixel (default: 1/512; 0 traces all but black ones)\n";
+    cerr << "  --roulette      trace the dimmest of the other rays at random, weighted\n";
+    cerr << "                  up to make up for the rest\n";
+    cerr << "  --threads N     trace with N threads (default: one per core)\n";
+    cerr << "  --tile-size N   render tiles of N x N pixels (default: 16)\n";
+    cerr << "  --packet N      trace primary rays in N x N packets, N <= 8\n";
+    cerr << "                  (default: 8; 1 traces them one by one)\n";
+    cerr << "  --simd NAME     intersection kernels: scalar, sse, avx2, avx512\n";
+    cerr << "                  or auto (default: auto, the widest this CPU has)\n";
+    cerr << "  --bench N       time N frames at 1, 2, 4, ... threads, and quit\n";
+    cerr << "  --accel NAME    find hits with a bvh, grid or kdtree (default: the\n";
+    cerr << "                  scene file's \"accelerator\", else bvh)\n";
+    cerr << "  --bvh NAME      build the BVH with sah, or the faster to build but\n";
+    cerr << "                  slower to trace lbvh (default: sah)\n";
+    cerr << "  --bench-bvh     time both BVH builds against a linear scan on\n";
+    cerr << "                  random scenes of 16 .. 1M spheres, and quit\n";
+    cerr << "  --bench-math    time the vector math of ray-object tests,\n";
+    cerr << "                  shading and matrices, and quit\n";
+    cerr << "  --bench-packets N\n";
+    cerr << "                  time N frames of primary-ray first hits, one ray\n";
+    cerr << "                  at a time and in packets, and quit\n";
+    exit(EXIT_FAILURE);
+}
+
+//////////////////////////////////////////////////////
+// Render the scene "frames" times with 1, 2, 4, ...
+// threads (up to one per core), and print the average
+// frame time and the speedup over one thread.
+// If --threads was given, only that count is timed.
+//
+// No window is opened.
+//////////////////////////////////////////////////////
+void benchmark(int frames) {
+    resize_frame_buffer(winWidth, winHeight);
+    float dummy=0;
+    reset_camera(dummy);
+
+    vector<int> thread_counts;
+    if (num_threads > 0) {
+        thread_counts.push_back(num_threads);
+    }
+    else {
+        int cores = TileScheduler::hardware_threads();
+        for (int n = 1; n < cores; n *= 2)
+            thread_counts.push_back(n);
+        thread_counts.push_back(cores);
+    }
+
+    printf("# %d x %d pixels, %d x %d tiles, %d frames per run, %s intersection kernels\n",
+           winWidth, winHeight, tile_size, tile_size, frames,
+           simd_name().c_str());
+    printf("%8s %12s %12s %12s %10s\n",
+           "threads", "frame_ms", "Mpixels/s", "Mrays/s", "speedup");
+
+    int saved_threads = num_threads;
+    double base_ms = 0;
+
+    for (int n : thread_counts) {
+        num_threads = n;
+        render(); // warm-up
+
+        auto start = chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            render();
+        }
+        auto stop = chrono::steady_clock::now();
+
+        double ms = chrono::duration<double, milli>(stop - start).count() / frames;
+        if (base_ms == 0)
+            base_ms = ms;
+
+        printf("%8d %12.3f %12.3f %12.3f %10.2f\n", n, ms,
+               (double)winWidth * winHeight / (ms * 1000.0),
+               (double)frame_stats.rays / (ms * 1000.0), base_ms / ms);
+    }
+
+    num_threads = saved_threads;
+}
+
+//////////////////////////////////////////////////////
+// Show how first_hit() scales with the number of objects.
+//
+// For scenes of 16, 64, ... 1M random spheres (at a
+// constant density), build the BVH both ways, trace the
+// same number of rays through each and through a linear
+// scan of every object, and print the time and intersection
+// tests per ray.  The BVH columns should grow with
+// log(objects), the linear ones with objects; the LBVH
+// should build faster, and cost more per ray, than the SAH.
+//////////////////////////////////////////////////////
+void benchmark_bvh() {
+    const int n_rays = 20000;
+    const int max_linear = 4096; // the linear scan gets too slow after this
+
+    mt19937 rng(12345);
+    uniform_real_distribution<float> unit(0, 1);
+    int material = 0; // the default
+
+    printf("# %s intersection kernels, BVHs built on %d threads\n", simd_name().c_str(),
+           num_threads > 0 ? num_threads : TileScheduler::hardware_threads());
+    printf("%8s %6s %10s %8s %6s %9s %12s %12s %14s %14s\n",
+           "objects", "build", "build_ms", "nodes", "depth", "sah_cost",
+           "bvh_ns/ray", "bvh_tests", "linear_ns/ray", "linear_tests");
+
+    for (int n = 16; n <= 1048576; n *= 4) {
+        // About one sphere per 8 cubic units
+        float side = 2 * cbrtf((float)n);
+
+        vector<Sphere> spheres;
+        spheres.reserve(n);
+        vector<Object*> objects;
+        for (int i = 0; i < n; i++) {
+            Point4 center(unit(rng) * side, unit(rng) * side, unit(rng) * side);
+            spheres.push_back(Sphere(center, 0.5, material));
+            objects.push_back(&spheres.back());
+        }
+
+        // Rays from outside the cloud, aimed at random points inside it
+        vector<Ray4> rays;
+        for (int i = 0; i < n_rays; i++) {
+            Point4 start(-side, unit(rng) * side, unit(rng) * side);
+            Point4 target(unit(rng) * side, unit(rng) * side, unit(rng) * side);
+            Vector4 direction = (target - start).normalized();
+            rays.push_back(Ray4(start, direction));
+        }
+
+        Hit hit;
+        double linear_ns = 0;
+        if (n <= max_linear) {
+            auto start = chrono::steady_clock::now();
+            for (auto& ray : rays) {
+                float t_best = FLT_MAX;
+                for (auto obj : objects) {
+                    if (obj->intersects(ray, t_best, hit))
+                        t_best = (float)hit.getDistance();
+                }
+            }
+            auto stop = chrono::steady_clock::now();
+            linear_ns = chrono::duration<double, nano>(stop - start).count() / n_rays;
+        }
+
+        // The linear scan goes on the first row
+        for (BuildMethod method : {BUILD_SAH, BUILD_LBVH}) {
+            BVH bvh(method);
+            auto start = chrono::steady_clock::now();
+            bvh.build(objects, num_threads);
+            auto stop = chrono::steady_clock::now();
+            double build_ms = chrono::duration<double, milli>(stop - start).count();
+
+            TraceContext ctx;
+            start = chrono::steady_clock::now();
+            for (auto& ray : rays) {
+                bvh.first_hit(ray, hit, ctx);
+            }
+            stop = chrono::steady_clock::now();
+            double bvh_ns = chrono::duration<double, nano>(stop - start).count() / n_rays;
+            double bvh_tests = (double)ctx.stats.intersection_tests / n_rays;
+
+            printf("%8d %6s %10.3f %8d %6d %9.2f %12.1f %12.1f", n,
+                   build_method_name(method).c_str(), build_ms, bvh.nodeCount(),
+                   bvh.depth(), bvh.sahCost(), bvh_ns, bvh_tests);
+            if (method == BUILD_SAH && n <= max_linear)
+                printf(" %14.1f %14d\n", linear_ns, n);
+            else
+                printf(" %14s %14s\n", "-", "-");
+        }
+    }
+}
+
+//////////////////////////////////////////////////////
+// Time the vector math that every ray runs, one call at
+// a time on random inputs: ray-sphere and ray-triangle
+// tests, reflection plus refraction, Phong shading,
+// normalization and matrix products.
+//////////////////////////////////////////////////////
+void benchmark_math() {
+    printf("%14s %10s %10s\n", "operation", "ns/op", "Mops/s");
+    for (auto& result : benchmark_micro(256)) {
+        printf("%14s %10.2f %10.1f\n", result.name.c_str(),
+               result.ns_per_op, 1000.0 / result.ns_per_op);
+    }
+}
+
+//////////////////////////////////////////////////////
+// Time just the first hits of the primary rays, on one
+// thread: each ray on its own, then in packets of
+// packet_size x packet_size.  (Packets that aren't coherent
+// fall back to single rays, as in render_packet().)
+//////////////////////////////////////////////////////
+void benchmark_packets(int frames) {
+    resize_frame_buffer(winWidth, winHeight);
+    float dummy=0;
+    reset_camera(dummy);
+    setup_camera();
+
+    int n = max(packet_size, 1);
+    vector<Ray4> rays;
+    for (int y = 0; y < winHeight; y++) {
+        for (int x = 0; x < winWidth; x++) {
+            rays.push_back(get_ray(x, y));
+        }
+    }
+
+    printf("# %d x %d pixels, %d x %d packets, %d frames, %s intersection kernels\n",
+           winWidth, winHeight, n, n, frames, simd_name().c_str());
+    printf("%8s %12s %12s %10s %12s\n", "mode", "frame_ms", "Mrays/s", "speedup", "tests/ray");
+
+    double single_ms = 0;
+    for (int packets = 0; packets <= 1; packets++) {
+        TraceContext ctx;
+        Hit hit;
+        long coherent = 0, total = 0;
+
+        auto start = chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            if (!packets) {
+                for (auto& ray : rays)
+                    scene_accel->first_hit(ray, hit, ctx);
+                continue;
+            }
+            for (int y0 = 0; y0 < winHeight; y0 += n) {
+                for (int x0 = 0; x0 < winWidth; x0 += n) {
+                    RayPacket packet;
+                    for (int y = y0; y < min(y0 + n, winHeight); y++) {
+                        for (int x = x0; x < min(x0 + n, winWidth); x++)
+                            packet.add(rays[y * winWidth + x]);
+                    }
+                    total++;
+                    if (first_hit(packet, ctx)) {
+                        coherent++;
+                        continue;
+                    }
+                    for (int i = 0; i < packet.size(); i++)
+                        scene_accel->first_hit(packet.rays[i], hit, ctx);
+                }
+            }
+        }
+        auto stop = chrono::steady_clock::now();
+
+        double ms = chrono::duration<double, milli>(stop - start).count() / frames;
+        if (!packets)
+            single_ms = ms;
+        printf("%8s %12.3f %12.3f %10.2f %12.2f", packets ? "packet" : "single", ms,
+               (double)rays.size() / (ms * 1000.0), single_ms / ms,
+               (double)ctx.stats.intersection_tests / ((double)rays.size() * frames));
+        if (packets)
+            printf("   (%.1f%% of packets coherent)", 100.0 * coherent / total);
+        printf("\n");
+    }
+}
+
+//////////////////////////////////////////////////////
+// The image file for frame f: "pattern" with f put in
+// where it has a printf %d, or else before its extension.
+//////////////////////////////////////////////////////
+static string frame_file_name(const string& pattern, int f) {
+    char name[1024];
+    if (pattern.find('%') != string::npos) {
+        snprintf(name, sizeof(name), pattern.c_str(), f);
+        return name;
+    }
+    size_t dot = pattern.rfind('.');
+    if (dot == string::npos || pattern.find('/', dot) != string::npos)
+        dot = pattern.size();
+    snprintf(name, sizeof(name), "%s_%04d%s", pattern.substr(0, dot).c_str(), f,
+             pattern.substr(dot).c_str());
+    return name;
+}
+
+//////////////////////////////////////////////////////
+// Render every frame of an animation to its own image.
+//
+// Before each frame, the objects that moved are refitted
+// in the accelerator, which costs about as much as they
+// are big.  When it can't refit (grid, k-d tree), or the
+// refitted BVH has grown too slow to trace, it's built
+// again from scratch.
+//////////////////////////////////////////////////////
+void render_animation(const char *animation_file, const char *output_file) {
+    Animation animation;
+    animation.read(animation_file);
+    resize_frame_buffer(winWidth, winHeight);
+
+    int rebuilds = 0;
+    double update_ms = 0, trace_ms = 0;
+    vector<Object*> moved;
+    for (int f = 0; f < animation.frames(); f++) {
+        auto start = chrono::steady_clock::now();
+        moved.clear();
+        animation.apply(f, moved);
+        bool rebuilt = false;
+        if (!moved.empty() && !scene_accel->refit(moved)) {
+            scene_accel->build(scene_objects, num_threads);
+            rebuilt = true;
+            rebuilds++;
+        }
+        auto updated = chrono::steady_clock::now();
+        frame_phases.update = chrono::duration<double, milli>(updated - start).count();
+
+        render();
+
+        auto rendered = chrono::steady_clock::now();
+        string name = frame_file_name(output_file, f);
+        if (!write_image(name.c_str(), winWidth, winHeight, img)) {
+            exit(EXIT_FAILURE);
+        }
+        frame_phases.framebuffer =
+            chrono::duration<double, milli>(chrono::steady_clock::now() - rendered).count();
+        update_ms += frame_phases.update;
+        trace_ms += frame_phases.trace;
+        printf("Wrote %s: %d moved%s, update %.3f ms, trace %.3f ms\n", name.c_str(),
+               (int)moved.size(), rebuilt ? " (rebuilt)" : moved.empty() ? "" : " (refit)",
+               frame_phases.update, frame_phases.trace);
+    }
+
+    int frames = animation.frames();
+    printf("%d frames, %d rebuilds of the %s, mean update %.3f ms, mean trace %.3f ms\n",
+           frames, rebuilds, scene_accel->name().c_str(), update_ms / frames, trace_ms / frames);
+}
+
 //////////////////////////////////////////////////////
 // Main program.
 // You don't have to change this function.
@@ -895,14 +713,150 @@ int main(int argc, char *argv[]) {
 //
 //    exit(0);
 
-    init_UI();
-    if (argc < 2) {
-        cerr << "Usage:\n";
-        cerr << "  rt <scene-file.txt>\n";
-        exit(EXIT_FAILURE);
+    const char *output_file = NULL;
+    const char *stats_file = NULL;
+    const char *animation_file = NULL;
+    int bench_frames = 0;
+    int packet_bench_frames = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+
+        if (arg == "--output" && has_value) {
+            output_file = argv[++i];
+        }
+        else if (arg == "--stats" && has_value) {
+            stats_file = argv[++i];
+        }
+        else if (arg == "--animate" && has_value) {
+            animation_file = argv[++i];
+        }
+        else if (arg == "--width" && has_value) {
+            winWidth = atoi(argv[++i]);
+        }
+        else if (arg == "--height" && has_value) {
+            winHeight = atoi(argv[++i]);
+        }
+        else if (arg == "--shadows") {
+            shadows_on = true;
+        }
+        else if (arg == "--light-cutoff" && has_value) {
+            light_cutoff = atof(argv[++i]);
+        }
+        else if (arg == "--max-depth" && has_value) {
+            max_recursion_depth = atoi(argv[++i]);
+            if (max_recursion_depth < 0)
+                usage();
+        }
+        else if (arg == "--min-weight" && has_value) {
+            min_ray_weight = atof(argv[++i]);
+        }
+        else if (arg == "--roulette") {
+            russian_roulette = true;
+        }
+        else if (arg == "--threads" && has_value) {
+            num_threads = atoi(argv[++i]);
+        }
+        else if (arg == "--tile-size" && has_value) {
+            tile_size = atoi(argv[++i]);
+        }
+        else if (arg == "--packet" && has_value) {
+            packet_size = atoi(argv[++i]);
+            if (packet_size < 1 || packet_size > 8)
+                usage();
+        }
+        else if (arg == "--simd" && has_value) {
+            if (!set_simd(argv[++i])) {
+                cerr << "SIMD kernel '" << argv[i] << "' is not available on this machine\n";
+                usage();
+            }
+        }
+        else if (arg == "--accel" && has_value) {
+            if (!accelerator_type(argv[++i], accel_type))
+                usage();
+            accel_fixed = true;
+        }
+        else if (arg == "--bvh" && has_value) {
+            if (!build_method(argv[++i], bvh_build))
+                usage();
+        }
+        else if (arg == "--bench" && has_value) {
+            bench_frames = atoi(argv[++i]);
+        }
+        else if (arg == "--bench-packets" && has_value) {
+            packet_bench_frames = atoi(argv[++i]);
+        }
+        else if (arg == "--bench-bvh") {
+            benchmark_bvh();
+            exit(EXIT_SUCCESS);
+        }
+        else if (arg == "--bench-math") {
+            benchmark_math();
+            exit(EXIT_SUCCESS);
+        }
+        else if (arg[0] == '-' || scene_file != NULL) {
+            usage();
+        }
+        else {
+            scene_file = argv[i];
+        }
+    }
+
+    if (scene_file == NULL || winWidth < 1 || winHeight < 1) {
+        usage();
+    }
+    if (animation_file != NULL && output_file == NULL) {
+        usage();
+    }
+
+    read_scene(scene_file);
+
+    if (animation_file != NULL) {
+        render_animation(animation_file, output_file);
+        if (stats_file != NULL && !write_frame_stats(stats_file)) {
+            exit(EXIT_FAILURE);
+        }
+        exit(EXIT_SUCCESS);
     }
 
-    read_scene(argv[1]);
+    if (bench_frames > 0) {
+        benchmark(bench_frames);
+        exit(EXIT_SUCCESS);
+    }
+
+    if (packet_bench_frames > 0) {
+        benchmark_packets(packet_bench_frames);
+        exit(EXIT_SUCCESS);
+    }
+
+    //
+    // Batch mode: render one frame straight to a file.
+    // Never touches GLFW or OpenGL, so it runs without a display.
+    //
+    if (output_file != NULL) {
+        resize_frame_buffer(winWidth, winHeight);
+
+        auto start = chrono::steady_clock::now();
+        render();
+        auto stop = chrono::steady_clock::now();
+
+        if (!write_image(output_file, winWidth, winHeight, img)) {
+            exit(EXIT_FAILURE);
+        }
+        frame_phases.framebuffer =
+            chrono::duration<double, milli>(chrono::steady_clock::now() - stop).count();
+
+        if (stats_file != NULL && !write_frame_stats(stats_file)) {
+            exit(EXIT_FAILURE);
+        }
+        cout << "Wrote " << output_file << " (" << winWidth << " x " << winHeight
+             << ") in " << chrono::duration<double, milli>(stop - start).count()
+             << " ms\n";
+        exit(EXIT_SUCCESS);
+    }
+
+    init_UI();
 
     GLFWwindow* window;
 
@@ -951,7 +905,7 @@ int main(int argc, char *argv[]) {
     while (!glfwWindowShouldClose(window))
     {
         cam.check_resize();
-        setup_camera();
+        check_for_resize();
 
         display();
 
@@ -959,6 +913,7 @@ int main(int argc, char *argv[]) {
         glfwPollEvents();
     }
 
+    progressive.cancel();
     glfwDestroyWindow(window);
 
     glfwTerminate();
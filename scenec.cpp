@@ -0,0 +1,42 @@
+//////////////////////////////////////////////////////
+//
+// The scene compiler: reads a text scene file, and
+// writes it in the compiled format (see SceneFile.h),
+// which rt and bench load without parsing.
+//
+//     scenec scene.txt scene.rtscene
+//
+//////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "RayTracer.h"
+#include "SceneFile.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cerr << "Usage:\n";
+        cerr << "  scenec scene-file.txt compiled-file.rtscene\n";
+        exit(EXIT_FAILURE);
+    }
+
+    read_scene(argv[1]);
+
+    auto start = chrono::steady_clock::now();
+    if (!write_scene_file(argv[2])) {
+        exit(EXIT_FAILURE);
+    }
+    auto stop = chrono::steady_clock::now();
+
+    cerr << argv[1] << ": " << scene_materials.size() - 1 << " materials, "
+         << scene_lights.size() << " lights, " << scene_spheres.size() << " spheres, "
+         << scene_triangles.size() << " triangles, " << scene_meshes.size() << " meshes, "
+         << scene_groups.size() << " groups, " << scene_instances.size() << " instances\n";
+    cerr << "read in " << frame_phases.parse << " ms, wrote " << argv[2] << " in "
+         << chrono::duration<double, milli>(stop - start).count() << " ms\n";
+    return 0;
+}